@@ -0,0 +1,440 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <iomanip>
+#include <cstring>   // для std::strcmp
+#include <cstdlib>   // для std::atoi
+
+// Этот файл содержит main(): здесь подменяется operator new для подсчёта выделений
+#define MEMOIZA_COUNT_ALLOCATIONS
+#include "memoiza/alloc_counter.hpp"
+
+#include "memoiza/active_grid.hpp"
+#include "memoiza/checkpoint_store.hpp"
+#include "memoiza/cycle_detect.hpp"
+#include "memoiza/edges.hpp"
+#include "memoiza/engine.hpp"
+#include "memoiza/hashlife.hpp"
+#include "memoiza/pattern_io.hpp"
+#include "memoiza/seed_search.hpp"
+#include "memoiza/sparse_rows.hpp"
+#include "memoiza/step_kernels.hpp"
+#include "memoiza/zobrist.hpp"
+
+// --------------------------------------------------------------
+// ЗАМЕРЫ ПРОИЗВОДИТЕЛЬНОСТИ
+// --------------------------------------------------------------
+//
+// Каждый замер начинается с одного и того же начального поля и делает
+// одно и то же число поколений, поэтому работа воспроизводима между
+// запусками и версиями; время — лучшее из нескольких повторов. Итоговое
+// число живых клеток пишется в отчёт: если оно изменилось между
+// версиями, сравнивать время нельзя. Отчёт — JSON (--out или stdout).
+
+using memoiza::BitGrid;
+using memoiza::CellKey;
+
+// Стороны квадратных полей (--sizes 256,1024,4096)
+static std::vector<int> boardSizes = {256, 1024};
+
+// Поколений в замере шага (--generations) и повторов каждого замера (--repeat)
+static int generations = 200;
+static int repeats = 3;
+
+// Лимит итераций поиска цикла (--cycle-iter)
+static std::uint64_t cycleIterations = 4096;
+
+// Файл отчёта (--out); пусто — stdout
+static std::string outFile;
+
+// Число потоков для шага (вызывающий поток тоже считается)
+static unsigned threadCount = std::thread::hardware_concurrency();
+
+// Результат одного замера
+struct BenchResult {
+    std::string name;     // step, hash-full, hash-incremental, cycle-map, cycle-brent
+    std::string engine;   // dense, active, rows, sparse, adaptive, hashlife
+    std::string pattern;  // r-pentomino, random50, gun
+    int size = 0;
+    std::uint64_t generations = 0;
+    double seconds = 0;   // лучшее время из повторов
+    std::uint64_t population = 0;
+    std::uint64_t allocations = 0;  // выделений памяти за замер
+    std::uint64_t bytes = 0;        // память под состояния поиска цикла в конце замера
+    std::uint64_t cycleStart = 0, cycleLength = 0;
+};
+
+static std::vector<BenchResult> results;
+
+// Сюда пишутся хеши из замеров, чтобы компилятор не выбросил вычисление
+static volatile std::uint64_t hashSink = 0;
+
+// --------------------------------------------------------------
+// НАЧАЛЬНЫЕ ПОЛЯ
+// --------------------------------------------------------------
+
+static const char* GOSPER_GUN_RLE =
+    "x = 36, y = 9, rule = B3/S23\n"
+    "24bo$22bobo$12b2o6b2o12b2o$11bo3bo4b2o12b2o$2o8bo5bo3b2o$2o8bo3bob2o4b\n"
+    "obo$10bo5bo7bo$11bo3bo$12b2o!\n";
+
+// Начальное поле size x size: R-пентамино в центре, случайная смесь
+// 50% с фиксированным зерном или глайдерное ружьё Госпера в углу
+BitGrid makePattern(const std::string& pattern, int size) {
+    BitGrid g(size, size);
+    if (pattern == "r-pentomino") {
+        int r = size / 2, c = size / 2;
+        g.set(r - 1, c, true);
+        g.set(r - 1, c + 1, true);
+        g.set(r, c - 1, true);
+        g.set(r, c, true);
+        g.set(r + 1, c, true);
+    } else if (pattern == "random50") {
+        std::mt19937 gen;
+        memoiza::fillSoup(g, 20240601, 0.5, gen);
+    } else if (pattern == "gun") {
+        std::istringstream in(GOSPER_GUN_RLE);
+        memoiza::DenseSink sink(g, 8, 8);
+        memoiza::PatternInfo info;
+        std::string error;
+        memoiza::parseRle(in, sink, info, error);
+    }
+    return g;
+}
+
+// Ключи живых клеток по возрастанию; ёмкость keys переиспользуется
+void toKeys(const BitGrid& g, std::vector<CellKey>& keys) {
+    keys.clear();
+    memoiza::forEachRunDense(g, [&](std::int64_t r, std::int64_t c, std::int64_t n) {
+        for (std::int64_t i = 0; i < n; i++) keys.push_back(memoiza::packCell(r, c + i));
+    });
+}
+
+memoiza::ThreadPool& benchPool() {
+    static memoiza::ThreadPool pool(threadCount);
+    return pool;
+}
+
+// --------------------------------------------------------------
+// ИЗМЕРЕНИЕ
+// --------------------------------------------------------------
+
+// run() делает весь замер и возвращает итоговое число живых клеток;
+// setup() перед каждым повтором восстанавливает начальное состояние
+template <class Setup, class Run>
+BenchResult measure(BenchResult res, Setup&& setup, Run&& run) {
+    res.seconds = 1e300;
+    for (int rep = 0; rep < repeats; rep++) {
+        setup();
+        std::uint64_t allocBefore = memoiza::allocationCount();
+        auto t0 = std::chrono::steady_clock::now();
+        res.population = run();
+        auto t1 = std::chrono::steady_clock::now();
+        res.allocations = memoiza::allocationCount() - allocBefore;
+        res.seconds = std::min(res.seconds, std::chrono::duration<double>(t1 - t0).count());
+    }
+    std::cerr << res.name << " " << res.engine << " " << res.pattern << " " << res.size << "x" << res.size
+              << ": " << res.seconds * 1000 << " мс\n";
+    return res;
+}
+
+// Шаг всех движков: плотный (всё поле), по активным тайлам, по
+// отсортированным строкам и HashLife (только для разреженных полей)
+void benchStep(const std::string& pattern, int size) {
+    const BitGrid initial = makePattern(pattern, size);
+    BenchResult base;
+    base.name = "step";
+    base.pattern = pattern;
+    base.size = size;
+    base.generations = static_cast<std::uint64_t>(generations);
+
+    BitGrid g, spare(size, size);
+    base.engine = "dense";
+    results.push_back(measure(base, [&] { g = initial; }, [&] {
+        for (int i = 0; i < generations; i++) {
+            memoiza::stepWithEdges<memoiza::BoundedEdges>(g, spare, benchPool());
+            std::swap(g, spare);
+        }
+        return g.population();
+    }));
+
+    memoiza::ActiveGrid active;
+    base.engine = "active";
+    results.push_back(measure(base, [&] { active.assign(initial); }, [&] {
+        for (int i = 0; i < generations; i++) active.step(benchPool());
+        return active.current().population();
+    }));
+
+    std::vector<CellKey> cells, next;
+    std::vector<CellKey> initialKeys;
+    toKeys(initial, initialKeys);
+    const memoiza::Rule rule = memoiza::activeRule();
+    base.engine = "rows";
+    results.push_back(measure(base, [&] { cells = initialKeys; }, [&] {
+        for (int i = 0; i < generations; i++) {
+            next.clear();
+            memoiza::stepSortedRows(cells.data(), cells.data() + cells.size(), 0, static_cast<std::uint64_t>(size),
+                                    static_cast<std::uint64_t>(size), rule, next);
+            cells.swap(next);
+        }
+        return static_cast<std::uint64_t>(cells.size());
+    }));
+
+    // Разреженный и адаптивный движки библиотеки, если они собраны
+    memoiza::EngineConfig config;
+    config.rows = size;
+    config.cols = size;
+    config.rule = rule;
+    config.pool = &benchPool();
+    std::string error;
+    std::unique_ptr<memoiza::Board> board;
+    for (const char* name : {"sparse", "adaptive"}) {
+        if (!memoiza::makeEngine(name, config, error)) continue;
+        base.engine = name;
+        results.push_back(measure(base, [&] {
+            board = memoiza::makeEngine(name, config, error);
+            for (CellKey k : initialKeys) board->set(memoiza::cellRow(k), memoiza::cellCol(k), true);
+        }, [&] {
+            board->advance(static_cast<std::uint64_t>(generations));
+            return board->population();
+        }));
+    }
+
+    // Поле HashLife неограниченное: поколения совпадают с остальными
+    // движками, пока клетки не дошли до края
+    if (pattern != "random50") {
+        memoiza::HashLife life;
+        base.engine = "hashlife";
+        results.push_back(measure(base, [&] {
+            life.setRule(rule);
+            for (CellKey k : initialKeys) life.setCell(memoiza::cellCol(k), memoiza::cellRow(k), true);
+        }, [&] {
+            for (int i = 0; i < generations; i++) life.step();
+            return life.population();
+        }));
+    }
+}
+
+// Хеш поля: полный пересчёт и обновление по изменениям за шаг
+void benchHash(const std::string& pattern, int size) {
+    const BitGrid initial = makePattern(pattern, size);
+    BenchResult base;
+    base.pattern = pattern;
+    base.size = size;
+    base.engine = "dense";
+    base.generations = static_cast<std::uint64_t>(generations);
+
+    BitGrid g, spare(size, size);
+    memoiza::Hash128 h;
+    base.name = "hash-full";
+    results.push_back(measure(base, [&] { g = initial; }, [&] {
+        for (int i = 0; i < generations; i++) hashSink = memoiza::zobristHash(g).lo;
+        return g.population();
+    }));
+
+    // Шаги в замере не входят: поколения готовятся заранее
+    std::vector<BitGrid> states(1, initial);
+    for (int i = 0; i < std::min(generations, 16); i++) {
+        BitGrid s = states.back();
+        memoiza::stepWithEdges<memoiza::BoundedEdges>(s, spare, benchPool());
+        states.push_back(spare);
+    }
+    base.name = "hash-incremental";
+    results.push_back(measure(base, [&] { h = memoiza::zobristHash(initial); }, [&] {
+        for (int i = 0; i < generations; i++) {
+            std::size_t k = static_cast<std::size_t>(i) % (states.size() - 1);
+            memoiza::updateZobrist(states[k], states[k + 1], h);
+        }
+        hashSink = h.lo;
+        return states.back().population();
+    }));
+}
+
+// Поиск цикла на торе: словарь хешей с историей состояний (ключевые
+// кадры и дельты) против алгоритма Брента с тремя состояниями
+void benchCycle(const std::string& pattern, int size) {
+    const BitGrid initial = makePattern(pattern, size);
+    BenchResult base;
+    base.pattern = pattern;
+    base.size = size;
+    base.engine = "active";
+
+    memoiza::BasicActiveGrid<memoiza::TorusEdges> active;
+    std::unordered_map<memoiza::Hash128, std::uint64_t, memoiza::Hash128Hasher> visited;
+    memoiza::CheckpointStore history;
+    std::vector<CellKey> keys;
+    BenchResult res = base;
+    base.name = "cycle-map";
+    results.push_back(measure(base, [&] {
+        active.assign(initial);
+        visited.clear();
+        history.clear();
+    }, [&] {
+        memoiza::Hash128 h = memoiza::zobristHash(initial);
+        res = base;
+        std::uint64_t iter = 0;
+        for (; iter < cycleIterations; iter++) {
+            auto seen = visited.emplace(h, iter);
+            if (!seen.second) {
+                res.cycleStart = seen.first->second;
+                res.cycleLength = iter - seen.first->second;
+                break;
+            }
+            toKeys(active.current(), keys);
+            history.append(keys.begin(), keys.end());
+            active.step(benchPool());
+            active.forEachFlip([&](int r, int c) { h ^= memoiza::cellKey(r, c); });
+        }
+        res.generations = iter;
+        res.bytes = history.bytes() + visited.bucket_count() * sizeof(void*) +
+                    visited.size() * (sizeof(memoiza::Hash128) + 3 * sizeof(std::uint64_t));
+        return active.current().population();
+    }));
+    results.back().generations = res.generations;
+    results.back().cycleStart = res.cycleStart;
+    results.back().cycleLength = res.cycleLength;
+    results.back().bytes = res.bytes;
+
+    BitGrid spare(size, size);
+    memoiza::CycleInfo info;
+    base.name = "cycle-brent";
+    base.engine = "dense";
+    results.push_back(measure(base, [] {}, [&] {
+        info = memoiza::findCycleBrent(
+            initial,
+            [&](BitGrid& g) {
+                memoiza::stepWithEdges<memoiza::TorusEdges>(g, spare, benchPool());
+                std::swap(g, spare);
+            },
+            [](const BitGrid& a, const BitGrid& b) { return a == b; }, cycleIterations);
+        return initial.population();
+    }));
+    results.back().generations = info.steps;
+    results.back().cycleStart = info.start;
+    results.back().cycleLength = info.length;
+    results.back().bytes = 3 * initial.wordsPerRow() * sizeof(std::uint64_t) * static_cast<std::size_t>(size);
+}
+
+// --------------------------------------------------------------
+// ОТЧЁТ
+// --------------------------------------------------------------
+
+void writeJson(std::ostream& out) {
+    out << std::setprecision(6);
+    out << "{\n";
+    out << "  \"format\": \"memoiza-bench\",\n";
+    out << "  \"version\": 1,\n";
+    out << "  \"kernel\": \"" << memoiza::activeStepKernel().name << "\",\n";
+    out << "  \"rule\": \"" << memoiza::activeRule().toString() << "\",\n";
+    out << "  \"threads\": " << benchPool().size() << ",\n";
+    out << "  \"repeats\": " << repeats << ",\n";
+    out << "  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        const double cells = static_cast<double>(r.size) * r.size;
+        const double gensPerSec = r.seconds > 0 ? r.generations / r.seconds : 0;
+        out << "    {\"name\": \"" << r.name << "\", \"engine\": \"" << r.engine << "\", \"pattern\": \""
+            << r.pattern << "\", \"rows\": " << r.size << ", \"cols\": " << r.size
+            << ", \"generations\": " << r.generations << ", \"seconds\": " << r.seconds
+            << ", \"gensPerSec\": " << gensPerSec << ", \"cellsPerSec\": " << gensPerSec * cells
+            << ", \"population\": " << r.population
+            << ", \"allocsPerGen\": " << (r.generations ? double(r.allocations) / r.generations : 0.0)
+            << ", \"allocations\": " << r.allocations;
+        if (r.name.compare(0, 5, "cycle") == 0) {
+            out << ", \"stateBytes\": " << r.bytes
+                << ", \"bytesPerGen\": " << (r.generations ? double(r.bytes) / r.generations : 0.0)
+                << ", \"cycleStart\": " << r.cycleStart << ", \"cycleLength\": " << r.cycleLength;
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// --------------------------------------------------------------
+// ОБРАБОТКА ПАРАМЕТРОВ КОМАНДНОЙ СТРОКИ
+// --------------------------------------------------------------
+
+void printUsage(const char* program) {
+    std::cout << "Использование: " << program
+              << " [--sizes 256,1024,4096] [--generations <n>] [--repeat <n>] [--cycle-iter <n>]"
+              << " [--threads <n>] [--kernel scalar|avx2|avx512] [--rule B3/S23] [--out <файл.json>]\n";
+}
+
+void parseArguments(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            boardSizes.clear();
+            std::istringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                int size = std::atoi(item.c_str());
+                if (size < 8) {
+                    std::cerr << "Неверный размер поля: " << item << " (не меньше 8)\n";
+                    exit(1);
+                }
+                boardSizes.push_back(size);
+            }
+        } else if (std::strcmp(argv[i], "--generations") == 0 && i + 1 < argc) {
+            generations = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeats = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--cycle-iter") == 0 && i + 1 < argc) {
+            cycleIterations = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (!memoiza::selectStepKernel(name)) {
+                std::cerr << "Ядро " << name << " недоступно на этом процессоре\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--rule") == 0 && i + 1 < argc) {
+            memoiza::Rule rule;
+            if (!memoiza::parseRule(argv[++i], rule) || (rule.birth & 1u)) {
+                std::cerr << "Неверное правило: " << argv[i] << " (B0 не поддерживается)\n";
+                exit(1);
+            }
+            memoiza::selectRule(rule);
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--help") == 0) {
+            printUsage(argv[0]);
+            exit(0);
+        } else {
+            std::cerr << "Неизвестный аргумент: " << argv[i] << "\n";
+            printUsage(argv[0]);
+            exit(1);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    parseArguments(argc, argv);
+
+    for (int size : boardSizes) {
+        for (const char* pattern : {"r-pentomino", "random50", "gun"}) {
+            benchStep(pattern, size);
+            benchHash(pattern, size);
+            benchCycle(pattern, size);
+        }
+    }
+
+    if (outFile.empty()) {
+        writeJson(std::cout);
+    } else {
+        std::ofstream out(outFile);
+        writeJson(out);
+        if (!out) {
+            std::cerr << "Ошибка: не удалось записать " << outFile << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
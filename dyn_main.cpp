@@ -1,5 +1,4 @@
 #include <iostream>
-#include <unordered_set>
 #include <unordered_map>
 #include <vector>
 #include <random>
@@ -7,11 +6,27 @@
 #include <thread>
 #include <functional>
 #include <sstream>
-#include <algorithm> // для std::shuffle
+#include <algorithm>
 #include <fstream>   // для работы с файлами
 #include <cstring>   // для std::strcmp
 #include <cstdlib>   // для std::atoi
 
+// Этот файл содержит main(): здесь подменяется operator new для подсчёта выделений
+#define MEMOIZA_COUNT_ALLOCATIONS
+#include "memoiza/alloc_counter.hpp"
+
+#include "memoiza/board_file.hpp"
+#include "memoiza/checkpoint_store.hpp"
+#include "memoiza/cycle_detect.hpp"
+#include "memoiza/fast_forward.hpp"
+#include "memoiza/flat_cell_set.hpp"
+#include "memoiza/hashlife.hpp"
+#include "memoiza/metrics.hpp"
+#include "memoiza/pattern_io.hpp"
+#include "memoiza/sparse_step.hpp"
+#include "memoiza/thread_pool.hpp"
+#include "memoiza/zobrist.hpp"
+
 // --------------------------------------------------------------
 // ОПРЕДЕЛЕНИЕ ПАРАМЕТРОВ И ТИПОВ
 // --------------------------------------------------------------
@@ -22,41 +37,72 @@ static bool debugMode = false;
 // Размер сетки (N x N). Будет определен на основе длины input_data.
 static size_t N = 20; // Значение по умолчанию, может быть изменено
 
+// Размер сетки из --size (0 — по длине input_data). Движок rows
+// работает с полями до 2^32 x 2^32, время шага от N не зависит.
+static size_t sizeOverride = 0;
+
 // Максимальное количество живых клеток. Не должно превышать N.
 static size_t maxLive = 20; // Значение по умолчанию, может быть изменено
 
-// Тип для координат клетки (строка, столбец)
-using Cell = std::pair<size_t, size_t>;
+// Движок симуляции: "sparse" (множество клеток), "rows" (отсортированные
+// строки, без хеш-таблиц на шаге) или "hashlife"
+static std::string engineName = "sparse";
 
-// Пользовательская хеш-функция для Cell, используемая в unordered_set
-struct CellHash {
-    std::size_t operator()(const Cell& cell) const {
-        // Комбинируем хеши строки и столбца с использованием простого множителя
-        return std::hash<size_t>()(cell.first) * 31 + std::hash<size_t>()(cell.second);
-    }
-};
+// Правило автомата (--rule); правила с B0 разреженные движки не поддерживают
+static memoiza::Rule lifeRule = memoiza::CONWAY_RULE;
+static bool ruleGiven = false;
 
-// Компаратор равенства для Cell
-struct CellEq {
-    bool operator()(const Cell& a, const Cell& b) const {
-        return (a.first == b.first) && (a.second == b.second);
-    }
-};
+// Двоичный файл поля и истории (memoiza/board_file.hpp): --load читает
+// начальное поле или готовую историю, --save записывает итог запуска
+static std::string loadFile;
+static std::string saveFile;
+
+// Узор в стандартном формате (memoiza/pattern_io.hpp: .rle, .cells, .mc):
+// --pattern задаёт начальное поле вместо input_data (движок hashlife
+// строит дерево прямо из файла), --export записывает итоговое поле
+static std::string patternFile;
+static std::string exportFile;
+
+// Поиск цикла: "map" (словарь хешей) или "brent" (O(1) состояний)
+static std::string cycleMode = "map";
 
-// Разреженное представление сетки: множество живых клеток
-using SparseGrid = std::unordered_set<Cell, CellHash, CellEq>;
+// Лимит итераций для поиска цикла
+static size_t maxIterations = 2000;
+
+// Метрики (memoiza/metrics.hpp): --metrics <файл|-> включает запись
+// строки JSON раз в --metrics-every поколений
+static memoiza::Metrics metrics;
+static std::string metricsFile;
+static uint64_t metricsEvery = 100;
+
+// Сколько узлов HashLife держать в памяти до сборки мусора
+static const size_t HASHLIFE_MAX_NODES = 4000000;
+
+// Раз в столько итераций хранилище состояний пишет полный кадр,
+// между ними — только родившиеся и умершие клетки
+static const uint64_t KEYFRAME_INTERVAL = 64;
+
+// Клетка (строка, столбец), упакованная в 64-битный ключ
+using Cell = memoiza::CellKey;
+using memoiza::packCell;
+using memoiza::cellRow;
+using memoiza::cellCol;
+
+// Разреженное представление сетки: плоское множество живых клеток
+using SparseGrid = memoiza::FlatCellSet;
 
 // --------------------------------------------------------------
 // ФУНКЦИЯ ЛОГИРОВАНИЯ
 // --------------------------------------------------------------
 
-// Логирует сообщения, если режим отладки включен
+// Печатает отладочное сообщение
 void logMessage(const std::string& msg) {
-    if (debugMode) {
-        std::cout << "[DEBUG] " << msg << "\n";
-    }
+    std::cout << "[DEBUG] " << msg << "\n";
 }
 
+// Сообщение собирается, только если режим отладки включен
+#define LOG_DEBUG(...) MEMOIZA_TRACE(debugMode, logMessage(__VA_ARGS__))
+
 // --------------------------------------------------------------
 // ГЕНЕРАЦИЯ НАЧАЛЬНОГО СОСТОЯНИЯ
 // --------------------------------------------------------------
@@ -73,148 +119,532 @@ SparseGrid generateInitialConfiguration(size_t N, size_t maxLive, std::mt19937&
     while (grid.size() < maxLive) {
         size_t r = dist(gen);
         size_t c = dist(gen);
-        grid.emplace(r, c);
+        grid.insert(packCell(r, c));
     }
 
     return grid;
 }
 
 // --------------------------------------------------------------
-// ПОДСЧЕТ СОСЕДЕЙ
+// ХЕШИРОВАНИЕ ВСЕГО СОСТОЯНИЯ СЕТКИ
 // --------------------------------------------------------------
 
-// Подсчитывает количество живых соседей для данной клетки
-int countNeighbors(const SparseGrid& grid, size_t r, size_t c, size_t N) {
-    int cnt = 0;
-    for (int dr = -1; dr <= 1; dr++) {
-        for (int dc = -1; dc <= 1; dc++) {
-            if (dr == 0 && dc == 0) continue;
-            ssize_t rr = static_cast<ssize_t>(r) + dr;
-            ssize_t cc = static_cast<ssize_t>(c) + dc;
-            if (rr < 0 || rr >= static_cast<ssize_t>(N) || cc < 0 || cc >= static_cast<ssize_t>(N))
-                continue;
-            if (grid.find({static_cast<size_t>(rr), static_cast<size_t>(cc)}) != grid.end()) {
-                cnt++;
-            }
-        }
+// Вычисляет 128-битный хеш Зобриста: XOR ключей всех живых клеток.
+// Не зависит от порядка обхода; при симуляции считается один раз,
+// дальше обновляется по рождениям и смертям.
+memoiza::Hash128 hashGrid(const SparseGrid& grid) {
+    memoiza::Hash128 h;
+    for (Cell cell : grid) {
+        h ^= memoiza::cellKey(cellRow(cell), cellCol(cell));
     }
-    return cnt;
+    return h;
 }
 
 // --------------------------------------------------------------
-// ОПРЕДЕЛЕНИЕ СЛЕДУЮЩЕГО СОСТОЯНИЯ КЛЕТКИ
+// ВЫЧИСЛЕНИЕ ПРОСТОГО КОНТРОЛЬНОГО СУММЫ (НЕОБЯЗАТЕЛЬНО)
 // --------------------------------------------------------------
 
-// Определяет, будет ли клетка жива в следующем поколении
-bool nextStateOfCell(const SparseGrid& grid, size_t r, size_t c, size_t N) {
-    bool isAlive = (grid.find({r, c}) != grid.end());
-    int neighbors = countNeighbors(grid, r, c, N);
+// Вычисляет простую контрольную сумму для состояния сетки (необязательно, для верификации)
+std::size_t computeChecksum(const SparseGrid& grid) {
+    std::size_t checksum = 0;
+    for (Cell cell : grid) {
+        checksum += static_cast<std::size_t>(cellRow(cell)) * 31 + cellCol(cell);
+    }
+    return checksum;
+}
+
+// --------------------------------------------------------------
+// ШАГ АВТОМАТА С ОГРАНИЧЕНИЕМ И ХЕШЕМ
+// --------------------------------------------------------------
+
+// Следующее поколение (memoiza/sparse_step.hpp) в запасной буфер и обмен
+// буферами; с cap — сразу с ограничением числа живых клеток (время
+// ограничения входит и в step). Буферы шага живут между поколениями.
+void stepGrid(SparseGrid& grid, memoiza::Hash128& hash, memoiza::ThreadPool& pool,
+              const memoiza::LiveCap* cap = nullptr) {
+    static memoiza::SparseStepper stepper;
+    static SparseGrid spare;
+    stepper.setMethod(engineName == "rows" ? memoiza::SparseMethod::Rows : memoiza::SparseMethod::Hash);
+    stepper.setMetrics(&metrics);
+    auto timer = metrics.time(memoiza::Phase::Step);
+    size_t removed = stepper.step(grid, spare, N, N, lifeRule, pool, &hash, cap);
+    std::swap(grid, spare);
+    if (removed != 0) {
+        LOG_DEBUG("Количество живых клеток превышало maxLive. Удалено " + std::to_string(removed) + " клеток.");
+    }
+}
+
+// Следующее поколение, ограничение maxLive и инкрементальный хеш
+void advanceState(SparseGrid& grid, memoiza::Hash128& hash, memoiza::ThreadPool& pool, uint32_t seed) {
+    memoiza::LiveCap cap{maxLive, seed};
+    stepGrid(grid, hash, pool, &cap);
+}
+
+// --------------------------------------------------------------
+// ПОИСК ЦИКЛА АЛГОРИТМОМ БРЕНТА
+// --------------------------------------------------------------
 
-    if (isAlive) {
-        // Выживает, если у нее 2 или 3 живых соседа
-        return (neighbors == 2 || neighbors == 3);
+// Вместо словаря хешей и снимков в памяти только три состояния, поэтому
+// лимит итераций может быть 10^8 и больше. Состояние на запрошенной
+// итерации восстанавливается повторной симуляцией от начального.
+int runBrent(const SparseGrid& initial, memoiza::ThreadPool& pool, uint32_t seed) {
+    // Состояние вместе с хешем: клетки сравниваются только при равных хешах
+    struct HashedGrid {
+        SparseGrid cells;
+        memoiza::Hash128 hash;
+    };
+    uint64_t steps = 0;
+    auto step = [&](HashedGrid& g) {
+        advanceState(g.cells, g.hash, pool, seed);
+        if (metrics.due(++steps)) {
+            metrics.set(memoiza::Counter::LiveCells, g.cells.size());
+            metrics.dump(steps);
+        }
+    };
+    auto same = [](const HashedGrid& a, const HashedGrid& b) {
+        return a.hash == b.hash && a.cells == b.cells;
+    };
+
+    HashedGrid start{initial, hashGrid(initial)};
+    HashedGrid entry;
+    memoiza::CycleInfo info = memoiza::findCycleBrent(start, step, same, maxIterations, &entry);
+    metrics.finish(steps);
+    LOG_DEBUG("Брент: шагов автомата " + std::to_string(info.steps));
+
+    if (info.found) {
+        std::cout << "Цикл обнаружен!\n";
+        std::cout << "Цикл начинается с итерации " << info.start << " и имеет длину " << info.length << ".\n";
     } else {
-        // Рождается, если у нее ровно 3 живых соседа
-        return (neighbors == 3);
+        std::cout << "Цикл не обнаружен за " << maxIterations << " итераций.\n";
+        return 0;
+    }
+
+    // Брент хранит только начальное поле и вход в цикл: итерация после
+    // начала цикла досчитывается от входа не больше чем за длину цикла
+    auto history = memoiza::makeFastForward<HashedGrid>(
+        [&](HashedGrid& g) { advanceState(g.cells, g.hash, pool, seed); });
+    history.record(0, start);
+    history.record(info.start, entry, true);
+    history.setCycle(info.start, info.length);
+
+    size_t queryIter;
+    std::cout << "Введите номер итерации для получения состояния: ";
+    if (std::cin >> queryIter) {
+        uint64_t target = 0;
+        HashedGrid state;
+        if (!history.resolve(queryIter, target) || !history.stateAt(queryIter, state)) {
+            std::cerr << "Ошибка: итерация " << queryIter << " недоступна\n";
+            return 1;
+        }
+        std::cout << "Состояние на итерации " << queryIter << " восстановлено (итерация " << target
+                  << "), живых клеток: " << state.cells.size() << "\n";
     }
+    return 0;
 }
 
 // --------------------------------------------------------------
-// ВЫЧИСЛЕНИЕ СЛЕДУЮЩЕГО ПОКОЛЕНИЯ
+// ЗАПИСЬ УЗОРА
 // --------------------------------------------------------------
 
-// Вычисляет следующее поколение на основе текущей сетки
-SparseGrid nextGeneration(const SparseGrid& current, size_t N) {
-    SparseGrid next;
-    std::unordered_map<Cell, int, CellHash, CellEq> neighborCount;
-    neighborCount.reserve(current.size() * 9); // Грубая оценка
-
-    // 1) Определяем всех кандидатов (живые клетки и их соседи)
-    for (const auto& cell : current) {
-        size_t r = cell.first;
-        size_t c = cell.second;
-
-        for (int dr = -1; dr <= 1; dr++) {
-            for (int dc = -1; dc <= 1; dc++) {
-                ssize_t rr = static_cast<ssize_t>(r) + dr;
-                ssize_t cc = static_cast<ssize_t>(c) + dc;
-                if (rr < 0 || rr >= static_cast<ssize_t>(N) || cc < 0 || cc >= static_cast<ssize_t>(N))
-                    continue;
-                Cell candidate = {static_cast<size_t>(rr), static_cast<size_t>(cc)};
-                neighborCount[candidate] = 0; // Инициализируем счетчик
-            }
+// RLE и .cells пишутся отрезками по отсортированным клеткам поля rows x cols
+bool exportSorted(const std::string& path, const std::vector<Cell>& sorted, int64_t rows, int64_t cols) {
+    memoiza::PatternFormat format = memoiza::detectPatternFormat(path);
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    if (format == memoiza::PatternFormat::Rle) {
+        memoiza::RleWriter writer(out, cols, rows, lifeRule);
+        memoiza::forEachRunSorted(sorted.begin(), sorted.end(),
+                                  [&](int64_t r, int64_t c, int64_t n) { writer.run(r, c, n); });
+        writer.finish();
+    } else if (format == memoiza::PatternFormat::Cells) {
+        memoiza::CellsWriter writer(out, path);
+        memoiza::forEachRunSorted(sorted.begin(), sorted.end(),
+                                  [&](int64_t r, int64_t c, int64_t n) { writer.run(r, c, n); });
+        writer.finish();
+    } else {
+        return false;
+    }
+    return static_cast<bool>(out);
+}
+
+// Поле HashLife: Macrocell — прямо из дерева, остальные форматы — по
+// клеткам, сдвинутым к левому верхнему углу живых клеток
+bool exportPattern(const std::string& path, const memoiza::HashLife& life) {
+    if (memoiza::detectPatternFormat(path) == memoiza::PatternFormat::Macrocell) {
+        std::ofstream out(path, std::ios::binary);
+        memoiza::writeMacrocell(out, life);
+        return static_cast<bool>(out);
+    }
+    int64_t minX = INT64_MAX, minY = INT64_MAX, maxX = INT64_MIN, maxY = INT64_MIN;
+    life.forEachLive([&](int64_t x, int64_t y) {
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+    });
+    if (life.population() == 0) minX = minY = maxX = maxY = 0;
+    if (maxX - minX >= (int64_t(1) << 32) || maxY - minY >= (int64_t(1) << 32)) return false;
+    std::vector<Cell> cells;
+    cells.reserve(life.population());
+    life.forEachLive([&](int64_t x, int64_t y) {
+        cells.push_back(packCell(static_cast<uint64_t>(y - minY), static_cast<uint64_t>(x - minX)));
+    });
+    std::sort(cells.begin(), cells.end());
+    return exportSorted(path, cells, maxY - minY + 1, maxX - minX + 1);
+}
+
+// Поле разреженных движков (N x N)
+bool exportPattern(const std::string& path, const SparseGrid& grid) {
+    if (memoiza::detectPatternFormat(path) == memoiza::PatternFormat::Macrocell) {
+        memoiza::HashLife life;
+        life.setRule(lifeRule);
+        for (Cell cell : grid) {
+            life.setCell(static_cast<int64_t>(cellCol(cell)), static_cast<int64_t>(cellRow(cell)), true);
         }
+        return exportPattern(path, life);
     }
+    std::vector<Cell> cells(grid.begin(), grid.end());
+    std::sort(cells.begin(), cells.end());
+    return exportSorted(path, cells, static_cast<int64_t>(N), static_cast<int64_t>(N));
+}
+
+// --------------------------------------------------------------
+// ДВИЖОК HASHLIFE
+// --------------------------------------------------------------
 
-    // 2) Подсчитываем количество живых соседей для каждого кандидата
-    for (const auto& cell : current) {
-        size_t r = cell.first;
-        size_t c = cell.second;
+// Тот же поиск цикла, но поле — неограниченная плоскость в HashLife:
+// клетки не обрезаются по краю N и maxLive не применяется. Снимки —
+// это корни квадродерева, поэтому их хранение почти бесплатно, а
+// состояние на любой итерации получается прыжком, а не пошагово.
+int runHashLife(memoiza::HashLife& life, size_t maxIterations) {
+    LOG_DEBUG("HashLife: начальное поле загружено, живых клеток = " + std::to_string(life.population()) +
+              ", узлов = " + std::to_string(life.nodeCount()));
 
-        for (int dr = -1; dr <= 1; dr++) {
-            for (int dc = -1; dc <= 1; dc++) {
-                if (dr == 0 && dc == 0) continue;
-                ssize_t rr = static_cast<ssize_t>(r) + dr;
-                ssize_t cc = static_cast<ssize_t>(c) + dc;
-                if (rr < 0 || rr >= static_cast<ssize_t>(N) || cc < 0 || cc >= static_cast<ssize_t>(N))
-                    continue;
-                Cell neighbor = {static_cast<size_t>(rr), static_cast<size_t>(cc)};
-                auto it = neighborCount.find(neighbor);
-                if (it != neighborCount.end()) {
-                    it->second += 1;
-                }
+    std::unordered_map<std::size_t, size_t> visited;
+    std::unordered_map<size_t, const memoiza::HashLifeNode*> memoStates;
+    size_t lastMemo = 0;
+    bool cycleFound = false;
+    size_t cycleStart = 0;
+    size_t cycleLen = 0;
+
+    size_t iter = 0;
+    for (; iter < maxIterations; iter++) {
+        if (metrics.due(iter)) {
+            metrics.set(memoiza::Counter::LiveCells, life.population());
+            metrics.dump(iter);
+        }
+
+        auto hashTimer = metrics.time(memoiza::Phase::Hash);
+        std::size_t currentHash = life.hash();
+        hashTimer.stop();
+        auto cycleTimer = metrics.time(memoiza::Phase::CycleCheck);
+        auto it = visited.find(currentHash);
+        if (it != visited.end()) {
+            // Сверяем с состоянием: прыжок от снимка и сравнение корней
+            // (корни канонические, равные поля — один и тот же узел)
+            const memoiza::HashLifeNode* now = life.root();
+            size_t base = it->second / 10 * 10;
+            life.setRoot(memoStates[base], base);
+            life.advance(it->second - base);
+            bool same = (life.root() == now);
+            life.setRoot(now, iter);
+            if (same) {
+                cycleFound = true;
+                cycleStart = it->second;
+                cycleLen = iter - cycleStart;
+                break;
             }
+            LOG_DEBUG("HashLife: коллизия хеша с итерацией " + std::to_string(it->second));
+        } else {
+            visited[currentHash] = iter;
+        }
+        cycleTimer.stop();
+
+        if (iter % 10 == 0) {
+            memoStates[iter] = life.root();
+            lastMemo = iter;
+        }
+
+        auto stepTimer = metrics.time(memoiza::Phase::Step);
+        life.step();
+        stepTimer.stop();
+
+        // Сборка мусора: оставляем только текущее поле и снимки
+        if (life.nodeCount() > HASHLIFE_MAX_NODES) {
+            std::vector<const memoiza::HashLifeNode*> keep;
+            std::vector<size_t> iters;
+            for (const auto& kv : memoStates) {
+                iters.push_back(kv.first);
+                keep.push_back(kv.second);
+            }
+            life.collectGarbage(keep);
+            for (size_t i = 0; i < iters.size(); i++) memoStates[iters[i]] = keep[i];
+            LOG_DEBUG("HashLife: сборка мусора, узлов осталось " + std::to_string(life.nodeCount()));
         }
     }
 
-    // 3) Определяем, какие клетки будут живыми в следующем поколении
-    for (const auto& kv : neighborCount) {
-        const Cell& cell = kv.first;
-        int cnt = kv.second;
-        bool aliveNow = (current.find(cell) != current.end());
-        bool aliveNext;
+    metrics.set(memoiza::Counter::LiveCells, life.population());
+    metrics.finish(iter);
 
-        if (aliveNow) {
-            aliveNext = (cnt == 2 || cnt == 3);
-        } else {
-            aliveNext = (cnt == 3);
+    if (cycleFound) {
+        std::cout << "Цикл обнаружен!\n";
+        std::cout << "Цикл начинается с итерации " << cycleStart << " и имеет длину " << cycleLen << ".\n";
+    } else {
+        std::cout << "Цикл не обнаружен за " << maxIterations << " итераций.\n";
+    }
+
+    if (!exportFile.empty()) {
+        if (!exportPattern(exportFile, life)) {
+            std::cerr << "Ошибка: не удалось записать узор " << exportFile << "\n";
+            return 1;
         }
+        LOG_DEBUG("Поле записано в " + exportFile);
+    }
 
-        if (aliveNext) {
-            next.emplace(cell);
+    // Любую итерацию восстанавливаем от ближайшего снимка прыжком HashLife
+    size_t queryIter;
+    std::cout << "Введите номер итерации для получения состояния: ";
+    if (std::cin >> queryIter && !memoStates.empty()) {
+        size_t target = queryIter;
+        if (cycleFound && queryIter >= cycleStart) {
+            target = cycleStart + ((queryIter - cycleStart) % cycleLen);
         }
+        size_t base = std::min(target / 10 * 10, lastMemo);
+        life.setRoot(memoStates[base], base);
+        life.advance(target - base);
+        std::cout << "Состояние на итерации " << queryIter << ": живых клеток " << life.population()
+                  << ", хеш " << life.hash() << "\n";
     }
 
-    return next;
+    std::cout << "Финальное количество живых клеток: " << life.population() << "\n";
+    return 0;
 }
 
 // --------------------------------------------------------------
-// ХЕШИРОВАНИЕ ВСЕГО СОСТОЯНИЯ СЕТКИ
+// САМОПРОВЕРКА
 // --------------------------------------------------------------
 
-// Вычисляет хеш для текущего состояния сетки
-std::size_t hashGrid(const SparseGrid& grid) {
-    // Используем простое комбинирование хешей клеток с использованием простого простого множителя
-    const std::size_t prime = 1000003;
-    std::size_t h = 0;
-    for (const auto& cell : grid) {
-        std::size_t cellHash = CellHash{}(cell);
-        h = h * prime + cellHash;
+// Все разреженные движки дают одинаковые поколения и хеши, а шаг в
+// установившемся режиме не выделяет память
+bool runSelfTest(memoiza::ThreadPool& pool) {
+    const size_t savedN = N;
+    const std::string savedEngine = engineName;
+    N = 600;
+
+    std::mt19937 gen(12345);
+    std::uniform_int_distribution<size_t> dist(0, N - 1);
+    SparseGrid initial;
+    for (int i = 0; i < 60000; i++) {
+        initial.insert(packCell(dist(gen), dist(gen)));
     }
-    return h;
+
+    bool ok = true;
+    memoiza::ThreadPool single(1);
+    memoiza::SparseStepper hashStep(memoiza::SparseMethod::Hash), rowsStep(memoiza::SparseMethod::Rows);
+    for (memoiza::Rule rule : {memoiza::CONWAY_RULE, memoiza::HIGHLIFE_RULE, memoiza::SEEDS_RULE}) {
+        SparseGrid serial = initial, banded = initial, rows = initial, next;
+        memoiza::Hash128 hs = hashGrid(initial), hb = hs, hr = hs;
+        bool same = true;
+        for (int step = 0; step < 20 && same; step++) {
+            hashStep.stepSerial(serial, next, N, N, rule, &hs);
+            std::swap(serial, next);
+            hashStep.step(banded, next, N, N, rule, pool, &hb);
+            std::swap(banded, next);
+            rowsStep.step(rows, next, N, N, rule, pool, &hr);
+            std::swap(rows, next);
+            same = (serial == banded) && (serial == rows) &&
+                   (hs == hashGrid(serial)) && (hb == hs) && (hr == hs);
+        }
+        std::cout << "Движки sparse и rows, правило " << rule.toString() << ": "
+                  << (same ? "совпадают" : "расхождение") << "\n";
+        ok = ok && same;
+    }
+
+    // Ограничение maxLive выбирает одни и те же клетки при любом движке и
+    // числе потоков (полосы и поле целиком) и не выделяет память
+    {
+        const size_t savedMaxLive = maxLive;
+        maxLive = 20000;
+        SparseGrid serial = initial, banded = initial, rows = initial;
+        memoiza::Hash128 hs = hashGrid(initial), hb = hs, hr = hs;
+        bool same = true;
+        uint64_t allocations = 0;
+        for (int step = 0; step < 40 && same; step++) {
+            uint64_t before = memoiza::allocationCount();
+            engineName = "sparse";
+            advanceState(serial, hs, single, 7);
+            advanceState(banded, hb, pool, 7);
+            engineName = "rows";
+            advanceState(rows, hr, pool, 7);
+            if (step >= 10) allocations += memoiza::allocationCount() - before;
+            same = serial == banded && serial == rows && serial.size() <= maxLive &&
+                   hs == hashGrid(serial) && hb == hs && hr == hs;
+        }
+        maxLive = savedMaxLive;
+        std::cout << "Ограничение maxLive: " << (same ? "совпадает" : "расхождение")
+                  << ", выделений памяти за 30 шагов: " << allocations << "\n";
+        ok = ok && same && allocations == 0;
+    }
+
+    for (const char* engine : {"sparse", "rows"}) {
+        engineName = engine;
+        SparseGrid grid = initial;
+        memoiza::Hash128 h = hashGrid(grid);
+        for (int step = 0; step < 10; step++) {
+            stepGrid(grid, h, pool);
+        }
+        uint64_t before = memoiza::allocationCount();
+        for (int step = 0; step < 100; step++) {
+            stepGrid(grid, h, pool);
+        }
+        uint64_t allocations = memoiza::allocationCount() - before;
+        std::cout << "Движок " << engine << ": выделений памяти за 100 шагов: " << allocations
+                  << (allocations == 0 ? "" : " (ожидалось 0)") << "\n";
+        ok = ok && allocations == 0;
+    }
+
+    // После вымирания таблица клеток сжимается до нужной ёмкости
+    SparseGrid burst;
+    for (uint64_t i = 0; i < 100000; i++) burst.insert(packCell(i / 400, i % 400));
+    size_t peak = burst.capacity();
+    burst.clear();
+    for (uint64_t i = 0; i < 5; i++) burst.insert(packCell(7, i));
+    burst.clear();
+    bool shrinkOk = burst.capacity() <= 64 && peak >= 200000 && burst.empty() && burst.insert(packCell(1, 1)) &&
+                    burst.contains(packCell(1, 1)) && burst.size() == 1;
+    std::cout << "Таблица клеток после вымирания: " << peak << " -> " << burst.capacity() << " слотов"
+              << (shrinkOk ? "" : " (расхождение)") << "\n";
+    ok = ok && shrinkOk;
+
+    // Хранилище состояний восстанавливает любую записанную итерацию,
+    // а итерации после начала цикла сворачивает в цикл
+    engineName = "rows";
+    memoiza::CheckpointStore store(16);
+    std::vector<std::vector<Cell>> reference;
+    SparseGrid grid = initial;
+    memoiza::Hash128 h = hashGrid(grid);
+    for (int step = 0; step < 150; step++) {
+        store.append(grid.begin(), grid.end());
+        reference.emplace_back(grid.begin(), grid.end());
+        std::sort(reference.back().begin(), reference.back().end());
+        stepGrid(grid, h, pool);
+    }
+    bool storeOk = true;
+    std::vector<Cell> state;
+    for (uint64_t i = 0; i < reference.size(); i++) {
+        storeOk = storeOk && store.stateAt(i, state) && state == reference[i];
+    }
+    store.setCycle(100, 7);
+    storeOk = storeOk && store.stateAt(100 + 7 * 1000003 + 3, state) && state == reference[103];
+    // Кадры из файла: целые принимаются, повреждённые отвергаются без падения
+    std::vector<uint8_t> bytes = store.encodedData();
+    const std::vector<uint64_t>& offsets = store.encodedOffsets();
+    memoiza::CheckpointStore loaded;
+    storeOk = storeOk && loaded.assignEncoded(16, offsets.size(), offsets.data(), bytes.data(), bytes.size()) &&
+              loaded.stateAt(149, state) && state == reference[149];
+    const uint8_t hugeCount[5] = {0xff, 0xff, 0xff, 0xff, 0x0f};
+    std::copy(hugeCount, hugeCount + 5, bytes.begin());
+    storeOk = storeOk && !loaded.assignEncoded(16, offsets.size(), offsets.data(), bytes.data(), bytes.size()) &&
+              loaded.recorded() == 0;
+    std::fill(bytes.begin(), bytes.end(), uint8_t(0xff));
+    storeOk = storeOk && !loaded.assignEncoded(16, offsets.size(), offsets.data(), bytes.data(), bytes.size());
+    std::cout << "Хранилище состояний: " << (storeOk ? "совпадает" : "расхождение")
+              << " (" << store.bytes() << " байт на " << store.recorded() << " итераций)\n";
+    ok = ok && storeOk;
+
+    // Форматы узоров: запись и разбор RLE и .cells возвращают то же поле,
+    // дерево из потокового разбора совпадает с деревом из setCell, а
+    // Macrocell восстанавливает дерево целиком
+    std::vector<Cell> sorted(grid.begin(), grid.end());
+    std::sort(sorted.begin(), sorted.end());
+    memoiza::HashLife expected;
+    for (Cell cell : sorted) {
+        expected.setCell(static_cast<int64_t>(cellCol(cell)), static_cast<int64_t>(cellRow(cell)), true);
+    }
+    bool patternOk = true;
+    std::string error;
+    memoiza::PatternInfo info;
+    for (int cellsFormat = 0; cellsFormat < 2; cellsFormat++) {
+        std::stringstream text;
+        auto emit = [&](auto& writer) {
+            memoiza::forEachRunSorted(sorted.begin(), sorted.end(),
+                                      [&](int64_t r, int64_t c, int64_t n) { writer.run(r, c, n); });
+            writer.finish();
+        };
+        if (cellsFormat) {
+            memoiza::CellsWriter writer(text);
+            emit(writer);
+        } else {
+            memoiza::RleWriter writer(text, static_cast<int64_t>(N), static_cast<int64_t>(N), lifeRule);
+            emit(writer);
+        }
+        const std::string saved = text.str();
+        auto parse = [&](auto& sink) {
+            std::istringstream in(saved);
+            return cellsFormat ? memoiza::parseCells(in, sink, info, error) : memoiza::parseRle(in, sink, info, error);
+        };
+        SparseGrid parsed;
+        memoiza::SparseSink sparse(parsed);
+        memoiza::HashLife life;
+        memoiza::QuadtreeSink tree(life);
+        patternOk = patternOk && parse(sparse) && parsed == grid && parse(tree);
+        tree.finish();
+        patternOk = patternOk && life.hash() == expected.hash() && life.population() == expected.population();
+    }
+    std::stringstream macrocell;
+    memoiza::writeMacrocell(macrocell, expected);
+    memoiza::HashLife restored;
+    patternOk = patternOk && memoiza::parseMacrocell(macrocell, restored, true, info, error) &&
+                restored.hash() == expected.hash();
+    std::cout << "Форматы узоров (RLE, .cells, Macrocell): " << (patternOk ? "совпадают" : "расхождение " + error)
+              << "\n";
+    ok = ok && patternOk;
+
+    N = savedN;
+    engineName = savedEngine;
+    return ok;
 }
 
 // --------------------------------------------------------------
-// ВЫЧИСЛЕНИЕ ПРОСТОГО КОНТРОЛЬНОГО СУММЫ (НЕОБЯЗАТЕЛЬНО)
+// ЗАПРОС СОСТОЯНИЯ И ФАЙЛ ПОЛЯ
 // --------------------------------------------------------------
 
-// Вычисляет простую контрольную сумму для состояния сетки (необязательно, для верификации)
-std::size_t computeChecksum(const SparseGrid& grid) {
-    std::size_t checksum = 0;
-    for (const auto& cell : grid) {
-        checksum += cell.first * 31 + cell.second;
+// Спрашивает номер итерации и восстанавливает её состояние из хранилища;
+// итерации после начала цикла сворачиваются в цикл
+void answerQuery(const memoiza::CheckpointStore& checkpoints) {
+    size_t queryIter;
+    std::cout << "Введите номер итерации для получения состояния: ";
+    if (std::cin >> queryIter) {
+        uint64_t stored = 0;
+        std::vector<Cell> state;
+        if (checkpoints.resolve(queryIter, stored) && checkpoints.stateAt(queryIter, state)) {
+            std::cout << "Состояние на итерации " << queryIter << " восстановлено";
+            if (stored != queryIter) {
+                std::cout << " (соответствует итерации " << stored << " внутри цикла)";
+            }
+            std::cout << ", живых клеток: " << state.size() << "\n";
+            if (debugMode) {
+                for (Cell cell : state) {
+                    std::cout << "(" << cellRow(cell) << ", " << cellCol(cell) << ") ";
+                }
+                std::cout << "\n";
+            }
+        } else {
+            std::cout << "Состояние на итерации " << queryIter << " недоступно.\n";
+        }
     }
-    return checksum;
+}
+
+// Записать поле (отсортированные ключи клеток) и историю состояний
+bool saveState(const std::string& path, const SparseGrid& grid, uint64_t generation,
+               const memoiza::CheckpointStore& history) {
+    std::vector<Cell> cells(grid.begin(), grid.end());
+    std::sort(cells.begin(), cells.end());
+    memoiza::BoardFileWriter file;
+    return file.open(path, memoiza::makeBoardFileHeader(static_cast<int64_t>(N), static_cast<int64_t>(N),
+                                                        generation, lifeRule, 0)) &&
+           file.writeCells(cells.data(), cells.data() + cells.size()) &&
+           file.writeCheckpoints(history) && file.finish();
 }
 
 // --------------------------------------------------------------
@@ -222,21 +652,84 @@ std::size_t computeChecksum(const SparseGrid& grid) {
 // --------------------------------------------------------------
 
 // Обрабатывает аргументы командной строки для установки параметров
-void parseArguments(int argc, char* argv[], std::string& inputDataFile, bool& debugModeFlag) {
+void parseArguments(int argc, char* argv[], std::string& inputDataFile, bool& debugModeFlag,
+                    unsigned& threads, bool& selfTest) {
     for (int i = 1; i < argc; ++i) {
         if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
             inputDataFile = argv[++i];
         } else if (std::strcmp(argv[i], "--debug") == 0) {
             debugModeFlag = true;
+        } else if (std::strcmp(argv[i], "--selftest") == 0) {
+            selfTest = true;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            engineName = argv[++i];
+            if (engineName != "sparse" && engineName != "rows" && engineName != "hashlife") {
+                std::cerr << "Неизвестный движок: " << engineName << "\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--cycle") == 0 && i + 1 < argc) {
+            cycleMode = argv[++i];
+            if (cycleMode != "map" && cycleMode != "brent") {
+                std::cerr << "Неизвестный режим поиска цикла: " << cycleMode << "\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            sizeOverride = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+            if (sizeOverride == 0 || sizeOverride > (size_t(1) << 32) - 1) {
+                std::cerr << "Неверный размер поля: " << argv[i] << "\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--rule") == 0 && i + 1 < argc) {
+            ruleGiven = true;
+            if (!memoiza::parseRule(argv[++i], lifeRule)) {
+                std::cerr << "Неверное правило: " << argv[i] << " (например, B3/S23 или B36/S23)\n";
+                exit(1);
+            }
+            // Разреженные движки рассматривают только клетки рядом с живыми
+            if (lifeRule.birth & 1u) {
+                std::cerr << "Правило " << lifeRule.toString()
+                          << " с B0 не поддерживается движками sparse, rows и hashlife\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            loadFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            saveFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--pattern") == 0 && i + 1 < argc) {
+            patternFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            exportFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--max-iter") == 0 && i + 1 < argc) {
+            maxIterations = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metricsFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--metrics-every") == 0 && i + 1 < argc) {
+            metricsEvery = std::strtoull(argv[++i], nullptr, 10);
         } else if (std::strcmp(argv[i], "--help") == 0) {
-            std::cout << "Использование: " << argv[0] << " [--input <файл>] [--debug]\n";
+            std::cout << "Использование: " << argv[0] << " [--input <файл>] [--debug] [--selftest] [--threads <n>] [--size <n>]"
+                      << " [--engine sparse|rows|hashlife] [--rule B3/S23] [--cycle map|brent] [--max-iter <n>]"
+                      << " [--load <файл>] [--save <файл>] [--pattern <файл>] [--export <файл>]"
+                      << " [--metrics <файл|-> [--metrics-every <n>]]\n";
             exit(0);
         } else {
             std::cerr << "Неизвестный аргумент: " << argv[i] << "\n";
-            std::cout << "Использование: " << argv[0] << " [--input <файл>] [--debug]\n";
+            std::cout << "Использование: " << argv[0] << " [--input <файл>] [--debug] [--selftest] [--threads <n>] [--size <n>]"
+                      << " [--engine sparse|rows|hashlife] [--rule B3/S23] [--cycle map|brent] [--max-iter <n>]"
+                      << " [--load <файл>] [--save <файл>] [--pattern <файл>] [--export <файл>]"
+                      << " [--metrics <файл|-> [--metrics-every <n>]]\n";
             exit(1);
         }
     }
+    if (!exportFile.empty() && cycleMode == "brent" && engineName != "hashlife") {
+        std::cerr << "--export не работает в режиме --cycle brent\n";
+        exit(1);
+    }
+    if (!saveFile.empty() && (engineName == "hashlife" || cycleMode == "brent")) {
+        std::cerr << "--save работает с движками sparse и rows в режиме --cycle map\n";
+        exit(1);
+    }
 }
 
 // --------------------------------------------------------------
@@ -249,158 +742,284 @@ int main(int argc, char* argv[]) {
 
     // Обрабатываем аргументы командной строки
     std::string inputDataFile = "";
-    parseArguments(argc, argv, inputDataFile, debugMode);
-
-    // Читаем input_data
-    std::string input_data;
-    if (!inputDataFile.empty()) {
-        std::ifstream infile(inputDataFile);
-        if (!infile) {
-            std::cerr << "Ошибка: Невозможно открыть входной файл: " << inputDataFile << "\n";
+    unsigned threads = std::thread::hardware_concurrency();
+    bool selfTest = false;
+    parseArguments(argc, argv, inputDataFile, debugMode, threads, selfTest);
+
+    // Пул потоков создаётся один раз на весь запуск
+    memoiza::ThreadPool pool(threads);
+    if (selfTest) {
+        return runSelfTest(pool) ? 0 : 1;
+    }
+
+    // Метрики пишутся в файл или в stderr ("-"), чтобы не смешиваться с отчётом
+    std::ofstream metricsOut;
+    if (metricsFile == "-") {
+        metrics.open(std::cerr, metricsEvery);
+    } else if (!metricsFile.empty()) {
+        metricsOut.open(metricsFile);
+        if (!metricsOut) {
+            std::cerr << "Ошибка: не удалось открыть " << metricsFile << "\n";
+            return 1;
+        }
+        metrics.open(metricsOut, metricsEvery);
+    }
+
+    // Seed запуска для ограничения maxLive (см. enforceMaxLive)
+    uint32_t runSeed = 0;
+    SparseGrid current;
+
+    if (!patternFile.empty() && engineName == "hashlife") {
+        // Дерево строится прямо из файла, без списка клеток
+        memoiza::HashLife life;
+        memoiza::PatternInfo info;
+        std::string error;
+        life.setRule(lifeRule);
+        if (!memoiza::readPattern(patternFile, life, !ruleGiven, info, error)) {
+            std::cerr << "Ошибка: " << patternFile << ": " << error << "\n";
+            return 1;
+        }
+        lifeRule = life.rule();
+        return runHashLife(life, maxIterations);
+    }
+
+    if (!patternFile.empty()) {
+        memoiza::PatternInfo info;
+        memoiza::SparseSink sink(current);
+        std::string error;
+        if (!memoiza::readPattern(patternFile, sink, info, error)) {
+            std::cerr << "Ошибка: " << patternFile << ": " << error << "\n";
+            return 1;
+        }
+        if (info.hasRule && !ruleGiven) {
+            if (info.rule.birth & 1u) {
+                std::cerr << "Ошибка: правило " << info.rule.toString() << " из узора содержит B0\n";
+                return 1;
+            }
+            lifeRule = info.rule;
+        }
+        size_t extent = static_cast<size_t>(std::max<int64_t>(std::max(info.width, info.height), 1));
+        for (Cell cell : current) extent = std::max<size_t>(extent, std::max(cellRow(cell), cellCol(cell)) + 1);
+        N = sizeOverride != 0 ? sizeOverride : extent;
+        if (sink.clipped() > 0 || N < extent) {
+            std::cerr << "Ошибка: узор не помещается в поле " << N << "x" << N << "\n";
+            return 1;
+        }
+        // Как и для --load: число клеток задаёт узор, ограничение — только размер поля
+        maxLive = N * N;
+        LOG_DEBUG("Узор загружен из " + patternFile + ": живых клеток " + std::to_string(current.size()));
+    } else if (!loadFile.empty()) {
+        // Файл отображается в память: клетки берутся прямо из него
+        memoiza::BoardFileReader file;
+        std::string error;
+        if (!file.open(loadFile, error)) {
+            std::cerr << "Ошибка: " << loadFile << ": " << error << "\n";
+            return 1;
+        }
+        lifeRule = file.rule();
+        if (lifeRule.birth & 1u) {
+            std::cerr << "Ошибка: правило " << lifeRule.toString() << " из файла содержит B0\n";
+            return 1;
+        }
+
+        // История с найденным циклом: на запрос отвечаем без симуляции
+        memoiza::CheckpointStore history(KEYFRAME_INTERVAL);
+        if (file.loadCheckpoints(history) && history.cycleLength() != 0) {
+            std::cout << "История загружена: " << history.recorded() << " итераций, цикл начинается с итерации "
+                      << history.cycleStart() << " и имеет длину " << history.cycleLength() << ".\n";
+            answerQuery(history);
+            return 0;
+        }
+
+        const Cell* first;
+        const Cell* last;
+        memoiza::BitGrid dense;
+        size_t extent = 0;  // строк и столбцов, занятых клетками
+        if (file.cells(first, last)) {
+            current.reserve(static_cast<size_t>(last - first));
+            for (const Cell* p = first; p != last; ++p) {
+                current.insert(*p);
+                extent = std::max<size_t>(extent, std::max(cellRow(*p), cellCol(*p)) + 1);
+            }
+        } else if (file.loadDense(dense)) {
+            // Обход по отрезкам живых клеток: пустые слова поля пропускаются целиком
+            current.reserve(dense.population());
+            memoiza::forEachRunDense(dense, [&](int64_t r, int64_t c, int64_t n) {
+                for (int64_t i = 0; i < n; i++) current.insert(packCell(r, c + i));
+            });
+            extent = static_cast<size_t>(std::max(dense.rows(), dense.cols()));
+        } else {
+            std::cerr << "Ошибка: в файле " << loadFile << " нет поля\n";
             return 1;
         }
-        std::ostringstream ss;
-        ss << infile.rdbuf();
-        input_data = ss.str();
-        infile.close();
+        size_t fileSize = static_cast<size_t>(std::max<int64_t>(file.header().rows, file.header().cols));
+        N = sizeOverride != 0 ? sizeOverride : std::max(fileSize, extent);
+        if (N < extent) {
+            std::cerr << "Ошибка: поле из файла не помещается в " << N << "x" << N << "\n";
+            return 1;
+        }
+        // Число клеток задаёт файл, а не input_data: ограничение — только размер поля
+        maxLive = N * N;
+        LOG_DEBUG("Поле загружено из " + loadFile + ": поколение " + std::to_string(file.header().generation) +
+                  ", живых клеток " + std::to_string(current.size()));
     } else {
-        // Если файл не указан, запрашиваем ввод у пользователя или используем строку по умолчанию
-        std::cout << "Введите строку input_data (или оставьте пустым для использования значения по умолчанию): ";
-        std::getline(std::cin, input_data);
-        if (input_data.empty()) {
-            input_data = "DefaultInputData";
+        // Читаем input_data
+        std::string input_data;
+        if (!inputDataFile.empty()) {
+            std::ifstream infile(inputDataFile);
+            if (!infile) {
+                std::cerr << "Ошибка: Невозможно открыть входной файл: " << inputDataFile << "\n";
+                return 1;
+            }
+            std::ostringstream ss;
+            ss << infile.rdbuf();
+            input_data = ss.str();
+            infile.close();
+        } else {
+            // Если файл не указан, запрашиваем ввод у пользователя или используем строку по умолчанию
+            std::cout << "Введите строку input_data (или оставьте пустым для использования значения по умолчанию): ";
+            std::getline(std::cin, input_data);
+            if (input_data.empty()) {
+                input_data = "DefaultInputData";
+            }
         }
+
+        // Устанавливаем размер сетки N и максимальное количество живых клеток maxLive на основе длины input_data
+        N = sizeOverride != 0 ? sizeOverride : input_data.size();
+        maxLive = std::min<size_t>(input_data.size(), N * N);
     }
 
-    // Устанавливаем размер сетки N и максимальное количество живых клеток maxLive на основе длины input_data
-    N = input_data.size();
-    maxLive = input_data.size();
+    LOG_DEBUG("Размер сетки установлен на " + std::to_string(N) + "x" + std::to_string(N));
+    LOG_DEBUG("Максимальное количество живых клеток установлено на " + std::to_string(maxLive));
 
-    logMessage("Размер сетки установлен на " + std::to_string(N) + "x" + std::to_string(N));
-    logMessage("Максимальное количество живых клеток установлено на " + std::to_string(maxLive));
+    runSeed = static_cast<uint32_t>(gen());
 
-    // Генерируем начальную конфигурацию
-    auto current = generateInitialConfiguration(N, maxLive, gen);
-    logMessage("Начальная конфигурация сгенерирована. Количество живых клеток = " + std::to_string(current.size()));
+    // Генерируем начальную конфигурацию (если поле не загружено из файла)
+    if (loadFile.empty() && patternFile.empty()) {
+        current = generateInitialConfiguration(N, maxLive, gen);
+        LOG_DEBUG("Начальная конфигурация сгенерирована. Количество живых клеток = " + std::to_string(current.size()));
+    }
 
     // Подготовка к обнаружению цикла
     // Map: хеш -> номер итерации
-    std::unordered_map<std::size_t, size_t> visited;
+    std::unordered_map<memoiza::Hash128, size_t, memoiza::Hash128Hasher> visited;
     visited.reserve(10000); // Резервируем место для 10,000 записей
 
     // Параметры
-    size_t maxIterations = 2000; // Лимит итераций для поиска цикла
     bool cycleFound = false;
     size_t cycleStart = 0;
     size_t cycleLen = 0;
 
-    // Мемоизация: сохраняем состояния на каждые 10 итераций
-    std::unordered_map<size_t, SparseGrid> memoStates;
-    memoStates.reserve(maxIterations / 10 + 1);
+    // Альтернативный движок: тот же поиск цикла на HashLife
+    if (engineName == "hashlife") {
+        memoiza::HashLife life;
+        life.setRule(lifeRule);
+        for (Cell cell : current) {
+            life.setCell(static_cast<int64_t>(cellCol(cell)), static_cast<int64_t>(cellRow(cell)), true);
+        }
+        return runHashLife(life, maxIterations);
+    }
+    if (cycleMode == "brent") {
+        return runBrent(current, pool, runSeed);
+    }
+
+    // Состояния всех итераций: ключевые кадры и дельты между ними
+    memoiza::CheckpointStore checkpoints(KEYFRAME_INTERVAL);
+    std::vector<Cell> earlier, now;
 
-    // Цикл симуляции
-    for (size_t iter = 0; iter < maxIterations; iter++) {
+    // Хеш считается целиком один раз, дальше — инкрементально
+    memoiza::Hash128 currentHash = hashGrid(current);
+
+    // Цикл симуляции; после него current — состояние итерации iter
+    size_t iter = 0;
+    for (; iter < maxIterations; iter++) {
         // Логирование каждые 10 итераций
         if (iter % 10 == 0) {
-            std::ostringstream oss;
-            oss << "Итерация = " << iter << ", Живых клеток = " << current.size();
-            logMessage(oss.str());
+            LOG_DEBUG("Итерация = " + std::to_string(iter) + ", Живых клеток = " + std::to_string(current.size()));
+        }
+        if (metrics.due(iter)) {
+            metrics.set(memoiza::Counter::LiveCells, current.size());
+            metrics.dump(iter);
         }
-
-        // Вычисляем хеш текущего состояния сетки
-        std::size_t currentHash = hashGrid(current);
 
         // Проверяем, не встречался ли уже такой хеш
+        auto cycleTimer = metrics.time(memoiza::Phase::CycleCheck);
         auto it = visited.find(currentHash);
         if (it != visited.end()) {
-            // Цикл обнаружен
-            cycleFound = true;
-            cycleStart = it->second;
-            cycleLen = iter - cycleStart;
-            logMessage("Цикл обнаружен! Начало цикла на итерации " + std::to_string(cycleStart) +
-                       ", Длина цикла = " + std::to_string(cycleLen) +
-                       ", Текущая итерация = " + std::to_string(iter));
-            break;
+            // Совпадение хеша — кандидат. Восстанавливаем то состояние из
+            // хранилища и сравниваем клетки.
+            checkpoints.stateAt(it->second, earlier);
+            now.assign(current.begin(), current.end());
+            std::sort(now.begin(), now.end());
+            if (earlier == now) {
+                // Цикл обнаружен
+                cycleFound = true;
+                cycleStart = it->second;
+                cycleLen = iter - cycleStart;
+                LOG_DEBUG("Цикл обнаружен! Начало цикла на итерации " + std::to_string(cycleStart) +
+                          ", Длина цикла = " + std::to_string(cycleLen) +
+                          ", Текущая итерация = " + std::to_string(iter));
+                break;
+            }
+            LOG_DEBUG("Коллизия хеша с итерацией " + std::to_string(it->second) + ", продолжаем.");
         } else {
             // Сохраняем текущий хеш с номером итерации
             visited[currentHash] = iter;
         }
+        cycleTimer.stop();
 
-        // Мемоизация: сохраняем состояние каждые 10 итераций
-        if (iter % 10 == 0) {
-            memoStates[iter] = current;
-            logMessage("Состояние на итерации " + std::to_string(iter) + " сохранено для мемоизации.");
-        }
-
-        // Вычисляем следующее поколение
-        auto nxt = nextGeneration(current, N);
-        current = std::move(nxt);
-
-        // Проверяем и ограничиваем количество живых клеток до maxLive
-        if (current.size() > maxLive) {
-            size_t toRemove = current.size() - maxLive;
-            logMessage("Количество живых клеток превышает maxLive. Удаляем " + std::to_string(toRemove) + " клеток.");
-
-            // Сохраняем живые клетки в вектор для случайного удаления
-            std::vector<Cell> cells(current.begin(), current.end());
+        // Запоминаем состояние итерации (дельтой или ключевым кадром)
+        auto recordTimer = metrics.time(memoiza::Phase::Record);
+        checkpoints.append(current.begin(), current.end());
+        recordTimer.stop();
 
-            // Перемешиваем вектор для случайного порядка удаления
-            std::shuffle(cells.begin(), cells.end(), gen);
-
-            // Удаляем первые 'toRemove' клеток из перемешанного списка
-            for (size_t i = 0; i < toRemove && i < cells.size(); ++i) {
-                current.erase(cells[i]);
-                logMessage("Удалена клетка (" + std::to_string(cells[i].first) + ", " +
-                           std::to_string(cells[i].second) + ")");
-            }
-        }
+        // Вычисляем следующее поколение и ограничиваем число живых клеток
+        // до maxLive; хеш обновляется по родившимся и удалённым клеткам
+        advanceState(current, currentHash, pool, runSeed);
 
         // Дополнительно: можно добавить паузу для наблюдения (опционально)
         // std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
 
+    metrics.set(memoiza::Counter::LiveCells, current.size());
+    metrics.finish(iter);
+
     // Отчет после завершения симуляции
     if (cycleFound) {
         std::cout << "Цикл обнаружен!\n";
         std::cout << "Цикл начинается с итерации " << cycleStart << " и имеет длину " << cycleLen << ".\n";
 
-        // Пример: доступ к состоянию на определенной итерации с использованием информации о цикле
-        size_t queryIter;
-        std::cout << "Введите номер итерации для получения состояния: ";
-        std::cin >> queryIter;
-
-        if (queryIter < cycleStart) {
-            // Если запрашиваемая итерация была мемоизирована
-            auto it_memo = memoStates.find(queryIter);
-            if (it_memo != memoStates.end()) {
-                std::cout << "Состояние на итерации " << queryIter << " получено из мемоизации.\n";
-                // Здесь можно добавить код для отображения или обработки состояния
-            } else {
-                std::cout << "Состояние на итерации " << queryIter << " не было мемоизировано.\n";
-            }
-        } else {
-            // Вычисляем эквивалентную итерацию внутри цикла
-            size_t equivalentIter = cycleStart + ((queryIter - cycleStart) % cycleLen);
-            auto it_memo = memoStates.find(equivalentIter);
-            if (it_memo != memoStates.end()) {
-                std::cout << "Состояние на итерации " << queryIter << " соответствует итерации " <<
-                             equivalentIter << " внутри цикла.\n";
-                // Здесь можно добавить код для отображения или обработки состояния
-            } else {
-                std::cout << "Эквивалентное состояние для итерации " << queryIter << " не было мемоизировано.\n";
-            }
-        }
+        // Состояние любой итерации: итерации после начала цикла сворачиваются
+        // в цикл, затем кадр восстанавливается из хранилища
+        checkpoints.setCycle(cycleStart, cycleLen);
+        answerQuery(checkpoints);
     } else {
         std::cout << "Цикл не обнаружен за " << maxIterations << " итераций.\n";
-        std::cout << "Состояния каждые 10 итераций были мемоизированы для быстрого доступа.\n";
+    }
+    LOG_DEBUG("Хранилище состояний: " + std::to_string(checkpoints.recorded()) + " итераций, " +
+              std::to_string(checkpoints.bytes()) + " байт");
+
+    if (!saveFile.empty()) {
+        if (!saveState(saveFile, current, iter, checkpoints)) {
+            std::cerr << "Ошибка: не удалось записать " << saveFile << "\n";
+            return 1;
+        }
+        LOG_DEBUG("Поле и история состояний записаны в " + saveFile);
+    }
+    if (!exportFile.empty()) {
+        if (!exportPattern(exportFile, current)) {
+            std::cerr << "Ошибка: не удалось записать узор " << exportFile << "\n";
+            return 1;
+        }
+        LOG_DEBUG("Поле записано в " + exportFile);
     }
 
     // Отчет о финальном состоянии
     std::cout << "Финальное количество живых клеток: " << current.size() << "\n";
     if (debugMode) {
         std::cout << "Финальные живые клетки:\n";
-        for (const auto& cell : current) {
-            std::cout << "(" << cell.first << ", " << cell.second << ") ";
+        for (Cell cell : current) {
+            std::cout << "(" << cellRow(cell) << ", " << cellCol(cell) << ") ";
         }
         std::cout << "\n";
     }
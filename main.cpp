@@ -5,17 +5,103 @@
 #include <iomanip>    // Для std::setw
 #include <chrono>
 #include <thread>
+#include <random>
+#include <cstdio>    // для std::sscanf
+#include <cstring>   // для std::strcmp
+#include <cstdlib>   // для std::atoi
+#include <fstream>
+#include <algorithm>
 
-// Размеры поля
-static const int ROWS = 20;
-static const int COLS = 20;
+// Этот файл содержит main(): здесь подменяется operator new для подсчёта выделений
+#define MEMOIZA_COUNT_ALLOCATIONS
+#include "memoiza/alloc_counter.hpp"
 
-// Тип сетки
+#include "memoiza/active_grid.hpp"
+#include "memoiza/board.hpp"
+#include "memoiza/board_file.hpp"
+#include "memoiza/cycle_detect.hpp"
+#include "memoiza/engine.hpp"
+#include "memoiza/fast_forward.hpp"
+#include "memoiza/metrics.hpp"
+#include "memoiza/parallel_step.hpp"
+#include "memoiza/pattern_io.hpp"
+#include "memoiza/renderer.hpp"
+#include "memoiza/seed_search.hpp"
+#include "memoiza/zobrist.hpp"
+
+// Размеры поля (--size RxC)
+static int boardRows = 20;
+static int boardCols = 20;
+static bool sizeGiven = false;
+
+// Поле свёрнуто в тор (--topology torus): за краем — противоположный край
+static bool torus = false;
+
+// Тип сетки (поклеточное представление, эталон для проверки)
 using Grid = std::vector<std::vector<int>>;
 
+// Битовая сетка: 64 клетки в слове, используется для симуляции
+using memoiza::BitGrid;
+
 // Флаг для включения/отключения отладочного вывода
 static bool debugMode = false;
 
+// До скольки итераций ищем цикл (--max-iter)
+static long long maxIter = 2000;
+
+// Поиск цикла алгоритмом Брента: O(1) состояний вместо словаря хешей
+static bool useBrent = false;
+
+// Нужная длина цикла (--period)
+static long long requiredCycleLen = 10;
+
+// Пакетный поиск (--search <n>): перебрать n случайных полей во всех потоках
+static memoiza::SeedSearchOptions searchOptions;
+static bool searchMode = false;
+
+// Начальное поле — смесь с заданным зерном (--soup), например найденная
+// пакетным поиском; иначе глайдер
+static bool useSoup = false;
+static std::uint64_t soupSeedValue = 0;
+
+// Двоичный файл поля (memoiza/board_file.hpp): --load задаёт начальное
+// поле, его размер, топологию и правило; --save записывает итоговое поле
+static std::string loadFile;
+static std::string saveFile;
+
+// Узор в стандартном формате (memoiza/pattern_io.hpp: .rle, .cells, .mc):
+// --pattern задаёт начальное поле (размер — по узору, если нет --size),
+// --export записывает итоговое поле; формат — по расширению
+static std::string patternFile;
+static std::string exportFile;
+
+// Поколение, состояние которого нужно после поиска цикла (--at): оно
+// печатается и записывается вместо итогового поля (--save, --export)
+static std::uint64_t atGeneration = 0;
+static bool atGiven = false;
+
+// Снимки поля для перемотки к любому поколению: не больше MAX_SNAPSHOTS
+// и не больше SNAPSHOT_BYTES памяти. Число ограничено и для маленьких
+// полей: при прореживании снимок копируется всё реже, и цикл итераций
+// почти не выделяет памяти.
+static const std::size_t MAX_SNAPSHOTS = 64;
+static const std::size_t SNAPSHOT_BYTES = std::size_t(256) << 20;
+
+// Правило задано явно (--rule): правило из файла узора не применяется
+static bool ruleGiven = false;
+
+// Кадров в секунду при анимации поиска цикла (--fps); кадры рисует
+// отдельный поток, симуляция их не ждёт. 0 — без анимации.
+static int renderFps = 10;
+
+// Число потоков для шага (вызывающий поток тоже считается)
+static unsigned threadCount = std::thread::hardware_concurrency();
+
+// Метрики (memoiza/metrics.hpp): --metrics <файл|-> и --metrics-every <n>
+static memoiza::Metrics metrics;
+static std::string metricsFile;
+static std::uint64_t metricsEvery = 100;
+
 // Простейшая функция хеширования сетки
 std::size_t hashGrid(const Grid& grid) {
     std::size_t h = 0;
@@ -27,47 +113,70 @@ std::size_t hashGrid(const Grid& grid) {
     return h;
 }
 
+// Хеш битовой сетки: 128-битный Зобрист, не зависит от порядка обхода
+memoiza::Hash128 hashGrid(const BitGrid& grid) {
+    return memoiza::zobristHash(grid);
+}
+
+// Преобразование поклеточной сетки в битовую
+BitGrid toBitGrid(const Grid& g) {
+    const int rows = static_cast<int>(g.size());
+    const int cols = rows > 0 ? static_cast<int>(g[0].size()) : 0;
+    BitGrid bits(rows, cols);
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            if (g[r][c]) bits.set(r, c, true);
+        }
+    }
+    return bits;
+}
+
+// Обратное преобразование (для отладочного поклеточного пути)
+Grid toGrid(const BitGrid& bits) {
+    Grid g(bits.rows(), std::vector<int>(bits.cols(), 0));
+    for (int r = 0; r < bits.rows(); r++) {
+        for (int c = 0; c < bits.cols(); c++) {
+            g[r][c] = bits.get(r, c) ? 1 : 0;
+        }
+    }
+    return g;
+}
+
 // Подсчёт соседей для "Игры Жизнь"
 int countNeighbors(const Grid &g, int r, int c, bool verbose = false) {
+    const int rows = static_cast<int>(g.size());
+    const int cols = static_cast<int>(g[0].size());
     int count = 0;
-    if (verbose) {
-        std::cout << "  [Debug] Подсчёт соседей для клетки (" << r << "," << c << "): ";
-    }
+    MEMOIZA_TRACE(verbose, std::cout << "  [Debug] Подсчёт соседей для клетки (" << r << "," << c << "): ");
     for (int dr = -1; dr <= 1; dr++) {
         for (int dc = -1; dc <= 1; dc++) {
             if (dr == 0 && dc == 0) continue;
             int rr = r + dr;
             int cc = c + dc;
-            if (rr >= 0 && rr < ROWS && cc >= 0 && cc < COLS) {
+            if (torus) {
+                rr = (rr + rows) % rows;
+                cc = (cc + cols) % cols;
+            }
+            if (rr >= 0 && rr < rows && cc >= 0 && cc < cols) {
                 count += g[rr][cc];
-                if (verbose) {
-                    std::cout << "[" << rr << "," << cc << "]=" << g[rr][cc] << " ";
-                }
+                MEMOIZA_TRACE(verbose, std::cout << "[" << rr << "," << cc << "]=" << g[rr][cc] << " ");
             }
         }
     }
-    if (verbose) {
-        std::cout << "=> Всего живых соседей: " << count << "\n";
-    }
+    MEMOIZA_TRACE(verbose, std::cout << "=> Всего живых соседей: " << count << "\n");
     return count;
 }
 
-// Правило "Игры Жизнь"
+// Правило автомата (--rule, по умолчанию B3/S23 — "Игра Жизнь")
 int transitionRule(int cell, int neighbors) {
-    if (cell == 1) {
-        // Живая клетка выживает при 2 или 3 соседях
-        return (neighbors == 2 || neighbors == 3) ? 1 : 0;
-    } else {
-        // Мёртвая клетка оживает при ровно 3 соседях
-        return (neighbors == 3) ? 1 : 0;
-    }
+    return memoiza::activeRule().next(cell == 1, neighbors) ? 1 : 0;
 }
 
 // Выполняем один шаг (итерацию) автомата
 Grid nextGeneration(const Grid &g, bool verbose = false) {
     Grid newG = g;
-    for (int r = 0; r < ROWS; r++) {
-        for (int c = 0; c < COLS; c++) {
+    for (int r = 0; r < static_cast<int>(g.size()); r++) {
+        for (int c = 0; c < static_cast<int>(g[r].size()); c++) {
             int n = countNeighbors(g, r, c, verbose);
             newG[r][c] = transitionRule(g[r][c], n);
         }
@@ -75,140 +184,977 @@ Grid nextGeneration(const Grid &g, bool verbose = false) {
     return newG;
 }
 
+// Пул создаётся один раз при первом шаге и живёт до конца программы
+memoiza::ThreadPool& stepPool() {
+    static memoiza::ThreadPool pool(threadCount);
+    return pool;
+}
+
+// Шаг на месте без выделения памяти: следующее поколение пишется в
+// запасной буфер, затем буферы меняются местами
+void stepInPlace(BitGrid& g) {
+    static BitGrid spare;
+    if (spare.rows() != g.rows() || spare.cols() != g.cols()) {
+        spare = BitGrid(g.rows(), g.cols());
+    }
+    if (torus) {
+        memoiza::stepWithEdges<memoiza::TorusEdges>(g, spare, stepPool());
+    } else {
+        memoiza::stepWithEdges<memoiza::BoundedEdges>(g, spare, stepPool());
+    }
+    std::swap(g, spare);
+}
+
+// Шаг на битовой сетке: 64 клетки за операцию, без проверок границ.
+// В режиме отладки идём поклеточным путём, чтобы видеть подсчёт соседей.
+BitGrid nextGeneration(BitGrid g, bool verbose = false) {
+    if (verbose) {
+        return toBitGrid(nextGeneration(toGrid(g), true));
+    }
+    stepInPlace(g);
+    return g;
+}
+
+// Проверка: каждое доступное ядро даёт побитово тот же результат,
+// что и поклеточный nextGeneration, на случайных полях разных размеров
+bool runSelfTest() {
+    torus = false;
+    std::mt19937 gen(12345);
+    bool ok = true;
+    for (const auto& kernel : memoiza::availableStepKernels()) {
+        for (int t = 0; t < 40 && ok; t++) {
+            int rows = 1 + static_cast<int>(gen() % 48);
+            int cols = 1 + static_cast<int>(gen() % 700);
+            unsigned density = 1 + gen() % 4;
+            Grid ref(rows, std::vector<int>(cols, 0));
+            for (auto &row : ref) {
+                for (auto &cell : row) cell = (gen() % density == 0) ? 1 : 0;
+            }
+            BitGrid cur = toBitGrid(ref);
+            BitGrid next(rows, cols);
+            for (int step = 0; step < 8 && ok; step++) {
+                ref = nextGeneration(ref);
+                kernel.stepRows(cur, next, 0, rows);
+                std::swap(cur, next);
+                if (cur != toBitGrid(ref)) {
+                    std::cout << "Ядро " << kernel.name << ": расхождение на поле "
+                              << rows << "x" << cols << ", шаг " << step + 1 << "\n";
+                    ok = false;
+                }
+            }
+        }
+        if (ok) {
+            std::cout << "Ядро " << kernel.name << ": совпадает с эталоном\n";
+        }
+    }
+
+    // Параллельный шаг по полосам должен давать тот же результат
+    memoiza::ThreadPool pool(4);
+    Grid ref(300, std::vector<int>(500, 0));
+    for (auto &row : ref) {
+        for (auto &cell : row) cell = (gen() % 3 == 0) ? 1 : 0;
+    }
+    BitGrid cur = toBitGrid(ref);
+    BitGrid next(cur.rows(), cur.cols());
+    for (int step = 0; step < 8 && ok; step++) {
+        ref = nextGeneration(ref);
+        memoiza::stepBitGridParallel(cur, next, pool);
+        std::swap(cur, next);
+        ok = (cur == toBitGrid(ref));
+    }
+    std::cout << "Параллельный шаг: " << (ok ? "совпадает с эталоном" : "расхождение") << "\n";
+
+    // Шаг по активным тайлам: редкие осцилляторы на неподвижном фоне,
+    // затем добавленная клетка будит соседние тайлы
+    Grid still(200, std::vector<int>(300, 0));
+    for (int r = 2; r + 2 < 200; r += 6) {
+        for (int c = 2; c + 2 < 200; c += 6) {
+            still[r][c] = still[r + 1][c] = still[r][c + 1] = still[r + 1][c + 1] = 1;
+        }
+    }
+    for (int k = 0; k < 5; k++) {
+        int r = 10 + 40 * k;
+        int c = 220 + static_cast<int>(gen() % 60);
+        still[r][c] = still[r][c + 1] = still[r][c + 2] = 1;
+    }
+    memoiza::ActiveGrid active(toBitGrid(still));
+    memoiza::Hash128 h = hashGrid(active.current());
+    bool activeOk = true;
+    for (int step = 0; step < 40 && activeOk; step++) {
+        if (step == 20) {
+            still[100][150] = 1;
+            active.set(100, 150, true);
+            h = hashGrid(active.current());
+        }
+        still = nextGeneration(still);
+        active.step(pool);
+        active.forEachFlip([&](int r, int c) { h ^= memoiza::cellKey(r, c); });
+        activeOk = (active.current() == toBitGrid(still)) && (h == hashGrid(active.current()));
+    }
+    std::cout << "Шаг по активным тайлам: " << (activeOk ? "совпадает с эталоном" : "расхождение")
+              << " (пересчитано тайлов: " << active.lastActiveTiles() << " из "
+              << active.tileCount() << ")\n";
+
+    // Тор и неограниченная плоскость через общий интерфейс Board
+    torus = true;
+    Grid ring(37, std::vector<int>(70, 0));
+    for (auto &row : ring) {
+        for (auto &cell : row) cell = (gen() % 3 == 0) ? 1 : 0;
+    }
+    auto wrapped = memoiza::makeBoard(memoiza::Topology::Torus, 37, 70, pool);
+    for (int r = 0; r < 37; r++) {
+        for (int c = 0; c < 70; c++) wrapped->set(r, c, ring[r][c] != 0);
+    }
+    bool boardOk = true;
+    for (int step = 0; step < 20 && boardOk; step++) {
+        ring = nextGeneration(ring);
+        wrapped->step();
+        for (int r = 0; r < 37 && boardOk; r++) {
+            for (int c = 0; c < 70; c++) {
+                if (wrapped->get(r, c) != (ring[r][c] != 0)) boardOk = false;
+            }
+        }
+    }
+    torus = false;
+    // Глайдер далеко от начала координат ведёт себя так же, как в центре поля
+    const std::int64_t far = std::int64_t(1) << 40;
+    auto plane = memoiza::makeBoard(memoiza::Topology::Plane, 0, 0, pool);
+    auto boxed = memoiza::makeBoard(memoiza::Topology::Bounded, 64, 64, pool);
+    const int glider[5][2] = {{1, 0}, {2, 1}, {0, 2}, {1, 2}, {2, 2}};
+    for (const auto& cell : glider) {
+        plane->set(cell[0] - far, cell[1] + far, true);
+        boxed->set(cell[0] + 8, cell[1] + 8, true);
+    }
+    plane->advance(64);
+    boxed->advance(64);
+    boardOk = boardOk && plane->population() == boxed->population();
+    boxed->forEachLive([&](std::int64_t r, std::int64_t c) {
+        if (!plane->get(r - 8 - far, c - 8 + far)) boardOk = false;
+    });
+    // Со сборкой мусора плоскость считает то же, что и без неё, а узлов держит меньше
+    memoiza::PlaneBoard collected(2000), unlimited(std::size_t(-1));
+    const int rPentomino[5][2] = {{0, 1}, {0, 2}, {1, 0}, {1, 1}, {2, 1}};
+    for (const auto& cell : rPentomino) {
+        collected.set(cell[0], cell[1], true);
+        unlimited.set(cell[0], cell[1], true);
+    }
+    for (int step = 0; step < 300; step++) {
+        collected.step();
+        unlimited.step();
+    }
+    collected.advance(1000);
+    unlimited.advance(1000);
+    boardOk = boardOk && collected.hash() == unlimited.hash() && collected.population() == unlimited.population() &&
+              collected.nodeCount() < unlimited.nodeCount();
+    std::cout << "Тор и плоскость: " << (boardOk ? "совпадают с эталоном" : "расхождение") << "\n";
+
+    // В установившемся режиме шаг не выделяет память: буферы меняются
+    // ролями, а рабочие списки сохраняют ёмкость
+    BitGrid soup = toBitGrid(ref);
+    memoiza::ActiveGrid busy(soup);
+    for (int step = 0; step < 8; step++) {
+        busy.step(pool);
+        stepInPlace(soup);
+    }
+    std::uint64_t before = memoiza::allocationCount();
+    for (int step = 0; step < 100; step++) {
+        busy.step(pool);
+        busy.forEachFlip([&](int r, int c) { h ^= memoiza::cellKey(r, c); });
+        stepInPlace(soup);
+    }
+    std::uint64_t allocations = memoiza::allocationCount() - before;
+    bool allocOk = (allocations == 0) && (busy.current() == soup);
+    std::cout << "Выделений памяти за 100 шагов: " << allocations
+              << (allocOk ? "" : " (ожидалось 0)") << "\n";
+
+    // Буферы сетки, и маленькие, и выровненные на огромную страницу,
+    // видны счётчику: иначе проверка выше прошла бы и с выделением на шаге
+    before = memoiza::allocationCount();
+    {
+        BitGrid small(8, 100);
+        BitGrid large(512, 65536);
+        allocOk = allocOk && small.rows() == 8 && large.rows() == 512;
+    }
+    std::uint64_t gridAllocations = memoiza::allocationCount() - before;
+    allocOk = allocOk && gridAllocations == 2;
+    std::cout << "Выделений на две сетки: " << gridAllocations << (gridAllocations == 2 ? "" : " (ожидалось 2)")
+              << "\n";
+
+    // Перемотка: снимков меньше, чем поколений, а после цикла любое
+    // поколение, хоть 10^18-е, совпадает с прямым прогоном до его места в цикле
+    torus = true;
+    BitGrid ship(16, 24);
+    for (const auto& cell : glider) ship.set(cell[0], cell[1], true);
+    auto history = memoiza::makeFastForward<BitGrid>([](BitGrid& g) { stepInPlace(g); }, 6);
+    std::vector<BitGrid> frames{ship};
+    for (int step = 1; step <= 200; step++) {
+        frames.push_back(frames.back());
+        stepInPlace(frames.back());
+    }
+    std::uint64_t period = 0;
+    for (std::uint64_t g = 0; g < frames.size(); g++) {
+        history.record(g, frames[g]);
+        if (g > 0 && frames[g] == frames[0]) {
+            period = g;
+            break;
+        }
+    }
+    history.record(0, frames[0], true);
+    history.setCycle(0, period);
+    // Глайдер сдвигается на клетку по диагонали за 4 поколения: период 4 * НОК(16, 24)
+    bool forwardOk = period == 192 && history.snapshots() <= 7;
+    BitGrid state;
+    for (std::uint64_t g : {std::uint64_t(0), std::uint64_t(37), std::uint64_t(191), std::uint64_t(192 * 5 + 13),
+                            std::uint64_t(1000000000000000007ULL)}) {
+        forwardOk = forwardOk && history.stateAt(g, state) && state == frames[g % 192];
+    }
+    // Закреплённый снимок впереди записи: прореживание не ломает порядок,
+    // и до любого поколения досчитывается меньше промежутка шагов
+    std::uint64_t stepsTaken = 0;
+    auto pinnedAhead = memoiza::makeFastForward<BitGrid>([&](BitGrid& g) { stepInPlace(g); stepsTaken++; }, 6);
+    pinnedAhead.record(150, frames[150], true);
+    for (std::uint64_t g = 0; g < 150; g++) pinnedAhead.record(g, frames[g]);
+    for (std::uint64_t g = 0; g <= 150; g++) {
+        stepsTaken = 0;
+        forwardOk = forwardOk && pinnedAhead.stateAt(g, state) && state == frames[g] &&
+                    stepsTaken < pinnedAhead.interval();
+    }
+    torus = false;
+    std::cout << "Перемотка по снимкам и циклу: " << (forwardOk ? "совпадает с эталоном" : "расхождение")
+              << " (снимков " << history.snapshots() << ", промежуток " << history.interval() << ")\n";
+
+    // Другие правила: шаблонные ядра (HighLife, Day & Night, Seeds)
+    // и табличное (остальные, в том числе с B0)
+    bool rulesOk = true;
+    for (const char* text : {"B36/S23", "B3678/S34678", "B2/S", "B35/S236", "B0/S8"}) {
+        memoiza::Rule rule;
+        memoiza::parseRule(text, rule);
+        memoiza::selectRule(rule);
+        Grid field(70, std::vector<int>(130, 0));
+        for (auto &row : field) {
+            for (auto &cell : row) cell = (gen() % 3 == 0) ? 1 : 0;
+        }
+        BitGrid whole = toBitGrid(field);
+        BitGrid spare(whole.rows(), whole.cols());
+        memoiza::ActiveGrid tiles(whole);
+        bool same = true;
+        for (int step = 0; step < 12 && same; step++) {
+            field = nextGeneration(field);
+            memoiza::stepBitGridParallel(whole, spare, pool);
+            std::swap(whole, spare);
+            tiles.step(pool);
+            same = (whole == toBitGrid(field)) && (tiles.current() == whole);
+        }
+        std::cout << "Правило " << rule.toString() << ": "
+                  << (same ? "совпадает с эталоном" : "расхождение") << "\n";
+        rulesOk = rulesOk && same;
+    }
+    memoiza::selectRule(memoiza::CONWAY_RULE);
+
+    // Движки библиотеки (memoiza/engine.hpp) на одном поле дают одни и те
+    // же клетки и хеши
+    bool enginesOk = true;
+    for (memoiza::Rule rule : {memoiza::CONWAY_RULE, memoiza::HIGHLIFE_RULE}) {
+        BitGrid soup(90, 150);
+        memoiza::fillSoup(soup, 77, 0.35, gen);
+        std::vector<std::pair<std::int64_t, std::int64_t>> reference, cells;
+        memoiza::Hash128 referenceHash;
+        for (const std::string& name : memoiza::engineNames()) {
+            // hashlife работает на плоскости: клетки у края там не гибнут,
+            // поэтому сравнивается с остальными только на своём поле
+            memoiza::EngineConfig config;
+            config.topology = name == "hashlife" ? memoiza::Topology::Plane : memoiza::Topology::Bounded;
+            config.rows = soup.rows();
+            config.cols = soup.cols();
+            config.rule = rule;
+            config.pool = &pool;
+            std::string error;
+            std::unique_ptr<memoiza::Board> engine = memoiza::makeEngine(name, config, error);
+            if (!engine) {
+                std::cout << "Движок " << name << ": " << error << "\n";
+                enginesOk = false;
+                continue;
+            }
+            for (int r = 0; r < soup.rows(); r++) {
+                for (int c = 0; c < soup.cols(); c++) {
+                    if (soup.get(r, c)) engine->set(r, c, true);
+                }
+            }
+            engine->advance(name == "hashlife" ? 4 : 40);
+            cells.clear();
+            engine->forEachLive([&](std::int64_t r, std::int64_t c) { cells.emplace_back(r, c); });
+            std::sort(cells.begin(), cells.end());
+            bool same = engine->population() == cells.size() && engine->generation() > 0;
+            if (name != "hashlife") {
+                if (reference.empty()) {
+                    reference = cells;
+                    referenceHash = engine->hash();
+                }
+                same = same && cells == reference && engine->hash() == referenceHash;
+            }
+            std::cout << "Движок библиотеки " << name << ", правило " << rule.toString() << ": "
+                      << (same ? "совпадает" : "расхождение") << "\n";
+            enginesOk = enginesOk && same;
+        }
+    }
+
+    // Адаптивный движок: планер и мигалка посреди поля — плотное поле,
+    // спокойный хвост в квадродереве, у края планер снова в плотном поле;
+    // клетки совпадают с плотным движком на каждом отрезке
+    for (memoiza::Topology topology : {memoiza::Topology::Bounded, memoiza::Topology::Torus}) {
+        memoiza::EngineConfig config;
+        config.topology = topology;
+        config.rows = 1200;
+        config.cols = 1200;
+        config.pool = &pool;
+        std::string error;
+        std::unique_ptr<memoiza::Board> adaptive = memoiza::makeEngine("adaptive", config, error);
+        std::unique_ptr<memoiza::Board> dense = memoiza::makeEngine("dense", config, error);
+        if (!adaptive || !dense) break;  // движок не собран
+        for (memoiza::Board* board : {adaptive.get(), dense.get()}) {
+            const int glider[5][2] = {{0, 1}, {1, 2}, {2, 0}, {2, 1}, {2, 2}};
+            for (const auto& cell : glider) board->set(600 + cell[0], 600 + cell[1], true);
+            for (int c = 0; c < 3; c++) board->set(500, 500 + c, true);
+        }
+        bool same = true;
+        for (int part = 0; part < 6; part++) {
+            adaptive->advance(500);
+            dense->advance(500);
+            same = same && adaptive->hash() == dense->hash() && adaptive->population() == dense->population();
+        }
+        std::uint64_t switches = 0;
+        memoiza::adaptiveBackend(*adaptive, &switches);
+        same = same && switches >= 3;
+        std::cout << "Адаптивный движок (" << (topology == memoiza::Topology::Torus ? "torus" : "bounded")
+                  << "): " << (same ? "совпадает" : "расхождение") << ", переносов: " << switches << "\n";
+        enginesOk = enginesOk && same;
+    }
+
+    // Плотные движки с разными правилами шагают одновременно и не
+    // смотрят на общее правило процесса
+    {
+        const memoiza::Rule rules[2] = {memoiza::CONWAY_RULE, memoiza::HIGHLIFE_RULE};
+        std::unique_ptr<memoiza::Board> serial[2], parallel[2];
+        BitGrid soup(120, 200);
+        memoiza::fillSoup(soup, 91, 0.35, gen);
+        for (int i = 0; i < 2; i++) {
+            memoiza::EngineConfig config;
+            config.topology = memoiza::Topology::Torus;
+            config.rows = soup.rows();
+            config.cols = soup.cols();
+            config.rule = rules[i];
+            std::string error;
+            serial[i] = memoiza::makeEngine("dense", config, error);
+            parallel[i] = memoiza::makeEngine("dense", config, error);
+            if (!serial[i] || !parallel[i]) break;  // движок не собран
+            for (int r = 0; r < soup.rows(); r++) {
+                for (int c = 0; c < soup.cols(); c++) {
+                    if (soup.get(r, c)) {
+                        serial[i]->set(r, c, true);
+                        parallel[i]->set(r, c, true);
+                    }
+                }
+            }
+            serial[i]->advance(60);
+        }
+        if (serial[1] && parallel[1]) {
+            memoiza::selectRule(memoiza::SEEDS_RULE);
+            std::thread other([&] { parallel[1]->advance(60); });
+            parallel[0]->advance(60);
+            other.join();
+            bool same = serial[0]->hash() != serial[1]->hash();
+            for (int i = 0; i < 2; i++) {
+                same = same && parallel[i]->hash() == serial[i]->hash() &&
+                       parallel[i]->population() == serial[i]->population();
+            }
+            std::cout << "Плотные движки B3/S23 и B36/S23 в двух потоках: "
+                      << (same ? "совпадают" : "расхождение") << "\n";
+            enginesOk = enginesOk && same;
+        }
+    }
+    // Смена правила у поля с устойчивыми тайлами: они пересчитываются
+    {
+        memoiza::DenseBoard<memoiza::BoundedEdges> settled(64, 256, pool), fresh(64, 256, pool);
+        for (memoiza::Board* board : {static_cast<memoiza::Board*>(&settled), static_cast<memoiza::Board*>(&fresh)}) {
+            for (int r = 20; r < 22; r++) {
+                for (int c = 150; c < 152; c++) board->set(r, c, true);
+            }
+        }
+        settled.setRule(memoiza::CONWAY_RULE);
+        settled.advance(5);
+        settled.setRule(memoiza::SEEDS_RULE);
+        fresh.setRule(memoiza::SEEDS_RULE);
+        settled.advance(7);
+        fresh.advance(7);
+        bool same = settled.hash() == fresh.hash() && settled.population() == fresh.population() &&
+                    fresh.population() > 0;
+        std::cout << "Смена правила у плотного поля: " << (same ? "совпадает" : "расхождение") << "\n";
+        enginesOk = enginesOk && same;
+    }
+    memoiza::selectRule(memoiza::CONWAY_RULE);
+    return ok && activeOk && boardOk && allocOk && forwardOk && rulesOk && enginesOk;
+}
+
 // Функция для вывода сетки в консоль с цветами
-void printGrid(const Grid &grid, int iteration) {
-    // ANSI код для очистки экрана и перемещения курсора в верхний левый угол
-    std::cout << "\033[2J\033[H";
-    std::cout << "Итерация: " << iteration << "\n";
-    for (int r = 0; r < ROWS; r++) {
-        for (int c = 0; c < COLS; c++) {
-            if (grid[r][c]) {
-                // Зелёный цвет для живых клеток
-                std::cout << "\033[32m██\033[0m";
+// Экран: поле уменьшается до размера терминала, выводятся только изменения
+memoiza::TerminalRenderer& screen() {
+    static int rows = 24, cols = 80;
+    static bool sized = memoiza::terminalSize(rows, cols);
+    (void)sized;
+    // Строка итерации, разделитель и строка под кадром; клетка — два символа
+    static memoiza::TerminalRenderer renderer(std::cout, rows - 3, cols / 2);
+    return renderer;
+}
+
+void printGrid(const BitGrid &grid, long long iteration) {
+    // В отладочном режиме между кадрами печатается текст: рисуем кадр целиком
+    screen().draw(grid, iteration, debugMode);
+}
+
+// Пакетный поиск: находки печатаются сразу, по мере появления, каждая
+// с зерном, по которому поле восстанавливается флагом --soup
+int runSearch() {
+    searchOptions.rows = boardRows;
+    searchOptions.cols = boardCols;
+    searchOptions.maxIter = static_cast<std::uint64_t>(maxIter);
+    searchOptions.targetLength = static_cast<std::uint64_t>(requiredCycleLen);
+    std::cout << "Поиск: " << searchOptions.count << " полей " << boardRows << "x" << boardCols
+              << ", базовое зерно " << searchOptions.baseSeed << ", нужен цикл длины "
+              << requiredCycleLen << ", потоков " << stepPool().size() << "\n";
+
+    auto onHit = [](const memoiza::SeedResult& hit) {
+        std::cout << "Найдено: --soup " << hit.seed << " (начало цикла " << hit.start
+                  << ", длина " << hit.length << ", живых клеток " << hit.population << ")"
+                  << std::endl;
+    };
+    auto t0 = std::chrono::steady_clock::now();
+    memoiza::SeedSearchStats stats = torus
+        ? memoiza::searchSeeds<memoiza::TorusEdges>(searchOptions, stepPool(), onHit)
+        : memoiza::searchSeeds<memoiza::BoundedEdges>(searchOptions, stepPool(), onHit);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "Проверено полей: " << stats.tried << ", находок: " << stats.hits
+              << ", других циклов: " << stats.cycles << ", вымерло: " << stats.diedOut
+              << ", переполнено: " << stats.overflowed << ", без цикла: " << stats.noCycle << "\n";
+    std::cout << "Время: " << seconds << " с (" << (seconds > 0 ? stats.tried / seconds : 0)
+              << " полей/с)\n";
+    return 0;
+}
+
+// Начальное поле из файла: плотная секция или список клеток;
+// generation — номер поколения, записанный в файле
+bool loadBoard(const std::string& path, BitGrid& board, std::uint64_t& generation) {
+    memoiza::BoardFileReader file;
+    std::string error;
+    if (!file.open(path, error)) {
+        std::cerr << "Ошибка: " << path << ": " << error << "\n";
+        return false;
+    }
+    const memoiza::CellKey* first;
+    const memoiza::CellKey* last;
+    if (file.loadDense(board)) {
+        // плотная секция уже в board
+    } else if (file.cells(first, last) && file.header().rows > 0 && file.header().cols > 0 &&
+               file.header().rows <= (1 << 30) && file.header().cols <= (1 << 30)) {
+        board = BitGrid(static_cast<int>(file.header().rows), static_cast<int>(file.header().cols));
+        for (const memoiza::CellKey* p = first; p != last; ++p) {
+            if (memoiza::cellRow(*p) < static_cast<std::uint64_t>(board.rows()) &&
+                memoiza::cellCol(*p) < static_cast<std::uint64_t>(board.cols())) {
+                board.set(static_cast<int>(memoiza::cellRow(*p)), static_cast<int>(memoiza::cellCol(*p)), true);
+            }
+        }
+    } else {
+        std::cerr << "Ошибка: в файле " << path << " нет ограниченного поля\n";
+        return false;
+    }
+    if (board.rows() < 3 || board.cols() < 3) {
+        std::cerr << "Ошибка: поле из файла меньше 3x3\n";
+        return false;
+    }
+    torus = (file.header().topology == 1);
+    generation = file.header().generation;
+    memoiza::selectRule(file.rule());
+    return true;
+}
+
+// Итоговое поле в файл: строки пишутся потоком, без промежуточной копии
+bool saveBoard(const std::string& path, const BitGrid& board, std::uint64_t generation) {
+    memoiza::BoardFileWriter file;
+    return file.open(path, memoiza::makeBoardFileHeader(board.rows(), board.cols(), generation,
+                                                        memoiza::activeRule(), torus ? 1 : 0)) &&
+           file.writeDense(board) && file.finish();
+}
+
+// Начальное поле из узора: первый проход измеряет узор, второй пишет
+// отрезки прямо в биты поля (координаты узора — координаты поля)
+bool loadPattern(const std::string& path, BitGrid& board) {
+    memoiza::BoundsSink bounds;
+    memoiza::PatternInfo info;
+    std::string error;
+    if (!memoiza::readPattern(path, bounds, info, error)) {
+        std::cerr << "Ошибка: " << path << ": " << error << "\n";
+        return false;
+    }
+    if (!sizeGiven) {
+        // Размер из заголовка узора, но не меньше занятого клетками
+        std::int64_t rows = std::max<std::int64_t>(info.height, bounds.maxRow + 1);
+        std::int64_t cols = std::max<std::int64_t>(info.width, bounds.maxCol + 1);
+        if (rows > (1 << 20) || cols > (1 << 20)) {
+            std::cerr << "Ошибка: узор " << path << " слишком велик для плотного поля\n";
+            return false;
+        }
+        boardRows = std::max<int>(3, static_cast<int>(rows));
+        boardCols = std::max<int>(3, static_cast<int>(cols));
+    }
+    board = BitGrid(boardRows, boardCols);
+    memoiza::DenseSink sink(board);
+    if (!memoiza::readPattern(path, sink, info, error)) {
+        std::cerr << "Ошибка: " << path << ": " << error << "\n";
+        return false;
+    }
+    if (sink.clipped() > 0) {
+        std::cerr << "Предупреждение: " << sink.clipped() << " клеток узора не поместились в поле\n";
+    }
+    if (info.hasRule && !ruleGiven) memoiza::selectRule(info.rule);
+    return true;
+}
+
+// Итоговое поле в формате узора (по расширению файла)
+bool exportPattern(const std::string& path, const BitGrid& board) {
+    memoiza::PatternFormat format = memoiza::detectPatternFormat(path);
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    if (format == memoiza::PatternFormat::Rle) {
+        memoiza::RleWriter writer(out, board.cols(), board.rows(), memoiza::activeRule());
+        memoiza::forEachRunDense(board, [&](std::int64_t r, std::int64_t c, std::int64_t n) { writer.run(r, c, n); });
+        writer.finish();
+    } else if (format == memoiza::PatternFormat::Cells) {
+        memoiza::CellsWriter writer(out, path);
+        memoiza::forEachRunDense(board, [&](std::int64_t r, std::int64_t c, std::int64_t n) { writer.run(r, c, n); });
+        writer.finish();
+    } else if (format == memoiza::PatternFormat::Macrocell) {
+        memoiza::HashLife life;
+        if (!life.setRule(memoiza::activeRule())) return false;
+        memoiza::forEachRunDense(board, [&](std::int64_t r, std::int64_t c, std::int64_t n) {
+            for (std::int64_t i = 0; i < n; i++) life.setCell(c + i, r, true);
+        });
+        memoiza::writeMacrocell(out, life);
+    } else {
+        return false;
+    }
+    return static_cast<bool>(out);
+}
+
+// Обрабатывает аргументы командной строки
+void parseArguments(int argc, char* argv[], bool& selfTest) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--selftest") == 0) {
+            selfTest = true;
+        } else if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            if (!memoiza::selectStepKernel(name)) {
+                std::cerr << "Ядро " << name << " не поддерживается этим процессором\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--debug") == 0) {
+            debugMode = true;
+        } else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            renderFps = std::atoi(argv[++i]);
+            if (renderFps < 0 || renderFps > 1000) {
+                std::cerr << "Неверная частота кадров: " << argv[i] << " (0..1000)\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            const char* size = argv[++i];
+            sizeGiven = true;
+            if (std::sscanf(size, "%dx%d", &boardRows, &boardCols) != 2 ||
+                boardRows < 3 || boardCols < 3) {
+                std::cerr << "Неверный размер поля: " << size << " (нужно RxC, не меньше 3x3)\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--topology") == 0 && i + 1 < argc) {
+            const char* topology = argv[++i];
+            if (std::strcmp(topology, "torus") == 0) {
+                torus = true;
+            } else if (std::strcmp(topology, "bounded") == 0) {
+                torus = false;
+            } else {
+                std::cerr << "Неизвестная топология: " << topology << " (bounded или torus)\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--rule") == 0 && i + 1 < argc) {
+            const char* text = argv[++i];
+            memoiza::Rule rule;
+            if (!memoiza::parseRule(text, rule)) {
+                std::cerr << "Неверное правило: " << text << " (например, B3/S23 или B36/S23)\n";
+                exit(1);
+            }
+            memoiza::selectRule(rule);
+            ruleGiven = true;
+        } else if (std::strcmp(argv[i], "--max-iter") == 0 && i + 1 < argc) {
+            maxIter = std::atoll(argv[++i]);
+        } else if (std::strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metricsFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--metrics-every") == 0 && i + 1 < argc) {
+            metricsEvery = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--at") == 0 && i + 1 < argc) {
+            atGeneration = std::strtoull(argv[++i], nullptr, 10);
+            atGiven = true;
+        } else if (std::strcmp(argv[i], "--period") == 0 && i + 1 < argc) {
+            requiredCycleLen = std::atoll(argv[++i]);
+            if (requiredCycleLen < 1) {
+                std::cerr << "Неверная длина цикла: " << argv[i] << "\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--search") == 0 && i + 1 < argc) {
+            searchMode = true;
+            searchOptions.count = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            searchOptions.baseSeed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--density") == 0 && i + 1 < argc) {
+            searchOptions.density = std::atof(argv[++i]);
+            if (!(searchOptions.density > 0 && searchOptions.density < 1)) {
+                std::cerr << "Неверная плотность: " << argv[i] << " (нужно число от 0 до 1)\n";
+                exit(1);
+            }
+        } else if (std::strcmp(argv[i], "--max-pop") == 0 && i + 1 < argc) {
+            searchOptions.maxPopulation = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--hits") == 0 && i + 1 < argc) {
+            searchOptions.maxHits = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            loadFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            saveFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--pattern") == 0 && i + 1 < argc) {
+            patternFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            exportFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--soup") == 0 && i + 1 < argc) {
+            useSoup = true;
+            soupSeedValue = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--cycle") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            if (std::strcmp(mode, "brent") == 0) {
+                useBrent = true;
+            } else if (std::strcmp(mode, "map") == 0) {
+                useBrent = false;
             } else {
-                // Серый цвет для мёртвых клеток
-                std::cout << "\033[90m  \033[0m";
+                std::cerr << "Неизвестный режим поиска цикла: " << mode << "\n";
+                exit(1);
             }
+        } else {
+            std::cerr << "Неизвестный аргумент: " << argv[i] << "\n";
+            std::cout << "Использование: " << argv[0]
+                      << " [--selftest] [--kernel scalar|avx2|avx512] [--threads <n>] [--fps <n>]"
+                      << " [--size RxC] [--topology bounded|torus] [--rule B3/S23]"
+                      << " [--cycle map|brent] [--max-iter <n>] [--period <n>] [--at <n>] [--debug]"
+                      << " [--search <n> [--seed <n>] [--density <p>] [--max-pop <n>] [--hits <n>]]"
+                      << " [--soup <зерно>] [--load <файл>] [--save <файл>]"
+                      << " [--pattern <файл.rle|.cells|.mc>] [--export <файл.rle|.cells|.mc>]"
+                      << " [--metrics <файл|-> [--metrics-every <n>]]\n";
+            exit(1);
         }
-        std::cout << "\n";
     }
-    // Разделительная линия
-    std::cout << std::string(COLS * 2, '-') << "\n";
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    bool selfTest = false;
+    parseArguments(argc, argv, selfTest);
+    if (selfTest) {
+        return runSelfTest() ? 0 : 1;
+    }
+    if (searchMode) {
+        return runSearch();
+    }
+    // Метрики пишутся в файл или в stderr ("-"), чтобы не смешиваться с кадрами
+    std::ofstream metricsOut;
+    if (metricsFile == "-") {
+        metrics.open(std::cerr, metricsEvery);
+    } else if (!metricsFile.empty()) {
+        metricsOut.open(metricsFile);
+        if (!metricsOut) {
+            std::cerr << "Ошибка: не удалось открыть " << metricsFile << "\n";
+            return 1;
+        }
+        metrics.open(metricsOut, metricsEvery);
+    }
+    BitGrid loaded;
+    // Поколение начального поля: итерации прогона отсчитываются от него,
+    // чтобы --load с --save продолжали счёт, а не начинали с нуля
+    std::uint64_t startGeneration = 0;
+    if (!loadFile.empty()) {
+        if (!loadBoard(loadFile, loaded, startGeneration)) return 1;
+        boardRows = loaded.rows();
+        boardCols = loaded.cols();
+    } else if (!patternFile.empty()) {
+        if (!loadPattern(patternFile, loaded)) return 1;
+    }
+
     // ---------------------------
     // 1) ИНИЦИАЛИЗАЦИЯ АВТОМАТА
     // ---------------------------
-    Grid grid(ROWS, std::vector<int>(COLS, 0));
+    Grid grid(boardRows, std::vector<int>(boardCols, 0));
     // Пример начальной конфигурации (глайдер, если хватает места)
     grid[1][0] = 1;
     grid[2][1] = 1;
     grid[0][2] = 1;
     grid[1][2] = 1;
     grid[2][2] = 1;
+    if (useSoup) {
+        BitGrid soup(boardRows, boardCols);
+        std::mt19937 soupGen;
+        memoiza::fillSoup(soup, soupSeedValue, searchOptions.density, soupGen);
+        grid = toGrid(soup);
+    }
+    if (!loadFile.empty() || !patternFile.empty()) {
+        grid = toGrid(loaded);
+    }
 
     if (debugMode) {
+        std::cout << "Ядро шага: " << memoiza::activeStepKernel().name << "\n";
+        std::cout << "Правило: " << memoiza::activeRule().toString() << "\n";
         std::cout << "Начальное состояние:\n";
         // Печать без очистки экрана
-        for (int r = 0; r < ROWS; r++) {
-            for (int c = 0; c < COLS; c++) {
+        for (int r = 0; r < boardRows; r++) {
+            for (int c = 0; c < boardCols; c++) {
                 std::cout << (grid[r][c] ? "██" : "  ");
             }
             std::cout << "\n";
         }
-        std::cout << std::string(COLS * 2, '-') << "\n";
+        std::cout << std::string(boardCols * 2, '-') << "\n";
     }
 
     // ---------------------------------------------------------
     // 2) СНАЧАЛА ПРОВЕРЯЕМ, ЕСТЬ ЛИ ЦИКЛ И ПОДХОДИТ ЛИ ОН НАМ
     // ---------------------------------------------------------
-    // Словарь «хеш -> номер итерации», чтобы отследить повтор
-    std::unordered_map<std::size_t, int> visited;
-    // Запомним начальное состояние
-    std::size_t h0 = hashGrid(grid);
-    visited[h0] = 0;
-
-    // Зададим ограничение — до скольки итераций мы ищем цикл
-    const int MAX_ITER = 2000;
-bool cycleFound = false;
-    int cycleStart  = -1;
-    int cycleLen    = -1;
-
-    Grid current = grid;
+    bool cycleFound = false;
+    long long cycleStart = -1;
+    long long cycleLen   = -1;
 
-    // Цикл итераций
-    for (int iter = 1; iter <= MAX_ITER; iter++) {
-        // Печать текущего состояния
-        printGrid(current, iter - 1);
+    BitGrid current = toBitGrid(grid);
+    // Номер итерации, которой соответствует current
+    long long currentIter = 0;
 
-        // Считаем следующее поколение
-        Grid newGrid = nextGeneration(current, debugMode);
-        current = newGrid;
+    // Снимки прогона и найденный цикл: состояние любой итерации без
+    // повторной симуляции от начала (memoiza/fast_forward.hpp)
+    std::size_t gridBytes = static_cast<std::size_t>(current.rows() + 2) * current.stride() * sizeof(std::uint64_t);
+    auto history = memoiza::makeFastForward<BitGrid>([](BitGrid& g) { stepInPlace(g); },
+                                                     std::clamp<std::size_t>(SNAPSHOT_BYTES / gridBytes, 4, MAX_SNAPSHOTS));
+    history.record(0, current);
 
-        // Хешируем
-        std::size_t h = hashGrid(current);
-
-        if (debugMode) {
-            std::cout << "  [Debug] Хеш текущего состояния: " << h << "\n";
-        }
-
-        // Проверяем на повтор
-        if (visited.find(h) != visited.end()) {
-            // Цикл!
+    if (useBrent) {
+        // Алгоритм Брента: в памяти только три состояния, поэтому можно
+        // искать на 10^8+ итерациях. Поиск идёт без анимации.
+        BitGrid entry;
+        std::uint64_t steps = 0;
+        memoiza::CycleInfo info = memoiza::findCycleBrent(
+            current,
+            [&](BitGrid& g) {
+                auto stepTimer = metrics.time(memoiza::Phase::Step);
+                if (debugMode) {
+                    g = nextGeneration(g, true);
+                } else {
+                    stepInPlace(g);
+                }
+                stepTimer.stop();
+                if (metrics.due(++steps)) {
+                    metrics.set(memoiza::Counter::LiveCells, g.population());
+                    metrics.dump(steps);
+                }
+            },
+            [](const BitGrid& a, const BitGrid& b) { return a == b; },
+            static_cast<std::uint64_t>(maxIter), &entry);
+        metrics.finish(steps);
+        if (info.found) {
             cycleFound = true;
-            cycleStart = visited[h];
-            cycleLen   = iter - cycleStart;
+            cycleStart = static_cast<long long>(info.start);
+            cycleLen   = static_cast<long long>(info.length);
+            current    = entry;
+            currentIter = cycleStart;
+            history.record(info.start, entry, true);
+            history.setCycle(info.start, info.length);
             std::cout << "Найден цикл!\n"
                       << "Начало цикла на итерации " << cycleStart
                       << ", длина цикла: " << cycleLen << "\n";
-            break;
-        } else {
-            visited[h] = iter;
         }
-
-        // Опционально: подсчёт и вывод количества живых клеток
         if (debugMode) {
-            int liveCells = 0;
-            for (const auto &row : current) {
-                for (auto cell : row) liveCells += cell;
-            }
-            std::cout << "  [Debug] Количество живых клеток: " << liveCells << "\n";
+            std::cout << "  [Debug] Шагов автомата при поиске: " << info.steps << "\n";
         }
+    }
 
-        // Задержка для удобства наблюдения
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    // Словарь «хеш -> номер итерации», чтобы отследить повтор
+    std::unordered_map<memoiza::Hash128, long long, memoiza::Hash128Hasher> visited;
+    // Хеш считается целиком один раз, дальше обновляется по изменениям
+    memoiza::Hash128 h = hashGrid(current);
+    if (!useBrent) {
+        // Запомним начальное состояние
+        visited[h] = 0;
+    }
+
+    // Шагаем только тайлы, где что-то изменилось, и их соседей. Граница
+    // поля — параметр шаблона, поэтому тело цикла одно для обеих топологий.
+    auto runIterations = [&](auto& active) {
+        // Цикл итераций
+        for (long long iter = 1; iter <= maxIter; iter++) {
+            // Текущее состояние: в отладочном режиме кадр рисуется сразу,
+            // иначе его заберёт поток вывода, когда подойдёт время кадра
+            if (debugMode) {
+                printGrid(active.current(), iter - 1);
+            } else {
+                screen().publish(active.current(), iter - 1);
+            }
+
+            // Считаем следующее поколение и обновляем хеш по родившимся и умершим
+            if (debugMode) {
+                BitGrid next = nextGeneration(active.current(), true);
+                memoiza::updateZobrist(active.current(), next, h);
+                active.assign(next);
+            } else {
+                auto stepTimer = metrics.time(memoiza::Phase::Step);
+                active.step(stepPool());
+                stepTimer.stop();
+                auto hashTimer = metrics.time(memoiza::Phase::Hash);
+                if (metrics.enabled()) {
+                    // Клетка, живая после шага, родилась, иначе умерла
+                    std::uint64_t births = 0, flips = 0;
+                    active.forEachFlip([&](int r, int c) {
+                        h ^= memoiza::cellKey(r, c);
+                        births += active.current().get(r, c) ? 1 : 0;
+                        flips++;
+                    });
+                    metrics.add(memoiza::Counter::Births, births);
+                    metrics.add(memoiza::Counter::Deaths, flips - births);
+                } else {
+                    active.forEachFlip([&](int r, int c) { h ^= memoiza::cellKey(r, c); });
+                }
+            }
+
+            MEMOIZA_TRACE(debugMode, std::cout << "  [Debug] Хеш текущего состояния: " << std::hex << h.hi << h.lo
+                                               << std::dec << "\n");
+
+            currentIter = iter;
+            history.record(static_cast<std::uint64_t>(iter), active.current());
+            if (metrics.due(static_cast<std::uint64_t>(iter))) {
+                metrics.set(memoiza::Counter::LiveCells, active.current().population());
+                metrics.dump(static_cast<std::uint64_t>(iter));
+            }
+
+            // Проверяем на повтор
+            auto cycleTimer = metrics.time(memoiza::Phase::CycleCheck);
+            auto seen = visited.find(h);
+            if (seen != visited.end()) {
+                // Совпадение хеша — только кандидат: сверяем с самим
+                // состоянием, досчитанным от ближайшего снимка
+                BitGrid earlier;
+                if (history.stateAt(static_cast<std::uint64_t>(seen->second), earlier) &&
+                    earlier == active.current()) {
+                    // Цикл! Останавливаем вывод, чтобы сообщение не смешалось с кадром
+                    screen().stop();
+                    cycleFound = true;
+                    cycleStart = seen->second;
+                    cycleLen   = iter - cycleStart;
+                    history.record(static_cast<std::uint64_t>(cycleStart), active.current(), true);
+                    history.setCycle(static_cast<std::uint64_t>(cycleStart), static_cast<std::uint64_t>(cycleLen));
+                    std::cout << "Найден цикл!\n"
+                              << "Начало цикла на итерации " << cycleStart
+                              << ", длина цикла: " << cycleLen << "\n";
+                    break;
+                }
+                MEMOIZA_TRACE(debugMode, std::cout << "  [Debug] Коллизия хеша с итерацией " << seen->second << "\n");
+            } else {
+                visited[h] = iter;
+            }
+            cycleTimer.stop();
+
+            // Опционально: подсчёт и вывод количества живых клеток
+            MEMOIZA_TRACE(debugMode, std::cout << "  [Debug] Количество живых клеток: "
+                                               << active.current().population() << "\n");
+
+            // В отладочном режиме — задержка, чтобы успеть прочитать вывод
+            if (debugMode) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+        }
+        screen().stop();
+        current = active.current();
+        metrics.set(memoiza::Counter::LiveCells, current.population());
+        metrics.finish(static_cast<std::uint64_t>(currentIter));
+    };
+    if (!useBrent) {
+        if (!debugMode) screen().start(renderFps);
+        if (torus) {
+            memoiza::BasicActiveGrid<memoiza::TorusEdges> active(current);
+            runIterations(active);
+        } else {
+            memoiza::ActiveGrid active(current);
+            runIterations(active);
+        }
     }
 
     // Печатаем последнее состояние, если цикл не найден
-    if (!cycleFound) {
-        printGrid(current, MAX_ITER);
+    if (!cycleFound && !useBrent) {
+        printGrid(current, maxIter);
+    }
+
+    // Поле для записи: итоговое или состояние итерации --at, свёрнутой в цикл
+    BitGrid output = current;
+    std::uint64_t outputIter = startGeneration + static_cast<std::uint64_t>(currentIter);
+    if (atGiven) {
+        std::uint64_t stored = 0;
+        if (!history.resolve(atGeneration, stored) || !history.stateAt(atGeneration, output)) {
+            std::cerr << "Ошибка: итерация " << atGeneration << " недоступна (цикл не найден, посчитано "
+                      << currentIter << " итераций)\n";
+            return 1;
+        }
+        outputIter = startGeneration + atGeneration;
+        std::cout << "Состояние на итерации " << atGeneration;
+        if (stored != atGeneration) {
+            std::cout << " (соответствует итерации " << stored << " внутри цикла)";
+        }
+        std::cout << ", живых клеток: " << output.population() << "\n";
+        printGrid(output, static_cast<long long>(stored));
+    }
+
+    if (!saveFile.empty()) {
+        if (!saveBoard(saveFile, output, outputIter)) {
+            std::cerr << "Ошибка: не удалось записать " << saveFile << "\n";
+            return 1;
+        }
+        std::cout << "Поле (итерация " << outputIter << ") записано в " << saveFile << "\n";
+    }
+    if (!exportFile.empty()) {
+        if (!exportPattern(exportFile, output)) {
+            std::cerr << "Ошибка: не удалось записать узор " << exportFile << "\n";
+            return 1;
+        }
+        std::cout << "Поле (итерация " << outputIter << ") записано в " << exportFile << "\n";
     }
 
     // -----------------------------------------------------
     // 3) РЕШАЕМ, «СТОИТ ЛИ СТРОИТЬ» (ДАЛЬШЕ ВЕСТИ АВТОМАТ)
     // -----------------------------------------------------
-    // Предположим, нам нужны циклы длиной ровно 10 (как пример).
-    const int REQUIRED_CYCLE_LEN = 10;
+    // Нужная длина цикла задаётся --period (по умолчанию 10)
 
     if (cycleFound) {
-        if (cycleLen == REQUIRED_CYCLE_LEN) {
+        if (cycleLen == requiredCycleLen) {
             std::cout << "Цикл подходит! Делаем дальнейшие построения.\n";
             // Здесь можно продолжить работу с автоматом, зная, что есть цикл нужной длины.
             // Например, анимировать цикл несколько раз:
-            for (int i = 0; i < cycleLen; i++) {
+            for (long long i = 0; i < cycleLen; i++) {
                 printGrid(current, cycleStart + i);
                 current = nextGeneration(current, debugMode);
-                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                if (renderFps > 0) std::this_thread::sleep_for(std::chrono::milliseconds(1000 / renderFps));
             }
         } else {
-            std::cout << "Цикл не подходит (нужен " << REQUIRED_CYCLE_LEN
+            std::cout << "Цикл не подходит (нужен " << requiredCycleLen
                       << ", найден " << cycleLen << "). Останавливаемся.\n";
             // Можно выйти из программы или сделать что-то ещё.
             return 0;
         }
     } else {
-        std::cout << "Цикл не найден (за " << MAX_ITER << " итераций). "
+        std::cout << "Цикл не найден (за " << maxIter << " итераций). "
                   << "Останавливаемся.\n";
         // Или продолжать дальше «как есть».
         return 0;
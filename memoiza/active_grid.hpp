@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "bit_grid.hpp"
+#include "edges.hpp"
+#include "parallel_step.hpp"
+
+// --------------------------------------------------------------
+// ШАГ ТОЛЬКО ПО АКТИВНЫМ ТАЙЛАМ
+// --------------------------------------------------------------
+//
+// Поле делится на тайлы TILE_ROWS x TILE_WORDS слов. Для каждого тайла
+// помним, изменился ли он на прошлом шаге. Тайл, который не изменился
+// и у которого не изменился ни один из восьми соседей, на следующем
+// шаге тоже не изменится — его можно не пересчитывать.
+//
+// Буферы два, они меняются ролями. Инвариант: у тайла вне списка
+// изменившихся содержимое в обоих буферах одинаково, поэтому
+// пропущенный тайл в приёмнике уже верен и копировать ничего не нужно.
+// Стоимость шага пропорциональна активности, а не площади поля.
+// Граница поля — политика Edges (edges.hpp); на торе соседи крайних
+// тайлов берутся с противоположного края.
+
+namespace memoiza {
+
+template <class Edges>
+class BasicActiveGrid {
+public:
+    static const int TILE_ROWS = 32;
+    static const int TILE_WORDS = 2;
+
+    // Если активна хотя бы такая доля тайлов, шагаем всё поле векторным
+    // ядром: сплошной проход быстрее, чем потайловый
+    static constexpr double FULL_STEP_SHARE = 0.5;
+
+    BasicActiveGrid() = default;
+
+    explicit BasicActiveGrid(const BitGrid& initial) { assign(initial); }
+
+    // Загрузить состояние; все тайлы считаются изменившимися
+    void assign(const BitGrid& g) {
+        grids_[0] = g;
+        grids_[1] = g;
+        cur_ = 0;
+        tilesY_ = (g.rows() + TILE_ROWS - 1) / TILE_ROWS;
+        tilesX_ = (g.wordsPerRow() + TILE_WORDS - 1) / TILE_WORDS;
+        flags_.assign(tileCount(), 0);
+        changedList_.clear();
+        for (std::size_t t = 0; t < tileCount(); t++) markChanged(t);
+        lastActive_ = 0;
+    }
+
+    const BitGrid& current() const { return grids_[cur_]; }
+    // Состояние до последнего шага
+    const BitGrid& previous() const { return grids_[cur_ ^ 1]; }
+
+    std::size_t tileCount() const { return static_cast<std::size_t>(tilesY_) * tilesX_; }
+    // Сколько тайлов пересчитано на последнем шаге
+    std::size_t lastActiveTiles() const { return lastActive_; }
+    // Сколько тайлов изменилось на последнем шаге
+    std::size_t changedTiles() const { return changedList_.size(); }
+
+    // Шагать своим правилом, а не общим на процесс (selectRule): так поля
+    // с разными правилами шагают одновременно из разных потоков. Тайл,
+    // устойчивый при прежнем правиле, при новом может ожить, поэтому все
+    // тайлы считаются изменившимися, как в assign.
+    void setRule(const Rule& rule) {
+        rule_ = rule;
+        kernels_ = kernelsForRule(rule);
+        ownRule_ = true;
+        for (std::size_t t = 0; t < tileCount(); t++) markChanged(t);
+    }
+
+    // Изменить клетку; её тайл считается изменившимся
+    void set(int r, int c, bool alive) {
+        grids_[cur_].set(r, c, alive);
+        markChanged(tileOf(r / TILE_ROWS, (c >> 6) / TILE_WORDS));
+    }
+
+    void step(ThreadPool& pool) {
+        // Активные тайлы: изменившиеся и их соседи
+        active_.clear();
+        for (std::uint32_t t : changedList_) {
+            int ty = static_cast<int>(t / tilesX_);
+            int tx = static_cast<int>(t % tilesX_);
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    int y = ty + dy, x = tx + dx;
+                    if (Edges::wraps) {
+                        y = (y + tilesY_) % tilesY_;
+                        x = (x + tilesX_) % tilesX_;
+                    } else if (y < 0 || y >= tilesY_ || x < 0 || x >= tilesX_) {
+                        continue;
+                    }
+                    std::uint32_t n = tileOf(y, x);
+                    if (!(flags_[n] & ACTIVE)) {
+                        flags_[n] |= ACTIVE;
+                        active_.push_back(n);
+                    }
+                }
+            }
+        }
+        for (std::uint32_t t : changedList_) flags_[t] &= ~CHANGED;
+        changedList_.clear();
+        lastActive_ = active_.size();
+
+        BitGrid& src = grids_[cur_];
+        BitGrid& dst = grids_[cur_ ^ 1];
+        tileChanged_.assign(active_.size(), 0);
+        Edges::prepare(src);
+        const Rule rule = ownRule_ ? rule_ : activeRule();
+        const RuleKernels kernels = ownRule_ ? kernels_ : activeRuleKernels();
+
+        if (active_.size() >= FULL_STEP_SHARE * tileCount()) {
+            // Почти всё поле активно: векторный проход полосами по строке
+            // тайлов. Полоса сверяется сразу после шага, пока она в кэше,
+            // а не вторым проходом по обеим сеткам из памяти.
+            // Для B3/S23 — векторное ядро по CPU, для прочих правил — ядро
+            // правила на всю ширину строки
+            StepRowsFn cpuKernel = kernels.stepRows == nullptr ? activeStepKernel().stepRows : nullptr;
+            bandChanged_.resize(tileCount());
+            std::size_t grain = std::max<std::size_t>(1, tilesY_ / (pool.size() * 4));
+            pool.parallelFor(0, static_cast<std::size_t>(tilesY_), grain, [&](std::size_t lo, std::size_t hi) {
+                for (std::size_t ty = lo; ty < hi; ty++) {
+                    int r0 = static_cast<int>(ty) * TILE_ROWS;
+                    int r1 = std::min(src.rows(), r0 + TILE_ROWS);
+                    if (cpuKernel != nullptr) {
+                        cpuKernel(src, dst, r0, r1);
+                    } else {
+                        kernels.stepBlock(rule, src, dst, r0, r1, 0, src.wordsPerRow());
+                    }
+                    for (int tx = 0; tx < tilesX_; tx++) {
+                        std::uint32_t t = tileOf(static_cast<int>(ty), tx);
+                        bandChanged_[t] = tileDiffers(src, dst, t);
+                    }
+                }
+            });
+            for (std::size_t i = 0; i < active_.size(); i++) tileChanged_[i] = bandChanged_[active_[i]];
+        } else {
+            std::size_t grain = std::max<std::size_t>(1, active_.size() / (pool.size() * 8));
+            pool.parallelFor(0, active_.size(), grain, [&](std::size_t lo, std::size_t hi) {
+                for (std::size_t i = lo; i < hi; i++) {
+                    tileChanged_[i] = stepTile(src, dst, active_[i], rule, kernels.stepBlock);
+                }
+            });
+        }
+
+        Edges::finish(src);
+        for (std::size_t i = 0; i < active_.size(); i++) {
+            flags_[active_[i]] &= ~ACTIVE;
+            if (tileChanged_[i]) markChanged(active_[i]);
+        }
+        cur_ ^= 1;
+    }
+
+    // fn(r, c) для каждой клетки, изменившейся на последнем шаге
+    // (обходятся только изменившиеся тайлы)
+    template <class Fn>
+    void forEachFlip(Fn&& fn) const {
+        const BitGrid& before = previous();
+        const BitGrid& after = current();
+        for (std::uint32_t t : changedList_) {
+            int r0, r1, w0, w1;
+            tileBounds(t, r0, r1, w0, w1);
+            for (int r = r0; r < r1; r++) {
+                const std::uint64_t* a = before.row(r);
+                const std::uint64_t* b = after.row(r);
+                for (int w = w0; w < w1; w++) {
+                    std::uint64_t diff = a[w] ^ b[w];
+                    while (diff != 0) {
+                        fn(r, w * 64 + __builtin_ctzll(diff));
+                        diff &= diff - 1;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    static const std::uint8_t CHANGED = 1;
+    static const std::uint8_t ACTIVE = 2;
+
+    std::uint32_t tileOf(int ty, int tx) const {
+        return static_cast<std::uint32_t>(ty * tilesX_ + tx);
+    }
+
+    void markChanged(std::size_t t) {
+        if (!(flags_[t] & CHANGED)) {
+            flags_[t] |= CHANGED;
+            changedList_.push_back(static_cast<std::uint32_t>(t));
+        }
+    }
+
+    void tileBounds(std::uint32_t t, int& r0, int& r1, int& w0, int& w1) const {
+        const BitGrid& g = grids_[cur_];
+        int ty = static_cast<int>(t / tilesX_);
+        int tx = static_cast<int>(t % tilesX_);
+        r0 = ty * TILE_ROWS;
+        r1 = std::min(g.rows(), r0 + TILE_ROWS);
+        w0 = tx * TILE_WORDS;
+        w1 = std::min(g.wordsPerRow(), w0 + TILE_WORDS);
+    }
+
+    // Пересчитать тайл ядром правила; true, если он изменился
+    bool stepTile(const BitGrid& src, BitGrid& dst, std::uint32_t t, const Rule& rule,
+                  StepBlockFn stepBlock) const {
+        int r0, r1, w0, w1;
+        tileBounds(t, r0, r1, w0, w1);
+        return stepBlock(rule, src, dst, r0, r1, w0, w1);
+    }
+
+    bool tileDiffers(const BitGrid& src, const BitGrid& dst, std::uint32_t t) const {
+        int r0, r1, w0, w1;
+        tileBounds(t, r0, r1, w0, w1);
+        const int lastWord = src.wordsPerRow() - 1;
+        const std::uint64_t lastMask = src.lastWordMask();
+        std::uint64_t diff = 0;
+        for (int r = r0; r < r1; r++) {
+            const std::uint64_t* a = src.row(r);
+            const std::uint64_t* b = dst.row(r);
+            for (int w = w0; w < w1; w++) {
+                std::uint64_t mask = (w == lastWord) ? lastMask : ~0ULL;
+                diff |= (a[w] ^ b[w]) & mask;
+            }
+        }
+        return diff != 0;
+    }
+
+    BitGrid grids_[2];
+    int cur_ = 0;
+    int tilesY_ = 0;
+    int tilesX_ = 0;
+    std::vector<std::uint8_t> flags_;
+    std::vector<std::uint32_t> changedList_;
+    std::vector<std::uint32_t> active_;
+    std::vector<std::uint8_t> tileChanged_;
+    std::vector<std::uint8_t> bandChanged_;  // по номеру тайла, для сплошного прохода
+    std::size_t lastActive_ = 0;
+    bool ownRule_ = false;  // false — общее правило процесса
+    Rule rule_ = CONWAY_RULE;
+    RuleKernels kernels_ = kernelsForRule(CONWAY_RULE);
+};
+
+// Ограниченное поле: за краем клеток нет
+using ActiveGrid = BasicActiveGrid<BoundedEdges>;
+
+} // namespace memoiza
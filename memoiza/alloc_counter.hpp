@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// --------------------------------------------------------------
+// СЧЁТЧИК ВЫДЕЛЕНИЙ ПАМЯТИ
+// --------------------------------------------------------------
+//
+// Глобальный operator new заменяется версией, которая считает вызовы.
+// Так можно проверить, что шаг автомата в установившемся режиме не
+// выделяет память. Замена должна быть ровно в одной единице трансляции:
+// в файле с main() перед включением определите MEMOIZA_COUNT_ALLOCATIONS.
+
+namespace memoiza {
+
+inline std::atomic<std::uint64_t> allocationCounter{0};
+
+// Сколько раз выделялась память с начала программы (во всех потоках)
+inline std::uint64_t allocationCount() {
+    return allocationCounter.load(std::memory_order_relaxed);
+}
+
+} // namespace memoiza
+
+#ifdef MEMOIZA_COUNT_ALLOCATIONS
+
+// GCC видит free() после встроенного operator new и ложно считает пару несогласованной
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t n) {
+    memoiza::allocationCounter.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n != 0 ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// Выровненные выделения (буферы BitGrid) считаются так же
+void* operator new(std::size_t n, std::align_val_t align) {
+    memoiza::allocationCounter.fetch_add(1, std::memory_order_relaxed);
+    std::size_t a = static_cast<std::size_t>(align);
+    std::size_t bytes = (n != 0 ? n + a - 1 : a) / a * a;
+    if (void* p = std::aligned_alloc(a, bytes)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](std::size_t n, std::align_val_t align) { return operator new(n, align); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
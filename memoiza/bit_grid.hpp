@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// --------------------------------------------------------------
+// БИТОВАЯ ПЛОТНАЯ СЕТКА
+// --------------------------------------------------------------
+//
+// 64 клетки в одном слове uint64_t, все строки лежат в одном
+// непрерывном буфере. Бит j слова w строки r — это клетка (r, w*64 + j).
+// Вокруг поля хранится нулевой ореол: одна строка сверху и снизу и одно
+// слово слева и справа. Благодаря ему ядро шага не проверяет границы.
+//
+// Строка шириной от кэш-линии (512 клеток) начинается с границы линии,
+// шаг между строками кратен линии, а слово ореола слева — последнее
+// слово места предыдущей строки. Так векторные загрузки строки
+// выровнены, а полосы строк, которые потоки пишут целиком (полный шаг
+// в active_grid.hpp), не делят линий друг с другом. Тайлы так не
+// разделены: тайл шириной TILE_WORDS = 2 слова — четверть линии, и
+// соседние по горизонтали тайлы, шагаемые разными потоками, пишут в
+// одни и те же линии. Большой буфер выравнивается на 2 МиБ, чтобы
+// ядро могло отдать его огромными страницами (transparent huge pages);
+// с MEMOIZA_HUGE_PAGES=1 буфер ещё и просится в них через madvise. Это
+// выключено по умолчанию: в виртуальной машине, где мерили, огромные
+// страницы замедляли шаг по тайлам.
+
+namespace memoiza {
+
+// Слов в кэш-линии и размер огромной страницы
+static const int CACHE_LINE_WORDS = 8;
+static const std::size_t HUGE_PAGE_BYTES = std::size_t(2) << 20;
+
+// Насколько слов вперёд ядра шага подгружают строку r+2: она понадобится
+// следующей строке, а на поле больше кэша иначе ждали бы её из памяти.
+// 64 слова — это 8 кэш-линий (512 байт) впереди текущего слова; каждая
+// линия подгружается один раз, на первом её слове
+static const int PREFETCH_WORDS = 64;
+
+// Просить огромные страницы для больших сеток (MEMOIZA_HUGE_PAGES=1)
+inline bool hugePagesRequested() {
+    static const bool requested = [] {
+        const char* value = std::getenv("MEMOIZA_HUGE_PAGES");
+        return value != nullptr && value[0] == '1';
+    }();
+    return requested;
+}
+
+// Аллокатор буфера сетки: кэш-линия, а от HUGE_PAGE_BYTES — огромная страница
+template <class T>
+struct GridAllocator {
+    using value_type = T;
+
+    GridAllocator() = default;
+    template <class U>
+    GridAllocator(const GridAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        std::size_t align = alignment(n);
+        std::size_t bytes = (n * sizeof(T) + align - 1) / align * align;
+        // Через operator new, а не aligned_alloc: выделение видит счётчик
+        // alloc_counter.hpp, на котором держится проверка «шаг без выделений»
+        void* p = ::operator new(bytes, std::align_val_t(align));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        if (align == HUGE_PAGE_BYTES && hugePagesRequested()) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, std::size_t n) { ::operator delete(p, std::align_val_t(alignment(n))); }
+
+    static std::size_t alignment(std::size_t n) {
+        return n * sizeof(T) >= HUGE_PAGE_BYTES ? HUGE_PAGE_BYTES : CACHE_LINE_WORDS * sizeof(std::uint64_t);
+    }
+
+    template <class U>
+    bool operator==(const GridAllocator<U>&) const { return true; }
+    template <class U>
+    bool operator!=(const GridAllocator<U>&) const { return false; }
+};
+
+class BitGrid {
+public:
+    BitGrid() = default;
+
+    BitGrid(int rows, int cols)
+        : rows_(rows),
+          cols_(cols),
+          wordsPerRow_((cols + 63) / 64),
+          stride_(alignedStride(wordsPerRow_)),
+          words_(CACHE_LINE_WORDS + static_cast<std::size_t>(rows + 2) * stride_, 0) {}
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int wordsPerRow() const { return wordsPerRow_; }
+    int stride() const { return stride_; }
+
+    // Указатель на первое слово строки r (r может быть -1 или rows — ореол).
+    // Перед строкой -1 — линия, последнее слово которой её ореол слева.
+    std::uint64_t* row(int r) {
+        return words_.data() + CACHE_LINE_WORDS + static_cast<std::size_t>(r + 1) * stride_;
+    }
+    const std::uint64_t* row(int r) const {
+        return words_.data() + CACHE_LINE_WORDS + static_cast<std::size_t>(r + 1) * stride_;
+    }
+
+    // Маска значимых битов последнего слова строки
+    std::uint64_t lastWordMask() const {
+        int tail = cols_ % 64;
+        return tail == 0 ? ~0ULL : ((1ULL << tail) - 1);
+    }
+
+    bool get(int r, int c) const {
+        return (row(r)[c >> 6] >> (c & 63)) & 1ULL;
+    }
+
+    void set(int r, int c, bool alive) {
+        std::uint64_t bit = 1ULL << (c & 63);
+        std::uint64_t& w = row(r)[c >> 6];
+        w = alive ? (w | bit) : (w & ~bit);
+    }
+
+    void clear() {
+        std::fill(words_.begin(), words_.end(), 0);
+    }
+
+    // Количество живых клеток
+    std::size_t population() const {
+        std::size_t count = 0;
+        for (int r = 0; r < rows_; r++) {
+            const std::uint64_t* p = row(r);
+            for (int w = 0; w < wordsPerRow_; w++) {
+                count += static_cast<std::size_t>(__builtin_popcountll(p[w]));
+            }
+        }
+        return count;
+    }
+
+    // Хеш по словам (ореол не учитывается)
+    std::size_t hash() const {
+        std::size_t h = static_cast<std::size_t>(rows_) * 0x9e3779b97f4a7c15ULL + cols_;
+        for (int r = 0; r < rows_; r++) {
+            const std::uint64_t* p = row(r);
+            for (int w = 0; w < wordsPerRow_; w++) {
+                h ^= p[w] + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+            }
+        }
+        return h;
+    }
+
+    bool operator==(const BitGrid& other) const {
+        return rows_ == other.rows_ && cols_ == other.cols_ && words_ == other.words_;
+    }
+    bool operator!=(const BitGrid& other) const { return !(*this == other); }
+
+private:
+    // Узкой строке (меньше линии) выравнивание обошлось бы в разы памяти
+    static int alignedStride(int words) {
+        if (words < CACHE_LINE_WORDS) return words + 2;
+        return (words + 2 + CACHE_LINE_WORDS - 1) / CACHE_LINE_WORDS * CACHE_LINE_WORDS;
+    }
+
+    int rows_ = 0;
+    int cols_ = 0;
+    int wordsPerRow_ = 0;
+    int stride_ = 0;
+    std::vector<std::uint64_t, GridAllocator<std::uint64_t>> words_;
+};
+
+// --------------------------------------------------------------
+// ПОБИТОВЫЙ ПОДСЧЕТ СОСЕДЕЙ (SWAR)
+// --------------------------------------------------------------
+
+// Полный сумматор для 64 независимых разрядов
+inline void fullAdd(std::uint64_t a, std::uint64_t b, std::uint64_t c,
+                    std::uint64_t& sum, std::uint64_t& carry) {
+    std::uint64_t u = a ^ b;
+    sum = u ^ c;
+    carry = (a & b) | (u & c);
+}
+
+// Следующее состояние 64 клеток по правилу B3/S23.
+// up/mid/down — слова трёх строк, *L/*R — соседние слова слева и справа.
+inline std::uint64_t lifeWord(std::uint64_t upL, std::uint64_t up, std::uint64_t upR,
+                              std::uint64_t midL, std::uint64_t mid, std::uint64_t midR,
+                              std::uint64_t downL, std::uint64_t down, std::uint64_t downR) {
+    // Соседи слева (столбец c-1) и справа (столбец c+1) для каждого бита
+    std::uint64_t aW = (up << 1) | (upL >> 63);
+    std::uint64_t aE = (up >> 1) | (upR << 63);
+    std::uint64_t mW = (mid << 1) | (midL >> 63);
+    std::uint64_t mE = (mid >> 1) | (midR << 63);
+    std::uint64_t bW = (down << 1) | (downL >> 63);
+    std::uint64_t bE = (down >> 1) | (downR << 63);
+
+    // Суммы по строкам: верх и низ — по три бита, середина — два
+    std::uint64_t a0, a1, b0, b1;
+    fullAdd(aW, up, aE, a0, a1);
+    fullAdd(bW, down, bE, b0, b1);
+    std::uint64_t m0 = mW ^ mE;
+    std::uint64_t m1 = mW & mE;
+
+    // Младший разряд суммы и перенос в разряд двоек
+    std::uint64_t s0, c1;
+    fullAdd(a0, b0, m0, s0, c1);
+
+    // k = a1 + b1 + m1 + c1; сумма равна 2 или 3 ровно при k == 1
+    std::uint64_t t0, t1;
+    fullAdd(a1, b1, m1, t0, t1);
+    std::uint64_t twoOrThree = (t0 ^ c1) & ~(t1 | (t0 & c1));
+
+    // Рождение при 3, выживание при 2 или 3
+    return twoOrThree & (s0 | mid);
+}
+
+// Один шаг для строк [rowBegin, rowEnd): без ветвлений внутри строки
+inline void stepBitGridRows(const BitGrid& src, BitGrid& dst, int rowBegin, int rowEnd) {
+    const int words = src.wordsPerRow();
+    const std::uint64_t lastMask = src.lastWordMask();
+    if (words == 0) return;
+    for (int r = rowBegin; r < rowEnd; r++) {
+        const std::uint64_t* up = src.row(r - 1);
+        const std::uint64_t* mid = src.row(r);
+        const std::uint64_t* down = src.row(r + 1);
+        const std::uint64_t* ahead = src.row(std::min(r + 2, src.rows()));
+        std::uint64_t* out = dst.row(r);
+        for (int w = 0; w < words; w++) {
+            if ((w & (CACHE_LINE_WORDS - 1)) == 0) __builtin_prefetch(ahead + w + PREFETCH_WORDS);
+            out[w] = lifeWord(up[w - 1], up[w], up[w + 1],
+                              mid[w - 1], mid[w], mid[w + 1],
+                              down[w - 1], down[w], down[w + 1]);
+        }
+        // Биты за правым краем поля всегда мертвы
+        out[words - 1] &= lastMask;
+    }
+}
+
+} // namespace memoiza
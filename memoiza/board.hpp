@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "active_grid.hpp"
+#include "bit_grid.hpp"
+#include "edges.hpp"
+#include "hashlife.hpp"
+#include "parallel_step.hpp"
+#include "zobrist.hpp"
+
+// --------------------------------------------------------------
+// ПОЛЕ: РАЗМЕРЫ ВО ВРЕМЯ ВЫПОЛНЕНИЯ, ТОР И НЕОГРАНИЧЕННАЯ ПЛОСКОСТЬ
+// --------------------------------------------------------------
+//
+// Один интерфейс шага для полей любого вида. Размеры плотного поля
+// задаются во время выполнения, а граница — параметром шаблона
+// (см. edges.hpp), так что ядро шага не проверяет края. Неограниченная
+// плоскость с 64-битными координатами построена на HashLife.
+
+namespace memoiza {
+
+// Общий интерфейс поля: одинаковый для всех границ и представлений
+class Board {
+public:
+    virtual ~Board() = default;
+
+    // Размеры поля; 0 — направление не ограничено
+    virtual std::int64_t rows() const = 0;
+    virtual std::int64_t cols() const = 0;
+
+    virtual std::uint64_t generation() const = 0;
+    virtual std::uint64_t population() const = 0;
+
+    // Клетка (row, col); на торе координаты берутся по модулю,
+    // за краем ограниченного поля клетки всегда мертвы
+    virtual bool get(std::int64_t row, std::int64_t col) const = 0;
+    virtual void set(std::int64_t row, std::int64_t col, bool alive) = 0;
+
+    virtual void step() = 0;
+    virtual void advance(std::uint64_t generations) {
+        for (std::uint64_t i = 0; i < generations; i++) step();
+    }
+
+    // fn(row, col) для каждой живой клетки
+    virtual void forEachLive(const std::function<void(std::int64_t, std::int64_t)>& fn) const = 0;
+
+    // Хеш Зобриста живых клеток (zobrist.hpp): одинаковый у всех видов
+    // поля с одними клетками. Здесь считается заново; поле, которое ведёт
+    // хеш по изменениям, отвечает сразу.
+    virtual Hash128 hash() const {
+        Hash128 h;
+        forEachLive([&](std::int64_t row, std::int64_t col) {
+            h ^= cellKey(static_cast<std::uint64_t>(row), static_cast<std::uint64_t>(col));
+        });
+        return h;
+    }
+
+    // Рамка живых клеток (строки top..bottom, столбцы left..right);
+    // false — живых клеток нет
+    virtual bool bounds(std::int64_t& top, std::int64_t& left, std::int64_t& bottom, std::int64_t& right) const {
+        bool any = false;
+        forEachLive([&](std::int64_t row, std::int64_t col) {
+            if (!any) {
+                top = bottom = row;
+                left = right = col;
+                any = true;
+            }
+            top = std::min(top, row);
+            bottom = std::max(bottom, row);
+            left = std::min(left, col);
+            right = std::max(right, col);
+        });
+        return any;
+    }
+};
+
+// Плотное битовое поле с границей Edges; шагаются только активные тайлы
+template <class Edges>
+class DenseBoard : public Board {
+public:
+    DenseBoard(int rows, int cols, ThreadPool& pool)
+        : grid_(BitGrid(rows, cols)), pool_(pool) {}
+
+    std::int64_t rows() const override { return grid_.current().rows(); }
+    std::int64_t cols() const override { return grid_.current().cols(); }
+    std::uint64_t generation() const override { return generation_; }
+    std::uint64_t population() const override { return grid_.current().population(); }
+
+    bool get(std::int64_t row, std::int64_t col) const override {
+        const BitGrid& g = grid_.current();
+        int r, c;
+        return Edges::locate(row, col, g.rows(), g.cols(), r, c) && g.get(r, c);
+    }
+    void set(std::int64_t row, std::int64_t col, bool alive) override {
+        const BitGrid& g = grid_.current();
+        int r, c;
+        if (Edges::locate(row, col, g.rows(), g.cols(), r, c)) grid_.set(r, c, alive);
+    }
+
+    // Своё правило вместо общего на процесс (selectRule)
+    void setRule(const Rule& rule) { grid_.setRule(rule); }
+
+    void step() override {
+        grid_.step(pool_);
+        generation_++;
+    }
+
+    void forEachLive(const std::function<void(std::int64_t, std::int64_t)>& fn) const override {
+        const BitGrid& g = grid_.current();
+        for (int r = 0; r < g.rows(); r++) {
+            const std::uint64_t* p = g.row(r);
+            for (int w = 0; w < g.wordsPerRow(); w++) {
+                std::uint64_t bits = p[w];
+                while (bits != 0) {
+                    fn(r, w * 64 + __builtin_ctzll(bits));
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+
+    const BasicActiveGrid<Edges>& grid() const { return grid_; }
+
+private:
+    BasicActiveGrid<Edges> grid_;
+    ThreadPool& pool_;
+    std::uint64_t generation_ = 0;
+};
+
+// Сколько узлов HashLife держит поле-плоскость до сборки мусора
+static const std::size_t PLANE_MAX_NODES = 4000000;
+
+// Неограниченная плоскость: координаты 64-битные, шаги и прыжки — HashLife
+class PlaneBoard : public Board {
+public:
+    explicit PlaneBoard(std::size_t maxNodes = PLANE_MAX_NODES) : maxNodes_(maxNodes) {}
+
+    // Сменить правило (поле очищается); false — правило с B0
+    bool setRule(const Rule& rule) { return life_.setRule(rule); }
+
+    std::int64_t rows() const override { return 0; }
+    std::int64_t cols() const override { return 0; }
+    std::uint64_t generation() const override { return life_.generation(); }
+    std::uint64_t population() const override { return life_.population(); }
+
+    bool get(std::int64_t row, std::int64_t col) const override { return life_.getCell(col, row); }
+    void set(std::int64_t row, std::int64_t col, bool alive) override { life_.setCell(col, row, alive); }
+
+    void step() override {
+        life_.step();
+        collectIfLarge();
+    }
+    // Прыжок степенями двойки, как HashLife::advance, со сборкой мусора
+    // между ними: иначе таблицы узлов и шагов растут без предела
+    void advance(std::uint64_t generations) override {
+        for (int j = 63; j >= 0; j--) {
+            if ((generations >> j) & 1ULL) {
+                life_.advancePow2(j);
+                collectIfLarge();
+            }
+        }
+    }
+
+    void forEachLive(const std::function<void(std::int64_t, std::int64_t)>& fn) const override {
+        life_.forEachLive([&](std::int64_t x, std::int64_t y) { fn(y, x); });
+    }
+
+    bool bounds(std::int64_t& top, std::int64_t& left, std::int64_t& bottom, std::int64_t& right) const override {
+        return life_.bounds(left, top, right, bottom);
+    }
+
+    // Узлов квадродерева в памяти
+    std::size_t nodeCount() const { return life_.nodeCount(); }
+
+private:
+    // Оставить только узлы текущего поля
+    void collectIfLarge() {
+        if (life_.nodeCount() <= maxNodes_) return;
+        std::vector<const HashLifeNode*> keep;
+        life_.collectGarbage(keep);
+    }
+
+    HashLife life_;
+    std::size_t maxNodes_;
+};
+
+enum class Topology { Bounded, Torus, Plane };
+
+// "bounded", "torus" или "plane"; false — неизвестное имя
+inline bool parseTopology(const std::string& name, Topology& topology) {
+    if (name == "bounded") {
+        topology = Topology::Bounded;
+    } else if (name == "torus") {
+        topology = Topology::Torus;
+    } else if (name == "plane") {
+        topology = Topology::Plane;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Поле заданной топологии; для плоскости размеры не используются
+inline std::unique_ptr<Board> makeBoard(Topology topology, int rows, int cols, ThreadPool& pool) {
+    switch (topology) {
+    case Topology::Torus:
+        return std::unique_ptr<Board>(new DenseBoard<TorusEdges>(rows, cols, pool));
+    case Topology::Plane:
+        return std::unique_ptr<Board>(new PlaneBoard());
+    case Topology::Bounded:
+    default:
+        return std::unique_ptr<Board>(new DenseBoard<BoundedEdges>(rows, cols, pool));
+    }
+}
+
+} // namespace memoiza
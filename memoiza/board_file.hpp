@@ -0,0 +1,352 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bit_grid.hpp"
+#include "checkpoint_store.hpp"
+#include "flat_cell_set.hpp"
+#include "rule.hpp"
+
+// --------------------------------------------------------------
+// ДВОИЧНЫЙ ФАЙЛ ПОЛЯ И ИСТОРИИ СОСТОЯНИЙ
+// --------------------------------------------------------------
+//
+// Файл: заголовок (64 байта), секции, индекс секций и хвост, который
+// указывает на индекс. Индекс пишется последним, поэтому файл пишется
+// потоком, без возвратов назад. Каждая секция выровнена на 64 байта, и
+// данные в ней лежат ровно так, как в памяти, поэтому файл читается
+// через mmap без копирования: слова плотной секции — строки BitGrid
+// без ореола, ключи секции клеток — отсортированный массив CellKey,
+// который сразу подходит для stepSortedRows.
+//
+// Числа записываются в порядке байт машины; заголовок хранит метку
+// порядка байт, и файл с другим порядком не открывается.
+
+namespace memoiza {
+
+static const std::uint32_t BOARD_FILE_VERSION = 1;
+static const std::uint32_t BOARD_FILE_BYTE_ORDER = 0x01020304;
+
+// Типы секций
+static const std::uint32_t SECTION_DENSE = 1;        // битовое поле по строкам
+static const std::uint32_t SECTION_CELLS = 2;        // отсортированные ключи клеток
+static const std::uint32_t SECTION_CHECKPOINTS = 3;  // кадры CheckpointStore
+
+struct BoardFileHeader {
+    char magic[8];            // "MEMOIZA\0"
+    std::uint32_t version;
+    std::uint32_t byteOrder;  // BOARD_FILE_BYTE_ORDER в порядке байт записавшей машины
+    std::int64_t rows;        // 0 — направление не ограничено
+    std::int64_t cols;
+    std::uint64_t generation;
+    std::uint16_t birth;      // правило (rule.hpp)
+    std::uint16_t survive;
+    std::uint32_t topology;   // 0 — ограниченное поле, 1 — тор, 2 — плоскость
+    std::uint8_t reserved[16];
+};
+static_assert(sizeof(BoardFileHeader) == 64, "заголовок файла — 64 байта");
+
+struct BoardFileSection {
+    std::uint32_t type;
+    std::uint32_t reserved;
+    std::uint64_t offset;  // от начала файла
+    std::uint64_t size;
+};
+
+struct BoardFileTrailer {
+    std::uint64_t indexOffset;
+    std::uint32_t sectionCount;
+    std::uint32_t reserved;
+    char magic[8];  // "MZINDEX\0"
+};
+
+// Заголовки секций (данные идут сразу за ними, с выравниванием 64)
+struct DenseSectionHeader {
+    std::uint64_t rows, cols, wordsPerRow;
+    std::uint64_t reserved[5];
+};
+struct CellsSectionHeader {
+    std::uint64_t count;
+    std::uint64_t reserved[7];
+};
+struct CheckpointSectionHeader {
+    std::uint64_t interval, count, cycleStart, cycleLength, dataSize;
+    std::uint64_t reserved[3];
+};
+
+inline BoardFileHeader makeBoardFileHeader(std::int64_t rows, std::int64_t cols,
+                                           std::uint64_t generation, const Rule& rule,
+                                           std::uint32_t topology) {
+    BoardFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "MEMOIZA", 8);
+    h.version = BOARD_FILE_VERSION;
+    h.byteOrder = BOARD_FILE_BYTE_ORDER;
+    h.rows = rows;
+    h.cols = cols;
+    h.generation = generation;
+    h.birth = rule.birth;
+    h.survive = rule.survive;
+    h.topology = topology;
+    return h;
+}
+
+// --------------------------------------------------------------
+// ЗАПИСЬ
+// --------------------------------------------------------------
+
+// Пишет файл последовательно: open, любые секции, finish. Данные
+// секций не собираются в памяти целиком, а сразу уходят в файл.
+class BoardFileWriter {
+public:
+    BoardFileWriter() = default;
+    BoardFileWriter(const BoardFileWriter&) = delete;
+    BoardFileWriter& operator=(const BoardFileWriter&) = delete;
+    ~BoardFileWriter() {
+        if (file_ != nullptr) std::fclose(file_);
+    }
+
+    bool open(const std::string& path, const BoardFileHeader& header) {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (file_ == nullptr) return false;
+        pos_ = 0;
+        index_.clear();
+        return put(&header, sizeof(header));
+    }
+
+    bool writeDense(const BitGrid& g) {
+        DenseSectionHeader h = {};
+        h.rows = static_cast<std::uint64_t>(g.rows());
+        h.cols = static_cast<std::uint64_t>(g.cols());
+        h.wordsPerRow = static_cast<std::uint64_t>(g.wordsPerRow());
+        bool ok = beginSection(SECTION_DENSE) && put(&h, sizeof(h));
+        for (int r = 0; ok && r < g.rows(); r++) {
+            ok = put(g.row(r), sizeof(std::uint64_t) * g.wordsPerRow());
+        }
+        return ok && endSection();
+    }
+
+    // Ключи должны идти по возрастанию
+    bool writeCells(const CellKey* begin, const CellKey* end) {
+        CellsSectionHeader h = {};
+        h.count = static_cast<std::uint64_t>(end - begin);
+        return beginSection(SECTION_CELLS) && put(&h, sizeof(h)) &&
+               put(begin, sizeof(CellKey) * h.count) && endSection();
+    }
+
+    bool writeCheckpoints(const CheckpointStore& store) {
+        const auto& offsets = store.encodedOffsets();
+        const auto& data = store.encodedData();
+        CheckpointSectionHeader h = {};
+        h.interval = store.keyframeInterval();
+        h.count = offsets.size();
+        h.cycleStart = store.cycleStart();
+        h.cycleLength = store.cycleLength();
+        h.dataSize = data.size();
+        return beginSection(SECTION_CHECKPOINTS) && put(&h, sizeof(h)) &&
+               put(offsets.data(), sizeof(std::uint64_t) * offsets.size()) &&
+               put(data.data(), data.size()) && endSection();
+    }
+
+    // Записать индекс и хвост, закрыть файл
+    bool finish() {
+        if (file_ == nullptr) return false;
+        static const char zeros[8] = {};
+        if (!put(zeros, (8 - pos_ % 8) % 8)) return false;
+        BoardFileTrailer t = {};
+        t.indexOffset = pos_;
+        t.sectionCount = static_cast<std::uint32_t>(index_.size());
+        std::memcpy(t.magic, "MZINDEX", 8);
+        bool ok = put(index_.data(), sizeof(BoardFileSection) * index_.size()) && put(&t, sizeof(t));
+        ok = (std::fclose(file_) == 0) && ok;
+        file_ = nullptr;
+        return ok;
+    }
+
+private:
+    bool put(const void* p, std::size_t n) {
+        if (n == 0) return true;
+        if (std::fwrite(p, 1, n, file_) != n) return false;
+        pos_ += n;
+        return true;
+    }
+
+    bool beginSection(std::uint32_t type) {
+        if (file_ == nullptr) return false;
+        static const char zeros[64] = {};
+        if (!put(zeros, (64 - pos_ % 64) % 64)) return false;
+        index_.push_back({type, 0, pos_, 0});
+        return true;
+    }
+
+    bool endSection() {
+        index_.back().size = pos_ - index_.back().offset;
+        return true;
+    }
+
+    std::FILE* file_ = nullptr;
+    std::uint64_t pos_ = 0;
+    std::vector<BoardFileSection> index_;
+};
+
+// --------------------------------------------------------------
+// ЧТЕНИЕ ЧЕРЕЗ MMAP
+// --------------------------------------------------------------
+
+class BoardFileReader {
+public:
+    BoardFileReader() = default;
+    BoardFileReader(const BoardFileReader&) = delete;
+    BoardFileReader& operator=(const BoardFileReader&) = delete;
+    ~BoardFileReader() { close(); }
+
+    // Отобразить файл в память и проверить заголовок и индекс;
+    // при ошибке false и описание в error
+    bool open(const std::string& path, std::string& error) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "невозможно открыть файл";
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(BoardFileHeader) + sizeof(BoardFileTrailer))) {
+            ::close(fd);
+            error = "файл слишком короткий";
+            return false;
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            size_ = 0;
+            error = "mmap не удался";
+            return false;
+        }
+        base_ = static_cast<const std::uint8_t*>(p);
+
+        const BoardFileHeader& h = header();
+        BoardFileTrailer t;
+        std::memcpy(&t, base_ + size_ - sizeof(t), sizeof(t));
+        if (std::memcmp(h.magic, "MEMOIZA", 8) != 0 || std::memcmp(t.magic, "MZINDEX", 8) != 0) {
+            error = "это не файл поля memoiza";
+        } else if (h.byteOrder != BOARD_FILE_BYTE_ORDER) {
+            error = "файл записан на машине с другим порядком байт";
+        } else if (h.version != BOARD_FILE_VERSION) {
+            error = "неподдерживаемая версия формата " + std::to_string(h.version);
+        } else if (t.indexOffset % 8 != 0 || t.indexOffset > size_ - sizeof(t) ||
+                   (size_ - sizeof(t) - t.indexOffset) / sizeof(BoardFileSection) < t.sectionCount) {
+            error = "повреждён индекс секций";
+        } else {
+            sections_ = reinterpret_cast<const BoardFileSection*>(base_ + t.indexOffset);
+            sectionCount_ = t.sectionCount;
+            for (std::uint32_t i = 0; i < sectionCount_; i++) {
+                if (sections_[i].offset > size_ || sections_[i].size > size_ - sections_[i].offset) {
+                    error = "секция выходит за конец файла";
+                }
+            }
+            if (error.empty()) return true;
+        }
+        close();
+        return false;
+    }
+
+    void close() {
+        if (base_ != nullptr) ::munmap(const_cast<std::uint8_t*>(base_), size_);
+        base_ = nullptr;
+        size_ = 0;
+        sections_ = nullptr;
+        sectionCount_ = 0;
+    }
+
+    const BoardFileHeader& header() const {
+        return *reinterpret_cast<const BoardFileHeader*>(base_);
+    }
+
+    Rule rule() const {
+        Rule r;
+        r.birth = header().birth;
+        r.survive = header().survive;
+        return r;
+    }
+
+    bool hasSection(std::uint32_t type) const { return find(type) != nullptr; }
+
+    // Ключи клеток прямо из отображённого файла (без копирования)
+    bool cells(const CellKey*& begin, const CellKey*& end) const {
+        const BoardFileSection* s = find(SECTION_CELLS);
+        if (s == nullptr || s->size < sizeof(CellsSectionHeader)) return false;
+        const auto* h = reinterpret_cast<const CellsSectionHeader*>(base_ + s->offset);
+        if ((s->size - sizeof(*h)) / sizeof(CellKey) < h->count) return false;
+        begin = reinterpret_cast<const CellKey*>(h + 1);
+        end = begin + h->count;
+        return true;
+    }
+
+    // Слова плотного поля прямо из файла: строка r — words + r * wordsPerRow
+    bool dense(DenseSectionHeader& info, const std::uint64_t*& words) const {
+        const BoardFileSection* s = find(SECTION_DENSE);
+        if (s == nullptr || s->size < sizeof(DenseSectionHeader)) return false;
+        std::memcpy(&info, base_ + s->offset, sizeof(info));
+        if (info.wordsPerRow != (info.cols + 63) / 64 || info.rows > (1u << 30) || info.cols > (1u << 30) ||
+            (s->size - sizeof(info)) / sizeof(std::uint64_t) / (info.wordsPerRow ? info.wordsPerRow : 1) < info.rows) {
+            return false;
+        }
+        words = reinterpret_cast<const std::uint64_t*>(base_ + s->offset + sizeof(info));
+        return true;
+    }
+
+    // Плотное поле в BitGrid: одно копирование строки на строку
+    bool loadDense(BitGrid& g) const {
+        DenseSectionHeader info;
+        const std::uint64_t* words;
+        if (!dense(info, words)) return false;
+        g = BitGrid(static_cast<int>(info.rows), static_cast<int>(info.cols));
+        for (int r = 0; r < g.rows(); r++) {
+            std::memcpy(g.row(r), words + static_cast<std::size_t>(r) * info.wordsPerRow,
+                        sizeof(std::uint64_t) * info.wordsPerRow);
+            if (info.wordsPerRow > 0) g.row(r)[info.wordsPerRow - 1] &= g.lastWordMask();
+        }
+        return true;
+    }
+
+    bool loadCheckpoints(CheckpointStore& store) const {
+        const BoardFileSection* s = find(SECTION_CHECKPOINTS);
+        if (s == nullptr || s->size < sizeof(CheckpointSectionHeader)) return false;
+        const auto* h = reinterpret_cast<const CheckpointSectionHeader*>(base_ + s->offset);
+        std::uint64_t room = s->size - sizeof(*h);
+        if (room / sizeof(std::uint64_t) < h->count || room - h->count * sizeof(std::uint64_t) < h->dataSize) {
+            return false;
+        }
+        const auto* offsets = reinterpret_cast<const std::uint64_t*>(h + 1);
+        const auto* data = reinterpret_cast<const std::uint8_t*>(offsets + h->count);
+        if (!store.assignEncoded(h->interval, h->count, offsets, data, h->dataSize)) return false;
+        store.setCycle(h->cycleStart, h->cycleLength);
+        return true;
+    }
+
+private:
+    const BoardFileSection* find(std::uint32_t type) const {
+        for (std::uint32_t i = 0; i < sectionCount_; i++) {
+            if (sections_[i].type == type) return &sections_[i];
+        }
+        return nullptr;
+    }
+
+    const std::uint8_t* base_ = nullptr;
+    std::size_t size_ = 0;
+    const BoardFileSection* sections_ = nullptr;
+    std::uint32_t sectionCount_ = 0;
+};
+
+} // namespace memoiza
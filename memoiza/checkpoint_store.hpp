@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "flat_cell_set.hpp"
+#include "sparse_rows.hpp"
+
+// --------------------------------------------------------------
+// ХРАНИЛИЩЕ СОСТОЯНИЙ: КЛЮЧЕВЫЕ КАДРЫ И ДЕЛЬТЫ
+// --------------------------------------------------------------
+//
+// Вместо полной копии поля через каждые несколько итераций храним
+// полный (ключевой) кадр раз в interval итераций, а для остальных —
+// только изменившиеся клетки (родившиеся и умершие). Кадр — это
+// отсортированные ключи клеток, записанные разностями соседних ключей
+// в varint, поэтому клетка занимает 1-3 байта вместо ячейки хеш-таблицы.
+// Состояние любой итерации восстанавливается от ближайшего ключевого
+// кадра не более чем interval-1 дельтами; итерации после начала цикла
+// сворачиваются в цикл.
+
+namespace memoiza {
+
+class CheckpointStore {
+public:
+    explicit CheckpointStore(std::uint64_t keyframeInterval = 64)
+        : interval_(keyframeInterval > 0 ? keyframeInterval : 1) {}
+
+    void clear() {
+        count_ = 0;
+        data_.clear();
+        offsets_.clear();
+        last_.clear();
+        cycleStart_ = cycleLength_ = 0;
+    }
+
+    // Сколько итераций записано (итерации 0 .. recorded()-1)
+    std::uint64_t recorded() const { return count_; }
+
+    std::uint64_t keyframeInterval() const { return interval_; }
+
+    // Записать состояние следующей итерации: ключи живых клеток в любом порядке
+    template <class It>
+    void append(It begin, It end) {
+        encodeNext(begin, end, frame_);
+        appendEncoded(frame_);
+    }
+
+    // Запись в два шага, для хранилища, которое читают из других потоков:
+    // encodeNext сортирует клетки и кодирует кадр следующей итерации в
+    // frame (меняет только рабочее состояние писателя, читателям его можно
+    // звать без блокировки), appendEncoded дописывает готовый кадр
+    template <class It>
+    void encodeNext(It begin, It end, std::vector<std::uint8_t>& frame) {
+        scratch_.assign(begin, end);
+        sortCellKeys(scratch_, tmp_);
+        frame.clear();
+        if (count_ % interval_ == 0) {
+            encode(scratch_, frame);
+        } else {
+            // Дельта — симметрическая разность: каждая клетка в ней меняет состояние
+            tmp_.clear();
+            std::set_symmetric_difference(last_.begin(), last_.end(), scratch_.begin(), scratch_.end(),
+                                          std::back_inserter(tmp_));
+            encode(tmp_, frame);
+        }
+        last_.swap(scratch_);
+    }
+
+    void appendEncoded(const std::vector<std::uint8_t>& frame) {
+        offsets_.push_back(data_.size());
+        data_.insert(data_.end(), frame.begin(), frame.end());
+        count_++;
+    }
+
+    // Отсортированные ключи последней закодированной итерации
+    const std::vector<CellKey>& lastState() const { return last_; }
+
+    // Начиная с итерации start, состояния повторяются с периодом length
+    void setCycle(std::uint64_t start, std::uint64_t length) {
+        cycleStart_ = start;
+        cycleLength_ = length;
+    }
+
+    // Записанная итерация, равная iter с учётом цикла; false — недоступна
+    bool resolve(std::uint64_t iter, std::uint64_t& stored) const {
+        if (cycleLength_ != 0 && iter >= cycleStart_) {
+            iter = cycleStart_ + (iter - cycleStart_) % cycleLength_;
+        }
+        if (iter >= count_) return false;
+        stored = iter;
+        return true;
+    }
+
+    // Отсортированные ключи живых клеток на итерации iter; false — недоступна
+    bool stateAt(std::uint64_t iter, std::vector<CellKey>& out) const {
+        std::uint64_t stored;
+        if (!resolve(iter, stored)) return false;
+        std::uint64_t key = stored / interval_ * interval_;
+        out.clear();
+        if (!decode(key, out)) return false;
+        std::vector<CellKey> delta, merged;
+        for (std::uint64_t i = key + 1; i <= stored; i++) {
+            delta.clear();
+            if (!decode(i, delta)) return false;
+            merged.clear();
+            std::set_symmetric_difference(out.begin(), out.end(), delta.begin(), delta.end(),
+                                          std::back_inserter(merged));
+            out.swap(merged);
+        }
+        return true;
+    }
+
+    // Кадры, из которых восстанавливается итерация iter (ключевой и дельты
+    // до неё), — в out; out.stateAt(out.recorded() - 1) даёт её состояние.
+    // Копия дешёвая (не больше keyframeInterval() кадров) и не зависит от
+    // дальнейшей записи сюда. false — итерация недоступна.
+    bool copyFramesFor(std::uint64_t iter, CheckpointStore& out) const {
+        std::uint64_t stored;
+        if (!resolve(iter, stored)) return false;
+        std::uint64_t key = stored / interval_ * interval_;
+        std::size_t begin = static_cast<std::size_t>(offsets_[key]);
+        std::size_t end = stored + 1 < count_ ? static_cast<std::size_t>(offsets_[stored + 1]) : data_.size();
+        out.clear();
+        out.interval_ = stored - key + 1;
+        out.data_.assign(data_.begin() + static_cast<std::ptrdiff_t>(begin),
+                         data_.begin() + static_cast<std::ptrdiff_t>(end));
+        for (std::uint64_t i = key; i <= stored; i++) out.offsets_.push_back(offsets_[i] - begin);
+        out.count_ = stored - key + 1;
+        return true;
+    }
+
+    // Память под кадры (без рабочих буферов)
+    std::size_t bytes() const {
+        return data_.capacity() + offsets_.capacity() * sizeof(std::uint64_t);
+    }
+
+    // Закодированные кадры и их смещения — для записи в файл (board_file.hpp)
+    const std::vector<std::uint8_t>& encodedData() const { return data_; }
+    const std::vector<std::uint64_t>& encodedOffsets() const { return offsets_; }
+    std::uint64_t cycleStart() const { return cycleStart_; }
+    std::uint64_t cycleLength() const { return cycleLength_; }
+
+    // Загрузить ранее записанные кадры: count смещений и size байт данных.
+    // false — данные повреждены (смещения вне данных или не по порядку,
+    // кадр не читается в своих границах).
+    bool assignEncoded(std::uint64_t interval, std::uint64_t count, const std::uint64_t* offsets,
+                       const std::uint8_t* data, std::size_t size) {
+        if (interval == 0) return false;
+        for (std::uint64_t i = 0; i < count; i++) {
+            if (offsets[i] >= size || (i > 0 && offsets[i] <= offsets[i - 1])) return false;
+        }
+        clear();
+        interval_ = interval;
+        offsets_.assign(offsets, offsets + count);
+        data_.assign(data, data + size);
+        count_ = count;
+        // Каждый кадр читается целиком, пока данные из файла не приняты
+        for (std::uint64_t i = 0; i < count_; i++) {
+            scratch_.clear();
+            if (!decode(i, scratch_)) {
+                clear();
+                return false;
+            }
+        }
+        scratch_.clear();
+        // Последнее состояние нужно, чтобы продолжить запись дельтами
+        if (count_ > 0 && !stateAt(count_ - 1, last_)) {
+            clear();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // Число клеток, затем разности соседних ключей (первая — от нуля)
+    static void encode(const std::vector<CellKey>& sorted, std::vector<std::uint8_t>& out) {
+        putVarint(sorted.size(), out);
+        CellKey prev = 0;
+        for (CellKey k : sorted) {
+            putVarint(k - prev, out);
+            prev = k;
+        }
+    }
+
+    // Кадр iter в out; false — кадр выходит за свои границы или ключи не
+    // возрастают (только у данных, загруженных из файла)
+    bool decode(std::uint64_t iter, std::vector<CellKey>& out) const {
+        const std::uint8_t* p = data_.data() + offsets_[iter];
+        const std::uint8_t* end = data_.data() + (iter + 1 < count_ ? offsets_[iter + 1] : data_.size());
+        std::uint64_t n;
+        if (!getVarint(p, end, n)) return false;
+        // Каждый ключ занимает хотя бы байт
+        if (n > static_cast<std::uint64_t>(end - p)) return false;
+        out.reserve(out.size() + n);
+        CellKey k = 0;
+        for (std::uint64_t i = 0; i < n; i++) {
+            std::uint64_t d;
+            if (!getVarint(p, end, d)) return false;
+            if ((i > 0 && d == 0) || k + d < k) return false;
+            k += d;
+            out.push_back(k);
+        }
+        return true;
+    }
+
+    static void putVarint(std::uint64_t v, std::vector<std::uint8_t>& out) {
+        while (v >= 0x80) {
+            out.push_back(static_cast<std::uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<std::uint8_t>(v));
+    }
+
+    // false — число обрывается на end или длиннее 64 бит
+    static bool getVarint(const std::uint8_t*& p, const std::uint8_t* end, std::uint64_t& v) {
+        v = 0;
+        for (int shift = 0; shift <= 63; shift += 7) {
+            if (p == end) return false;
+            std::uint8_t b = *p++;
+            v |= std::uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    std::uint64_t interval_;
+    std::uint64_t count_ = 0;
+    std::vector<std::uint8_t> data_;
+    std::vector<std::uint64_t> offsets_;  // начало кадра каждой итерации в data_
+    std::vector<CellKey> last_;           // состояние последней записанной итерации
+    std::vector<CellKey> scratch_, tmp_;
+    std::vector<std::uint8_t> frame_;     // кадр для append
+    std::uint64_t cycleStart_ = 0;
+    std::uint64_t cycleLength_ = 0;
+};
+
+} // namespace memoiza
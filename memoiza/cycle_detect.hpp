@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+
+// --------------------------------------------------------------
+// ПОИСК ЦИКЛА С ПОСТОЯННОЙ ПАМЯТЬЮ (АЛГОРИТМ БРЕНТА)
+// --------------------------------------------------------------
+//
+// Вместо словаря «хеш -> итерация» храним только три состояния:
+// начальное, «черепаху» и «зайца». Результат тот же, что у словаря:
+// start — первая итерация, с которой состояния повторяются,
+// length — длина цикла. Шаг должен быть чистой функцией состояния.
+
+namespace memoiza {
+
+struct CycleInfo {
+    bool found = false;
+    bool stopped = false;      // поиск прерван условием stop
+    std::uint64_t start = 0;   // начало цикла (mu)
+    std::uint64_t length = 0;  // длина цикла (lambda)
+    std::uint64_t steps = 0;   // сколько шагов автомата сделано всего
+};
+
+// То же, что findCycleBrent, но stop(state) проверяется после каждого
+// шага «зайца» в первой фазе; true прерывает поиск (stopped = true,
+// steps — номер итерации, на которой сработало условие). Так поиск
+// заканчивается сразу, если поле вымерло или разрослось сверх лимита.
+template <class State, class Step, class Same, class Stop>
+CycleInfo findCycleBrentUntil(const State& initial, Step step, Same same, Stop stop,
+                              std::uint64_t maxIter, State* cycleEntry = nullptr) {
+    CycleInfo info;
+
+    // Фаза 1: длина цикла. Черепаха прыгает к зайцу на степенях двойки.
+    State tortoise = initial;
+    State hare = initial;
+    step(hare);
+    info.steps = 1;
+    std::uint64_t power = 1;
+    std::uint64_t lambda = 1;
+    while (!same(tortoise, hare)) {
+        if (stop(hare)) {
+            info.stopped = true;
+            return info;
+        }
+        if (info.steps >= maxIter) return info;
+        if (power == lambda) {
+            tortoise = hare;
+            power *= 2;
+            lambda = 0;
+        }
+        step(hare);
+        info.steps++;
+        lambda++;
+    }
+
+    // Фаза 2: начало цикла. Заяц опережает черепаху ровно на lambda шагов.
+    tortoise = initial;
+    hare = initial;
+    for (std::uint64_t i = 0; i < lambda; i++) step(hare);
+    info.steps += lambda;
+    std::uint64_t mu = 0;
+    while (!same(tortoise, hare)) {
+        step(tortoise);
+        step(hare);
+        info.steps += 2;
+        mu++;
+    }
+
+    info.found = true;
+    info.start = mu;
+    info.length = lambda;
+    if (cycleEntry != nullptr) *cycleEntry = tortoise;
+    return info;
+}
+
+// step(State&) — шаг на месте, same(a, b) — точное сравнение состояний.
+// maxIter ограничивает число шагов «зайца» в первой фазе.
+// Если cycleEntry не nullptr, туда записывается состояние на итерации start.
+template <class State, class Step, class Same>
+CycleInfo findCycleBrent(const State& initial, Step step, Same same,
+                         std::uint64_t maxIter, State* cycleEntry = nullptr) {
+    return findCycleBrentUntil(initial, step, same, [](const State&) { return false; },
+                               maxIter, cycleEntry);
+}
+
+} // namespace memoiza
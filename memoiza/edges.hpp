@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "bit_grid.hpp"
+#include "parallel_step.hpp"
+
+// --------------------------------------------------------------
+// ГРАНИЦЫ ПОЛЯ КАК ПОЛИТИКИ ВРЕМЕНИ КОМПИЛЯЦИИ
+// --------------------------------------------------------------
+//
+// Ядро шага всегда читает ореол вокруг поля, политика лишь заполняет
+// его перед шагом: у ограниченного поля ореол нулевой, у тора в нём
+// лежат строки и столбцы с противоположного края. Поэтому во внутреннем
+// цикле нет ни одной проверки границ.
+
+namespace memoiza {
+
+// За краем поля клеток нет
+struct BoundedEdges {
+    static constexpr bool wraps = false;
+
+    static void prepare(BitGrid&) {}
+    static void finish(BitGrid&) {}
+
+    // Координаты клетки в поле; false — клетка за краем
+    static bool locate(std::int64_t row, std::int64_t col, int rows, int cols, int& r, int& c) {
+        if (row < 0 || row >= rows || col < 0 || col >= cols) return false;
+        r = static_cast<int>(row);
+        c = static_cast<int>(col);
+        return true;
+    }
+};
+
+// Поле свёрнуто в тор: за правым краем — левый, за нижним — верхний
+struct TorusEdges {
+    static constexpr bool wraps = true;
+
+    // Заполнить ореол копиями противоположных краёв. Если ширина не
+    // кратна 64, соседом справа для последнего столбца служит бит
+    // заполнения сразу за ним — в него кладётся столбец 0.
+    static void prepare(BitGrid& g) {
+        const int rows = g.rows();
+        const int cols = g.cols();
+        const int words = g.wordsPerRow();
+        if (rows == 0 || cols == 0) return;
+        const int tail = cols % 64;
+        for (int r = 0; r < rows; r++) {
+            std::uint64_t* p = g.row(r);
+            std::uint64_t first = p[0] & 1ULL;
+            std::uint64_t last = (p[(cols - 1) >> 6] >> ((cols - 1) & 63)) & 1ULL;
+            p[-1] = last << 63;
+            p[words] = first;
+            if (tail != 0) p[words - 1] |= first << tail;
+        }
+        std::copy(g.row(rows - 1) - 1, g.row(rows - 1) + words + 1, g.row(-1) - 1);
+        std::copy(g.row(0) - 1, g.row(0) + words + 1, g.row(rows) - 1);
+    }
+
+    // Вернуть ореол и биты заполнения к нулю
+    static void finish(BitGrid& g) {
+        const int rows = g.rows();
+        const int words = g.wordsPerRow();
+        if (rows == 0 || words == 0) return;
+        const std::uint64_t mask = g.lastWordMask();
+        for (int r = 0; r < rows; r++) {
+            std::uint64_t* p = g.row(r);
+            p[-1] = 0;
+            p[words] = 0;
+            p[words - 1] &= mask;
+        }
+        std::fill(g.row(-1) - 1, g.row(-1) + words + 1, 0);
+        std::fill(g.row(rows) - 1, g.row(rows) + words + 1, 0);
+    }
+
+    static bool locate(std::int64_t row, std::int64_t col, int rows, int cols, int& r, int& c) {
+        if (rows == 0 || cols == 0) return false;
+        r = static_cast<int>(((row % rows) + rows) % rows);
+        c = static_cast<int>(((col % cols) + cols) % cols);
+        return true;
+    }
+};
+
+// Один шаг src -> dst с заданной границей. Ореол src временно
+// заполняется и затем очищается, поэтому src не const.
+template <class Edges>
+void stepWithEdges(BitGrid& src, BitGrid& dst, ThreadPool& pool) {
+    Edges::prepare(src);
+    stepBitGridParallel(src, dst, pool);
+    Edges::finish(src);
+}
+
+} // namespace memoiza
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "board.hpp"
+#include "rule.hpp"
+#include "thread_pool.hpp"
+
+// --------------------------------------------------------------
+// ДВИЖКИ БИБЛИОТЕКИ
+// --------------------------------------------------------------
+//
+// Единственная часть memoiza, которая компилируется в библиотеку
+// (src/, цель memoiza в CMakeLists.txt); остальное — заголовки. Движок —
+// реализация интерфейса Board (board.hpp) с заданным правилом. Какие
+// движки войдут в библиотеку, решается при сборке (опции
+// MEMOIZA_ENGINE_*); makeEngine создаёт движок по имени среди собранных:
+//   dense    — битовая сетка, шаг по активным тайлам (как в main.cpp),
+//              граница bounded или torus;
+//   sparse   — множество клеток, счётчики соседей в хеш-таблице
+//              (как в dyn_main.cpp), граница bounded;
+//   rows     — множество клеток, проход по отсортированным строкам;
+//   hashlife — неограниченная плоскость;
+//   adaptive — переносит поле между плотным, разреженным представлением
+//              и квадродеревом по плотности и активности,
+//              граница bounded или torus.
+
+namespace memoiza {
+
+struct EngineConfig {
+    Topology topology = Topology::Bounded;
+    std::int64_t rows = 64;   // для plane не используются
+    std::int64_t cols = 64;
+    Rule rule = CONWAY_RULE;
+    ThreadPool* pool = nullptr;  // nullptr — движок создаёт свой пул
+};
+
+// Имена движков, собранных в библиотеку
+std::vector<std::string> engineNames();
+
+// Движок по имени; nullptr и текст в error, если движок не собран или
+// не поддерживает настройки (например, тор или правило с B0)
+std::unique_ptr<Board> makeEngine(const std::string& name, const EngineConfig& config, std::string& error);
+
+// Текущее представление адаптивного движка ("dense", "sparse" или
+// "quadtree") и число переносов в switches; nullptr — движок не адаптивный
+const char* adaptiveBackend(const Board& board, std::uint64_t* switches = nullptr);
+
+} // namespace memoiza
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// --------------------------------------------------------------
+// ПЕРЕМОТКА К ЛЮБОМУ ПОКОЛЕНИЮ: СНИМКИ И НАЙДЕННЫЙ ЦИКЛ
+// --------------------------------------------------------------
+//
+// Для любого представления поля с шагом step(State&): во время прогона
+// запоминаются снимки состояния, после поиска цикла — его начало и
+// длина. stateAt(gen) сворачивает gen в цикл, берёт ближайший снимок не
+// позже и досчитывает от него. Число снимков ограничено maxSnapshots:
+// когда место кончается, остаётся каждый второй, а промежуток между
+// снимками удваивается. Закреплённые снимки (pinned) не выбрасываются;
+// если закрепить начало цикла, любое поколение после него стоит не
+// больше длины цикла шагов, каким бы большим ни был номер.
+//
+// Для разреженного поля с записанной историей то же делает
+// CheckpointStore (setCycle + stateAt) без досчёта.
+
+namespace memoiza {
+
+template <class State, class Step>
+class FastForward {
+public:
+    explicit FastForward(Step step, std::size_t maxSnapshots = 64)
+        : step_(std::move(step)), max_(std::max<std::size_t>(maxSnapshots, 2)) {}
+
+    // Состояние поколения generation. Снимок сохраняется, если от
+    // предыдущего прошло не меньше interval() поколений или pinned.
+    // Без pinned поколения должны идти по возрастанию.
+    void record(std::uint64_t generation, const State& state, bool pinned = false) {
+        horizon_ = std::max(horizon_, generation + 1);
+        auto pos = after(snapshots_.begin(), snapshots_.end(), generation);
+        if (pos != snapshots_.begin() && std::prev(pos)->generation == generation) {
+            std::prev(pos)->pinned = std::prev(pos)->pinned || pinned;
+            return;
+        }
+        if (!pinned) {
+            if (pos != snapshots_.begin() && generation - std::prev(pos)->generation < interval_) return;
+            if (snapshots_.size() >= max_) {
+                // После прореживания итераторы недействительны, а позже
+                // generation может стоять закреплённый снимок: место ищется заново
+                thin();
+                pos = after(snapshots_.begin(), snapshots_.end(), generation);
+                if (pos != snapshots_.begin() && generation - std::prev(pos)->generation < interval_) return;
+            }
+        }
+        snapshots_.insert(pos, Snapshot{generation, state, pinned});
+    }
+
+    // Начиная с поколения start, состояния повторяются с периодом length
+    void setCycle(std::uint64_t start, std::uint64_t length) {
+        cycleStart_ = start;
+        cycleLength_ = length;
+        horizon_ = std::max(horizon_, start + length);
+    }
+
+    // Поколение до цикла или внутри первого периода, равное generation;
+    // false — цикла нет, а generation дальше посчитанного
+    bool resolve(std::uint64_t generation, std::uint64_t& stored) const {
+        if (cycleLength_ != 0 && generation >= cycleStart_) {
+            generation = cycleStart_ + (generation - cycleStart_) % cycleLength_;
+        }
+        if (generation >= horizon_) return false;
+        stored = generation;
+        return true;
+    }
+
+    // Точное состояние поколения generation; false — недоступно
+    bool stateAt(std::uint64_t generation, State& out) const {
+        std::uint64_t stored;
+        if (!resolve(generation, stored)) return false;
+        auto pos = after(snapshots_.begin(), snapshots_.end(), stored);
+        if (pos == snapshots_.begin()) return false;
+        --pos;
+        out = pos->state;
+        for (std::uint64_t g = pos->generation; g < stored; g++) step_(out);
+        return true;
+    }
+
+    bool cycleFound() const { return cycleLength_ != 0; }
+    std::uint64_t cycleStart() const { return cycleStart_; }
+    std::uint64_t cycleLength() const { return cycleLength_; }
+    std::uint64_t interval() const { return interval_; }
+    std::size_t snapshots() const { return snapshots_.size(); }
+
+private:
+    struct Snapshot {
+        std::uint64_t generation;
+        State state;
+        bool pinned;
+    };
+
+    // Первый снимок позже generation в [begin, end)
+    template <class It>
+    static It after(It begin, It end, std::uint64_t generation) {
+        return std::upper_bound(begin, end, generation,
+                                [](std::uint64_t g, const Snapshot& s) { return g < s.generation; });
+    }
+
+    // Вдвое реже: остаются первый снимок, снимки на новой сетке и закреплённые
+    void thin() {
+        interval_ *= 2;
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < snapshots_.size(); i++) {
+            const Snapshot& s = snapshots_[i];
+            if (i == 0 || s.pinned || s.generation % interval_ == 0) {
+                if (kept != i) snapshots_[kept] = std::move(snapshots_[i]);
+                kept++;
+            }
+        }
+        snapshots_.erase(snapshots_.begin() + static_cast<std::ptrdiff_t>(kept), snapshots_.end());
+    }
+
+    // Вызывается только из stateAt, состояние шага (буферы) — его дело
+    mutable Step step_;
+    std::size_t max_;
+    std::uint64_t interval_ = 1;
+    std::uint64_t horizon_ = 0;  // поколения 0 .. horizon_-1 посчитаны
+    std::uint64_t cycleStart_ = 0;
+    std::uint64_t cycleLength_ = 0;
+    std::vector<Snapshot> snapshots_;  // по возрастанию поколения
+};
+
+// FastForward с типом шага, выведенным из лямбды
+template <class State, class Step>
+FastForward<State, Step> makeFastForward(Step step, std::size_t maxSnapshots = 64) {
+    return FastForward<State, Step>(std::move(step), maxSnapshots);
+}
+
+} // namespace memoiza
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+// --------------------------------------------------------------
+// ПЛОСКИЕ ХЕШ-МНОЖЕСТВО И ХЕШ-ТАБЛИЦА ДЛЯ КЛЕТОК
+// --------------------------------------------------------------
+//
+// Клетка упаковывается в 64-битный ключ: строка в старших 32 битах,
+// столбец — в младших. Таблица — один массив слотов с открытой
+// адресацией и линейным пробированием, без узлов и указателей.
+// clear() сохраняет ёмкость, поэтому между поколениями память
+// переиспользуется, а не выделяется заново. Но если таблица больше
+// нужной для прежнего числа элементов в SHRINK_FACTOR раз (население
+// выросло взрывом и вымерло), clear() сокращает её: обход и очистка
+// стоят числа слотов, а не пиковой ёмкости. Сокращение идёт в пределах
+// уже выделенного буфера и памяти не выделяет.
+
+namespace memoiza {
+
+using CellKey = std::uint64_t;
+
+inline CellKey packCell(std::uint64_t row, std::uint64_t col) {
+    return (row << 32) | (col & 0xffffffffULL);
+}
+inline std::uint32_t cellRow(CellKey key) { return static_cast<std::uint32_t>(key >> 32); }
+inline std::uint32_t cellCol(CellKey key) { return static_cast<std::uint32_t>(key); }
+
+// Финализатор MurmurHash3: соседние клетки расходятся по всей таблице
+inline std::uint64_t mixKey(std::uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// Пустой слот; клетка (2^32-1, 2^32-1) недопустима
+static const CellKey EMPTY_CELL = ~0ULL;
+
+// Ёмкость (степень двойки) для n элементов при заполнении не выше 1/2
+inline std::size_t flatCapacityFor(std::size_t n) {
+    std::size_t cap = 16;
+    while (cap < n * 2) cap *= 2;
+    return cap;
+}
+
+// Во сколько раз таблица может превышать нужную ёмкость до сокращения
+static const std::size_t SHRINK_FACTOR = 8;
+
+// Число слотов после clear(), если до неё было n элементов в slots слотах:
+// прежнее или, для слишком большой таблицы, вдвое больше нужного
+inline std::size_t flatSlotsAfterClear(std::size_t n, std::size_t slots) {
+    std::size_t fit = flatCapacityFor(n);
+    return slots > fit * SHRINK_FACTOR ? fit * 2 : slots;
+}
+
+class FlatCellSet {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = CellKey;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const CellKey*;
+        using reference = CellKey;
+
+        const_iterator(const CellKey* p, const CellKey* end) : p_(p), end_(end) { skip(); }
+        CellKey operator*() const { return *p_; }
+        const_iterator& operator++() {
+            ++p_;
+            skip();
+            return *this;
+        }
+        bool operator!=(const const_iterator& o) const { return p_ != o.p_; }
+        bool operator==(const const_iterator& o) const { return p_ == o.p_; }
+    private:
+        void skip() {
+            while (p_ != end_ && *p_ == EMPTY_CELL) ++p_;
+        }
+        const CellKey* p_;
+        const CellKey* end_;
+    };
+
+    FlatCellSet() = default;
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    std::size_t capacity() const { return slots_.size(); }
+
+    const_iterator begin() const {
+        return const_iterator(slots_.data(), slots_.data() + slots_.size());
+    }
+    const_iterator end() const {
+        return const_iterator(slots_.data() + slots_.size(), slots_.data() + slots_.size());
+    }
+
+    // Очистить; ёмкость сохраняется, если она не слишком велика (см. выше)
+    void clear() {
+        std::size_t slots = flatSlotsAfterClear(size_, slots_.size());
+        if (slots != slots_.size()) {
+            slots_.assign(slots, EMPTY_CELL);
+        } else if (size_ != 0) {
+            std::fill(slots_.begin(), slots_.end(), EMPTY_CELL);
+        }
+        size_ = 0;
+    }
+
+    void reserve(std::size_t n) {
+        if (flatCapacityFor(n) > slots_.size()) rehash(flatCapacityFor(n));
+    }
+
+    // true, если ключ добавлен (его ещё не было)
+    bool insert(CellKey key) {
+        if ((size_ + 1) * 2 > slots_.size()) rehash(flatCapacityFor(size_ + 1));
+        std::size_t mask = slots_.size() - 1;
+        std::size_t i = mixKey(key) & mask;
+        while (slots_[i] != EMPTY_CELL) {
+            if (slots_[i] == key) return false;
+            i = (i + 1) & mask;
+        }
+        slots_[i] = key;
+        size_++;
+        return true;
+    }
+
+    bool contains(CellKey key) const {
+        if (size_ == 0) return false;
+        std::size_t mask = slots_.size() - 1;
+        std::size_t i = mixKey(key) & mask;
+        while (slots_[i] != EMPTY_CELL) {
+            if (slots_[i] == key) return true;
+            i = (i + 1) & mask;
+        }
+        return false;
+    }
+
+    // Удаление со сдвигом хвоста цепочки назад (без «надгробий»)
+    bool erase(CellKey key) {
+        if (size_ == 0) return false;
+        std::size_t mask = slots_.size() - 1;
+        std::size_t i = mixKey(key) & mask;
+        while (slots_[i] != key) {
+            if (slots_[i] == EMPTY_CELL) return false;
+            i = (i + 1) & mask;
+        }
+        std::size_t j = i;
+        for (;;) {
+            j = (j + 1) & mask;
+            if (slots_[j] == EMPTY_CELL) break;
+            std::size_t home = mixKey(slots_[j]) & mask;
+            // Элемент из j можно перенести в дыру i, если его «дом» не лежит в (i, j]
+            bool stays = (i <= j) ? (home > i && home <= j) : (home > i || home <= j);
+            if (!stays) {
+                slots_[i] = slots_[j];
+                i = j;
+            }
+        }
+        slots_[i] = EMPTY_CELL;
+        size_--;
+        return true;
+    }
+
+    bool operator==(const FlatCellSet& other) const {
+        if (size_ != other.size_) return false;
+        for (CellKey key : *this) {
+            if (!other.contains(key)) return false;
+        }
+        return true;
+    }
+    bool operator!=(const FlatCellSet& other) const { return !(*this == other); }
+
+private:
+    void rehash(std::size_t newCapacity) {
+        std::vector<CellKey> old(newCapacity, EMPTY_CELL);
+        old.swap(slots_);
+        size_ = 0;
+        for (CellKey key : old) {
+            if (key != EMPTY_CELL) insert(key);
+        }
+    }
+
+    std::vector<CellKey> slots_;
+    std::size_t size_ = 0;
+};
+
+// Отображение «клетка -> значение» с той же схемой адресации
+template <class V>
+class FlatCellMap {
+public:
+    std::size_t size() const { return size_; }
+
+    void clear() {
+        std::size_t slots = flatSlotsAfterClear(size_, keys_.size());
+        if (slots != keys_.size()) {
+            keys_.assign(slots, EMPTY_CELL);
+            values_.resize(slots);
+        } else if (size_ != 0) {
+            std::fill(keys_.begin(), keys_.end(), EMPTY_CELL);
+        }
+        size_ = 0;
+    }
+
+    void reserve(std::size_t n) {
+        if (flatCapacityFor(n) > keys_.size()) rehash(flatCapacityFor(n));
+    }
+
+    // Значение по ключу; отсутствующий ключ добавляется со значением V{}
+    V& operator[](CellKey key) {
+        if ((size_ + 1) * 2 > keys_.size()) rehash(flatCapacityFor(size_ + 1));
+        std::size_t mask = keys_.size() - 1;
+        std::size_t i = mixKey(key) & mask;
+        while (keys_[i] != EMPTY_CELL) {
+            if (keys_[i] == key) return values_[i];
+            i = (i + 1) & mask;
+        }
+        keys_[i] = key;
+        values_[i] = V{};
+        size_++;
+        return values_[i];
+    }
+
+    V* find(CellKey key) {
+        if (size_ == 0) return nullptr;
+        std::size_t mask = keys_.size() - 1;
+        std::size_t i = mixKey(key) & mask;
+        while (keys_[i] != EMPTY_CELL) {
+            if (keys_[i] == key) return &values_[i];
+            i = (i + 1) & mask;
+        }
+        return nullptr;
+    }
+
+    // fn(key, value) для всех элементов
+    template <class Fn>
+    void forEach(Fn&& fn) const {
+        for (std::size_t i = 0; i < keys_.size(); i++) {
+            if (keys_[i] != EMPTY_CELL) fn(keys_[i], values_[i]);
+        }
+    }
+
+private:
+    void rehash(std::size_t newCapacity) {
+        std::vector<CellKey> oldKeys(newCapacity, EMPTY_CELL);
+        std::vector<V> oldValues(newCapacity);
+        oldKeys.swap(keys_);
+        oldValues.swap(values_);
+        size_ = 0;
+        for (std::size_t i = 0; i < oldKeys.size(); i++) {
+            if (oldKeys[i] != EMPTY_CELL) (*this)[oldKeys[i]] = oldValues[i];
+        }
+    }
+
+    std::vector<CellKey> keys_;
+    std::vector<V> values_;
+    std::size_t size_ = 0;
+};
+
+} // namespace memoiza
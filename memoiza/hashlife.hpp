@@ -0,0 +1,472 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rule.hpp"
+
+// --------------------------------------------------------------
+// HASHLIFE: КАНОНИЧЕСКОЕ КВАДРОДЕРЕВО С МЕМОИЗАЦИЕЙ ШАГОВ
+// --------------------------------------------------------------
+//
+// Узел уровня k — квадрат 2^k x 2^k из четырёх детей уровня k-1.
+// Одинаковые поддеревья хранятся один раз (hash-consing), поэтому
+// равные состояния — это один и тот же узел. Для каждого узла
+// запоминается центр уровня k-1 через 2^j поколений, что позволяет
+// прыгать на миллиарды поколений вперёд для периодичных и разреженных
+// конфигураций. Поле неограниченное, координаты 64-битные; ось y
+// направлена вниз (строки), ось x — вправо (столбцы). Правило — любое
+// B/S без B0: пустой узел должен оставаться пустым.
+
+namespace memoiza {
+
+struct HashLifeNode {
+    const HashLifeNode* nw = nullptr;
+    const HashLifeNode* ne = nullptr;
+    const HashLifeNode* sw = nullptr;
+    const HashLifeNode* se = nullptr;
+    int level = 0;
+    std::uint64_t population = 0;
+    // Структурный хеш: одинаковые поддеревья дают одинаковый хеш
+    std::uint64_t hash = 0;
+    // Центр через 2^(level-2) поколений (nullptr — ещё не вычислен)
+    mutable const HashLifeNode* result = nullptr;
+};
+
+class HashLife {
+public:
+    using Node = HashLifeNode;
+
+    HashLife() { reset(); }
+
+    HashLife(const HashLife&) = delete;
+    HashLife& operator=(const HashLife&) = delete;
+
+    // Пустое поле, поколение 0; все узлы и кэши удаляются
+    void reset() {
+        nodes_.clear();
+        table_.clear();
+        stepCache_.clear();
+        empty_.clear();
+        leaf_[0] = makeLeaf(false);
+        leaf_[1] = makeLeaf(true);
+        root_ = emptyNode(MIN_ROOT_LEVEL);
+        generation_ = 0;
+    }
+
+    // Сменить правило; поле очищается, так как запомненные шаги верны
+    // только для прежнего правила. false — правило с B0 не поддерживается.
+    bool setRule(const Rule& rule) {
+        if (rule.birth & 1u) return false;
+        rule_ = rule;
+        reset();
+        return true;
+    }
+    const Rule& rule() const { return rule_; }
+
+    std::uint64_t generation() const { return generation_; }
+    std::uint64_t population() const { return root_->population; }
+    const Node* root() const { return root_; }
+    std::size_t nodeCount() const { return nodes_.size(); }
+
+    // Хеш текущего состояния: корень всегда канонический,
+    // поэтому равные конфигурации дают равный хеш (и один узел)
+    std::uint64_t hash() const { return root_->hash; }
+
+    // Установить корень (например, ранее сохранённый root())
+    void setRoot(const Node* root, std::uint64_t generation) {
+        root_ = shrink(root);
+        generation_ = generation;
+    }
+
+    void setCell(std::int64_t x, std::int64_t y, bool alive) {
+        while (!contains(root_, x, y)) root_ = expand(root_);
+        std::int64_t half = std::int64_t(1) << (root_->level - 1);
+        root_ = shrink(setRec(root_, x + half, y + half, alive));
+    }
+
+    // Узлы для сборки дерева снаружи (чтение Macrocell, потоковая сборка
+    // из RLE): те же канонические узлы, что и у setCell
+    const Node* leaf(bool alive) const { return leaf_[alive ? 1 : 0]; }
+    const Node* makeNode(const Node* nw, const Node* ne, const Node* sw, const Node* se) {
+        return join(nw, ne, sw, se);
+    }
+    const Node* empty(int level) { return emptyNode(level); }
+
+    // Поставить квадрат block уровня k левым верхним углом в (x, y);
+    // x и y кратны 2^k. Прежнее содержимое квадрата заменяется.
+    void setBlock(const Node* block, std::int64_t x, std::int64_t y) {
+        std::int64_t size = std::int64_t(1) << block->level;
+        while (root_->level <= block->level || !contains(root_, x, y) ||
+               !contains(root_, x + size - 1, y + size - 1)) {
+            root_ = expand(root_);
+        }
+        std::int64_t half = std::int64_t(1) << (root_->level - 1);
+        root_ = shrink(setBlockRec(root_, block, x + half, y + half));
+    }
+
+    bool getCell(std::int64_t x, std::int64_t y) const {
+        if (!contains(root_, x, y)) return false;
+        std::int64_t half = std::int64_t(1) << (root_->level - 1);
+        return getRec(root_, x + half, y + half);
+    }
+
+    // Обойти живые клетки: fn(x, y)
+    template <class Fn>
+    void forEachLive(Fn&& fn) const {
+        std::int64_t half = std::int64_t(1) << (root_->level - 1);
+        forEachRec(root_, -half, -half, fn);
+    }
+
+    // Рамка живых клеток: столбцы x0..x1, строки y0..y1; false — поле пусто
+    bool bounds(std::int64_t& x0, std::int64_t& y0, std::int64_t& x1, std::int64_t& y1) const {
+        if (root_->population == 0) return false;
+        x0 = y0 = INT64_MAX;
+        x1 = y1 = INT64_MIN;
+        std::int64_t half = std::int64_t(1) << (root_->level - 1);
+        boundsRec(root_, -half, -half, x0, y0, x1, y1);
+        return true;
+    }
+
+    // Продвинуть поле на generations поколений: по степеням двойки
+    void advance(std::uint64_t generations) {
+        for (int j = 63; j >= 0; j--) {
+            if ((generations >> j) & 1ULL) advancePow2(j);
+        }
+    }
+
+    void step() { advancePow2(0); }
+
+    // Продвинуть поле на 2^j поколений
+    void advancePow2(int j) {
+        // Поле должно помещаться в центральную четверть корня
+        while (root_->level < j + 3 || !borderEmpty(root_)) root_ = expand(root_);
+        root_ = expand(root_);
+        root_ = shrink(successor(root_, j));
+        generation_ += std::uint64_t(1) << j;
+    }
+
+    // Пересобрать хранилище только из узлов, достижимых из корня и keep.
+    // Указатели в keep обновляются; все прочие указатели на узлы недействительны.
+    void collectGarbage(std::vector<const Node*>& keep) {
+        std::deque<Node> oldNodes;
+        oldNodes.swap(nodes_);
+        table_.clear();
+        stepCache_.clear();
+        empty_.clear();
+        std::unordered_map<const Node*, const Node*> remap;
+        for (int alive = 0; alive < 2; alive++) {
+            const Node* fresh = makeLeaf(alive != 0);
+            remap[leaf_[alive]] = fresh;
+            leaf_[alive] = fresh;
+        }
+        root_ = copyRec(root_, remap);
+        for (auto& k : keep) k = copyRec(k, remap);
+    }
+
+private:
+    static const int MIN_ROOT_LEVEL = 3;
+
+    struct Key {
+        const Node* nw;
+        const Node* ne;
+        const Node* sw;
+        const Node* se;
+        bool operator==(const Key& o) const {
+            return nw == o.nw && ne == o.ne && sw == o.sw && se == o.se;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& k) const {
+            return static_cast<std::size_t>(combine(k.nw->hash, k.ne->hash, k.sw->hash, k.se->hash));
+        }
+    };
+
+    struct StepKey {
+        const Node* node;
+        int j;
+        bool operator==(const StepKey& o) const { return node == o.node && j == o.j; }
+    };
+
+    struct StepKeyHash {
+        std::size_t operator()(const StepKey& k) const {
+            return static_cast<std::size_t>(mix(k.node->hash ^ (static_cast<std::uint64_t>(k.j) << 56)));
+        }
+    };
+
+    static std::uint64_t mix(std::uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    static std::uint64_t combine(std::uint64_t a, std::uint64_t b, std::uint64_t c, std::uint64_t d) {
+        std::uint64_t h = mix(a + 0x9e3779b97f4a7c15ULL);
+        h = mix(h ^ (b + 0x6a09e667f3bcc909ULL));
+        h = mix(h ^ (c + 0xbb67ae8584caa73bULL));
+        return mix(h ^ (d + 0x3c6ef372fe94f82bULL));
+    }
+
+    const Node* makeLeaf(bool alive) {
+        nodes_.emplace_back();
+        Node& n = nodes_.back();
+        n.level = 0;
+        n.population = alive ? 1 : 0;
+        n.hash = alive ? 0x5bd1e9955bd1e995ULL : 0x2545f4914f6cdd1dULL;
+        return &n;
+    }
+
+    // Канонический узел из четырёх детей одного уровня
+    const Node* join(const Node* nw, const Node* ne, const Node* sw, const Node* se) {
+        Key key{nw, ne, sw, se};
+        auto it = table_.find(key);
+        if (it != table_.end()) return it->second;
+        nodes_.emplace_back();
+        Node& n = nodes_.back();
+        n.nw = nw;
+        n.ne = ne;
+        n.sw = sw;
+        n.se = se;
+        n.level = nw->level + 1;
+        n.population = nw->population + ne->population + sw->population + se->population;
+        n.hash = combine(nw->hash, ne->hash, sw->hash, se->hash) + static_cast<std::uint64_t>(n.level);
+        table_.emplace(key, &n);
+        return &n;
+    }
+
+    const Node* emptyNode(int level) {
+        while (static_cast<int>(empty_.size()) <= level) {
+            if (empty_.empty()) {
+                empty_.push_back(leaf_[0]);
+            } else {
+                const Node* e = empty_.back();
+                empty_.push_back(join(e, e, e, e));
+            }
+        }
+        return empty_[level];
+    }
+
+    // Центральный подквадрат уровня k-1
+    const Node* centre(const Node* n) {
+        return join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+    }
+
+    // Тот же узел на уровень выше, в центре пустого поля
+    const Node* expand(const Node* n) {
+        const Node* e = emptyNode(n->level - 1);
+        return join(join(e, e, e, n->nw), join(e, e, n->ne, e),
+                    join(e, n->sw, e, e), join(n->se, e, e, e));
+    }
+
+    // Внешнее кольцо из 12 внуков пусто (всё живое — в центре)
+    static bool borderEmpty(const Node* n) {
+        if (n->level < 2) return n->population == 0;
+        std::uint64_t inner = n->nw->se->population + n->ne->sw->population +
+                              n->sw->ne->population + n->se->nw->population;
+        return inner == n->population;
+    }
+
+    // Уменьшить корень, пока внешнее кольцо пусто: единая форма состояния
+    const Node* shrink(const Node* n) {
+        while (n->level > MIN_ROOT_LEVEL && borderEmpty(n)) n = centre(n);
+        return n;
+    }
+
+    static bool contains(const Node* n, std::int64_t x, std::int64_t y) {
+        if (n->level >= 63) return true;
+        std::int64_t half = std::int64_t(1) << (n->level - 1);
+        return x >= -half && x < half && y >= -half && y < half;
+    }
+
+    // x, y — смещение от левого верхнего угла узла
+    const Node* setRec(const Node* n, std::int64_t x, std::int64_t y, bool alive) {
+        if (n->level == 0) return leaf_[alive ? 1 : 0];
+        std::int64_t half = std::int64_t(1) << (n->level - 1);
+        const Node* nw = n->nw;
+        const Node* ne = n->ne;
+        const Node* sw = n->sw;
+        const Node* se = n->se;
+        if (y < half) {
+            if (x < half) nw = setRec(nw, x, y, alive);
+            else ne = setRec(ne, x - half, y, alive);
+        } else {
+            if (x < half) sw = setRec(sw, x, y - half, alive);
+            else se = setRec(se, x - half, y - half, alive);
+        }
+        return join(nw, ne, sw, se);
+    }
+
+    const Node* setBlockRec(const Node* n, const Node* block, std::int64_t x, std::int64_t y) {
+        if (n->level == block->level) return block;
+        std::int64_t half = std::int64_t(1) << (n->level - 1);
+        const Node* nw = n->nw;
+        const Node* ne = n->ne;
+        const Node* sw = n->sw;
+        const Node* se = n->se;
+        if (y < half) {
+            if (x < half) nw = setBlockRec(nw, block, x, y);
+            else ne = setBlockRec(ne, block, x - half, y);
+        } else {
+            if (x < half) sw = setBlockRec(sw, block, x, y - half);
+            else se = setBlockRec(se, block, x - half, y - half);
+        }
+        return join(nw, ne, sw, se);
+    }
+
+    static bool getRec(const Node* n, std::int64_t x, std::int64_t y) {
+        while (n->level > 0) {
+            if (n->population == 0) return false;
+            std::int64_t half = std::int64_t(1) << (n->level - 1);
+            bool right = x >= half;
+            bool down = y >= half;
+            n = down ? (right ? n->se : n->sw) : (right ? n->ne : n->nw);
+            if (right) x -= half;
+            if (down) y -= half;
+        }
+        return n->population != 0;
+    }
+
+    template <class Fn>
+    static void forEachRec(const Node* n, std::int64_t x, std::int64_t y, Fn& fn) {
+        if (n->population == 0) return;
+        if (n->level == 0) {
+            fn(x, y);
+            return;
+        }
+        std::int64_t half = std::int64_t(1) << (n->level - 1);
+        forEachRec(n->nw, x, y, fn);
+        forEachRec(n->ne, x + half, y, fn);
+        forEachRec(n->sw, x, y + half, fn);
+        forEachRec(n->se, x + half, y + half, fn);
+    }
+
+    // Поддеревья, целиком лежащие внутри уже найденной рамки, не обходятся
+    static void boundsRec(const Node* n, std::int64_t x, std::int64_t y, std::int64_t& x0, std::int64_t& y0,
+                          std::int64_t& x1, std::int64_t& y1) {
+        if (n->population == 0) return;
+        if (n->level == 0) {
+            x0 = std::min(x0, x);
+            y0 = std::min(y0, y);
+            x1 = std::max(x1, x);
+            y1 = std::max(y1, y);
+            return;
+        }
+        std::int64_t half = std::int64_t(1) << (n->level - 1);
+        if (n->level < 62 && x >= x0 && y >= y0 && x + 2 * half - 1 <= x1 && y + 2 * half - 1 <= y1) return;
+        boundsRec(n->nw, x, y, x0, y0, x1, y1);
+        boundsRec(n->ne, x + half, y, x0, y0, x1, y1);
+        boundsRec(n->sw, x, y + half, x0, y0, x1, y1);
+        boundsRec(n->se, x + half, y + half, x0, y0, x1, y1);
+    }
+
+    // Узел 4x4 -> центр 2x2 через одно поколение
+    const Node* baseStep(const Node* n) {
+        // Биты 4x4: бит (y*4 + x)
+        unsigned bits = 0;
+        const Node* quads[4] = {n->nw, n->ne, n->sw, n->se};
+        for (int q = 0; q < 4; q++) {
+            int ox = (q & 1) * 2;
+            int oy = (q >> 1) * 2;
+            const Node* c = quads[q];
+            if (c->nw->population) bits |= 1u << ((oy) * 4 + ox);
+            if (c->ne->population) bits |= 1u << ((oy) * 4 + ox + 1);
+            if (c->sw->population) bits |= 1u << ((oy + 1) * 4 + ox);
+            if (c->se->population) bits |= 1u << ((oy + 1) * 4 + ox + 1);
+        }
+        const Node* out[4];
+        for (int i = 0; i < 4; i++) {
+            int cx = 1 + (i & 1);
+            int cy = 1 + (i >> 1);
+            int neighbors = 0;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    if (dx == 0 && dy == 0) continue;
+                    neighbors += (bits >> ((cy + dy) * 4 + cx + dx)) & 1u;
+                }
+            }
+            bool alive = (bits >> (cy * 4 + cx)) & 1u;
+            out[i] = leaf_[rule_.next(alive, neighbors) ? 1 : 0];
+        }
+        return join(out[0], out[1], out[2], out[3]);
+    }
+
+    // Центр узла уровня k через 2^j поколений, j <= k-2
+    const Node* successor(const Node* n, int j) {
+        if (n->population == 0) return emptyNode(n->level - 1);
+        const bool full = (j == n->level - 2);
+        if (full && n->result != nullptr) return n->result;
+        if (!full) {
+            auto it = stepCache_.find(StepKey{n, j});
+            if (it != stepCache_.end()) return it->second;
+        }
+
+        const Node* res;
+        if (n->level == 2) {
+            res = baseStep(n);
+        } else {
+            // Девять перекрывающихся подквадратов уровня k-1
+            const Node* n00 = n->nw;
+            const Node* n01 = join(n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw);
+            const Node* n02 = n->ne;
+            const Node* n10 = join(n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne);
+            const Node* n11 = join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+            const Node* n12 = join(n->ne->sw, n->ne->se, n->se->nw, n->se->ne);
+            const Node* n20 = n->sw;
+            const Node* n21 = join(n->sw->ne, n->se->nw, n->sw->se, n->se->sw);
+            const Node* n22 = n->se;
+
+            // Полный шаг — два полушага; короткий — центр, затем шаг 2^j
+            const Node *r00, *r01, *r02, *r10, *r11, *r12, *r20, *r21, *r22;
+            if (full) {
+                r00 = successor(n00, j - 1); r01 = successor(n01, j - 1); r02 = successor(n02, j - 1);
+                r10 = successor(n10, j - 1); r11 = successor(n11, j - 1); r12 = successor(n12, j - 1);
+                r20 = successor(n20, j - 1); r21 = successor(n21, j - 1); r22 = successor(n22, j - 1);
+            } else {
+                r00 = centre(n00); r01 = centre(n01); r02 = centre(n02);
+                r10 = centre(n10); r11 = centre(n11); r12 = centre(n12);
+                r20 = centre(n20); r21 = centre(n21); r22 = centre(n22);
+            }
+            int jj = full ? j - 1 : j;
+            res = join(successor(join(r00, r01, r10, r11), jj),
+                       successor(join(r01, r02, r11, r12), jj),
+                       successor(join(r10, r11, r20, r21), jj),
+                       successor(join(r11, r12, r21, r22), jj));
+        }
+
+        if (full) {
+            n->result = res;
+        } else {
+            stepCache_.emplace(StepKey{n, j}, res);
+        }
+        return res;
+    }
+
+    const Node* copyRec(const Node* n, std::unordered_map<const Node*, const Node*>& remap) {
+        auto it = remap.find(n);
+        if (it != remap.end()) return it->second;
+        const Node* copy = join(copyRec(n->nw, remap), copyRec(n->ne, remap),
+                                copyRec(n->sw, remap), copyRec(n->se, remap));
+        remap[n] = copy;
+        return copy;
+    }
+
+    std::deque<Node> nodes_;
+    std::unordered_map<Key, const Node*, KeyHash> table_;
+    std::unordered_map<StepKey, const Node*, StepKeyHash> stepCache_;
+    std::vector<const Node*> empty_;
+    const Node* leaf_[2] = {nullptr, nullptr};
+    Rule rule_;
+    const Node* root_ = nullptr;
+    std::uint64_t generation_ = 0;
+};
+
+} // namespace memoiza
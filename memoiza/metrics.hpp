@@ -0,0 +1,159 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+#include "alloc_counter.hpp"
+
+// --------------------------------------------------------------
+// ТОЧКИ ТРАССИРОВКИ И МЕТРИКИ ГОРЯЧЕГО ПУТИ
+// --------------------------------------------------------------
+//
+// MEMOIZA_TRACE(enabled, действие) выполняет действие (вывод, сборку
+// строки) только при истинном enabled: аргументы отладочного сообщения
+// не вычисляются, пока отладка выключена. С -DMEMOIZA_NO_TRACE точки
+// трассировки и метрики удаляются при компиляции.
+//
+// Metrics копит время по фазам поколения и счётчики и раз в every
+// поколений пишет одну строку JSON (JSON Lines): значения накопленные
+// с начала запуска, разности между строками считает читатель. Пока
+// метрики не включены, таймер фазы — одна проверка указателя.
+
+#ifdef MEMOIZA_NO_TRACE
+#define MEMOIZA_TRACE(enabled, ...) ((void)sizeof(!!(enabled)))
+#else
+#define MEMOIZA_TRACE(enabled, ...)            \
+    do {                                       \
+        if (__builtin_expect(!!(enabled), 0)) { \
+            __VA_ARGS__;                       \
+        }                                      \
+    } while (0)
+#endif
+
+namespace memoiza {
+
+// Фазы поколения
+enum class Phase { Step, Hash, CycleCheck, Cap, Record, Count };
+
+// Счётчики. Allocations берётся из alloc_counter.hpp при записи строки.
+enum class Counter { Births, Deaths, Removed, LiveCells, Allocations, Count };
+
+class Metrics {
+public:
+    // Измеряет время от создания до stop() или разрушения и добавляет его к фазе
+    class Timer {
+    public:
+        Timer(Metrics* metrics, Phase phase) : metrics_(metrics), phase_(phase) {
+            if (metrics_ != nullptr) start_ = std::chrono::steady_clock::now();
+        }
+        ~Timer() { stop(); }
+
+        // Закончить измерение раньше конца области видимости
+        void stop() {
+            if (metrics_ == nullptr) return;
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_).count();
+            Slot& slot = metrics_->phases_[static_cast<int>(phase_)];
+            slot.nanoseconds += static_cast<std::uint64_t>(ns);
+            slot.calls++;
+            metrics_ = nullptr;
+        }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Metrics* metrics_;
+        Phase phase_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Включить запись в out раз в every поколений (0 — только итоговая строка)
+    void open(std::ostream& out, std::uint64_t every) {
+        out_ = &out;
+        every_ = every;
+        started_ = std::chrono::steady_clock::now();
+        allocationBase_ = allocationCount();
+    }
+
+    bool enabled() const {
+#ifdef MEMOIZA_NO_TRACE
+        return false;
+#else
+        return out_ != nullptr;
+#endif
+    }
+
+    Timer time(Phase phase) { return Timer(enabled() ? this : nullptr, phase); }
+
+    void add(Counter counter, std::uint64_t value) {
+        if (enabled()) counters_[static_cast<int>(counter)] += value;
+    }
+    void set(Counter counter, std::uint64_t value) {
+        if (enabled()) counters_[static_cast<int>(counter)] = value;
+    }
+
+    // Поколение до шага имело before клеток, после — after, изменилось
+    // flips клеток: рождений минус смертей = after - before
+    void countStep(std::uint64_t before, std::uint64_t after, std::uint64_t flips) {
+        if (!enabled()) return;
+        std::uint64_t births = (flips + after - before) / 2;
+        counters_[static_cast<int>(Counter::Births)] += births;
+        counters_[static_cast<int>(Counter::Deaths)] += flips - births;
+    }
+
+    // Пора ли писать строку после поколения generation
+    bool due(std::uint64_t generation) const {
+        return enabled() && every_ != 0 && generation % every_ == 0 && generation != lastDump_;
+    }
+
+    // Записать строку JSON. Строка собирается в буфере на стеке, чтобы
+    // сама запись не выделяла память и не искажала счётчик выделений.
+    void dump(std::uint64_t generation) {
+        if (!enabled()) return;
+        static const char* const PHASES[] = {"step", "hash", "cycleCheck", "cap", "record"};
+        counters_[static_cast<int>(Counter::Allocations)] = allocationCount() - allocationBase_;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+
+        char buf[1024];
+        int n = std::snprintf(buf, sizeof(buf),
+                              "{\"generation\":%llu,\"seconds\":%.6f,\"births\":%llu,\"deaths\":%llu,"
+                              "\"removed\":%llu,\"liveCells\":%llu,\"allocations\":%llu,\"phases\":{",
+                              static_cast<unsigned long long>(generation), seconds,
+                              value(Counter::Births), value(Counter::Deaths), value(Counter::Removed),
+                              value(Counter::LiveCells), value(Counter::Allocations));
+        for (int p = 0; p < static_cast<int>(Phase::Count); p++) {
+            n += std::snprintf(buf + n, sizeof(buf) - n, "%s\"%s\":{\"seconds\":%.6f,\"calls\":%llu}",
+                               p == 0 ? "" : ",", PHASES[p], phases_[p].nanoseconds * 1e-9,
+                               static_cast<unsigned long long>(phases_[p].calls));
+        }
+        n += std::snprintf(buf + n, sizeof(buf) - n, "}}\n");
+        out_->write(buf, n);
+        out_->flush();
+        lastDump_ = generation;
+    }
+
+    // Итоговая строка, если последнее поколение ещё не записано
+    void finish(std::uint64_t generation) {
+        if (enabled() && generation != lastDump_) dump(generation);
+    }
+
+private:
+    struct Slot {
+        std::uint64_t nanoseconds = 0;
+        std::uint64_t calls = 0;
+    };
+
+    unsigned long long value(Counter counter) const { return counters_[static_cast<int>(counter)]; }
+
+    std::ostream* out_ = nullptr;
+    std::uint64_t every_ = 0;
+    std::uint64_t lastDump_ = ~std::uint64_t(0);
+    std::uint64_t allocationBase_ = 0;
+    std::chrono::steady_clock::time_point started_;
+    Slot phases_[static_cast<int>(Phase::Count)];
+    std::uint64_t counters_[static_cast<int>(Counter::Count)] = {};
+};
+
+} // namespace memoiza
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#include "step_kernels.hpp"
+#include "thread_pool.hpp"
+
+// --------------------------------------------------------------
+// ПАРАЛЛЕЛЬНЫЙ ШАГ БИТОВОЙ СЕТКИ ПО ПОЛОСАМ СТРОК
+// --------------------------------------------------------------
+//
+// Поле режется на полосы строк, полосы шагаются в пуле потоков.
+// Соседние полосы делят только граничные строки (ореол), причём лишь
+// на чтение из src, поэтому копировать и синхронизировать нечего.
+
+namespace memoiza {
+
+// Минимальная высота полосы: меньше — накладные расходы пула заметнее
+static const int MIN_BAND_ROWS = 16;
+
+inline void stepBitGridParallel(const BitGrid& src, BitGrid& dst, ThreadPool& pool) {
+    const int rows = src.rows();
+    StepRowsFn kernel = ruleStepRows();
+    if (pool.size() == 1 || rows < 2 * MIN_BAND_ROWS) {
+        kernel(src, dst, 0, rows);
+        return;
+    }
+    // Примерно четыре полосы на исполнителя — для балансировки нагрузки
+    std::size_t band = std::max<std::size_t>(MIN_BAND_ROWS, rows / (pool.size() * 4));
+    pool.parallelFor(0, static_cast<std::size_t>(rows), band,
+                     [&](std::size_t lo, std::size_t hi) {
+                         kernel(src, dst, static_cast<int>(lo), static_cast<int>(hi));
+                     });
+}
+
+} // namespace memoiza
@@ -0,0 +1,904 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bit_grid.hpp"
+#include "flat_cell_set.hpp"
+#include "hashlife.hpp"
+#include "rule.hpp"
+
+// --------------------------------------------------------------
+// СТАНДАРТНЫЕ ФОРМАТЫ УЗОРОВ: RLE, PLAINTEXT (.cells), MACROCELL (.mc)
+// --------------------------------------------------------------
+//
+// Разбор потоковый: файл читается кусками по 64 КБ, а живые клетки
+// сразу отдаются приёмнику отрезками строк run(row, col, len), без
+// промежуточного списка клеток. Приёмник пишет отрезки прямо в нужное
+// представление: биты BitGrid, FlatCellSet или квадродерево HashLife
+// (оно строится снизу вверх полосами по 8 строк). Macrocell — это уже
+// дерево, его узлы создаются в HashLife напрямую. Координаты RLE и
+// .cells отсчитываются от левого верхнего угла узора (строка 0, столбец 0);
+// корень Macrocell, как и корень HashLife, центрирован в начале координат.
+
+namespace memoiza {
+
+enum class PatternFormat { Unknown, Rle, Cells, Macrocell };
+
+// Что известно об узоре из заголовка
+struct PatternInfo {
+    std::int64_t width = -1;   // -1 — размер не указан
+    std::int64_t height = -1;
+    bool hasRule = false;
+    Rule rule;
+};
+
+// Буферизованное чтение символов с подсчётом строк (для сообщений об ошибках)
+class PatternInput {
+public:
+    explicit PatternInput(std::istream& in) : in_(in), buf_(1 << 16) {}
+
+    int peek() {
+        if (pos_ == len_ && !refill()) return EOF;
+        return static_cast<unsigned char>(buf_[pos_]);
+    }
+
+    int get() {
+        int ch = peek();
+        if (ch != EOF) {
+            pos_++;
+            if (ch == '\n') line_++;
+        }
+        return ch;
+    }
+
+    // Остаток строки без перевода строки и '\r'; false — конец файла
+    bool readLine(std::string& out) {
+        out.clear();
+        int ch = get();
+        if (ch == EOF) return false;
+        while (ch != EOF && ch != '\n') {
+            if (ch != '\r') out += static_cast<char>(ch);
+            ch = get();
+        }
+        return true;
+    }
+
+    void skipLine() {
+        int ch = get();
+        while (ch != EOF && ch != '\n') ch = get();
+    }
+
+    std::uint64_t line() const { return line_; }
+
+private:
+    bool refill() {
+        in_.read(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+        len_ = static_cast<std::size_t>(in_.gcount());
+        pos_ = 0;
+        return len_ > 0;
+    }
+
+    std::istream& in_;
+    std::vector<char> buf_;
+    std::size_t pos_ = 0;
+    std::size_t len_ = 0;
+    std::uint64_t line_ = 1;
+};
+
+inline std::string patternError(const PatternInput& in, const std::string& what) {
+    return "строка " + std::to_string(in.line()) + ": " + what;
+}
+
+// --------------------------------------------------------------
+// ПРИЁМНИКИ ОТРЕЗКОВ
+// --------------------------------------------------------------
+//
+// Приёмник — любой тип с begin(const PatternInfo&) (вызывается после
+// заголовка, до первой клетки) и run(row, col, len). RLE и .cells
+// отдают отрезки по строкам сверху вниз, слева направо.
+
+// Размер узора: ограничивающий прямоугольник живых клеток
+struct BoundsSink {
+    std::int64_t minRow = 0, maxRow = -1, minCol = 0, maxCol = -1;
+    std::uint64_t population = 0;
+
+    void begin(const PatternInfo&) {}
+    void run(std::int64_t row, std::int64_t col, std::int64_t len) {
+        if (population == 0) {
+            minRow = maxRow = row;
+            minCol = col;
+            maxCol = col + len - 1;
+        } else {
+            minRow = std::min(minRow, row);
+            maxRow = std::max(maxRow, row);
+            minCol = std::min(minCol, col);
+            maxCol = std::max(maxCol, col + len - 1);
+        }
+        population += static_cast<std::uint64_t>(len);
+    }
+    std::int64_t height() const { return maxRow - minRow + 1; }
+    std::int64_t width() const { return maxCol - minCol + 1; }
+};
+
+// В плотную сетку со сдвигом (rowOffset, colOffset); что не влезло — отбрасывается
+class DenseSink {
+public:
+    explicit DenseSink(BitGrid& grid, std::int64_t rowOffset = 0, std::int64_t colOffset = 0)
+        : g_(grid), rowOffset_(rowOffset), colOffset_(colOffset) {}
+
+    void begin(const PatternInfo&) {}
+
+    void run(std::int64_t row, std::int64_t col, std::int64_t len) {
+        row += rowOffset_;
+        col += colOffset_;
+        std::int64_t c0 = std::max<std::int64_t>(col, 0);
+        std::int64_t c1 = std::min<std::int64_t>(col + len, g_.cols());
+        if (row < 0 || row >= g_.rows() || c0 >= c1) {
+            clipped_ += static_cast<std::uint64_t>(len);
+            return;
+        }
+        clipped_ += static_cast<std::uint64_t>(len - (c1 - c0));
+        std::uint64_t* p = g_.row(static_cast<int>(row));
+        // Отрезок [c0, c1) — маски по словам
+        for (std::int64_t w = c0 >> 6; w <= (c1 - 1) >> 6; w++) {
+            std::int64_t lo = std::max(c0, w << 6) - (w << 6);
+            std::int64_t hi = std::min(c1, (w + 1) << 6) - (w << 6);
+            std::uint64_t mask = (hi == 64 ? ~0ULL : (1ULL << hi) - 1) & ~((1ULL << lo) - 1);
+            p[w] |= mask;
+        }
+    }
+
+    // Клеток за пределами сетки
+    std::uint64_t clipped() const { return clipped_; }
+
+private:
+    BitGrid& g_;
+    std::int64_t rowOffset_, colOffset_;
+    std::uint64_t clipped_ = 0;
+};
+
+// В разреженное множество; клетки вне [0, 2^32) по любой оси отбрасываются
+class SparseSink {
+public:
+    explicit SparseSink(FlatCellSet& cells, std::int64_t rowOffset = 0, std::int64_t colOffset = 0)
+        : cells_(cells), rowOffset_(rowOffset), colOffset_(colOffset) {}
+
+    void begin(const PatternInfo& info) {
+        if (info.width > 0 && info.height > 0 && info.width * info.height <= (1 << 24)) {
+            cells_.reserve(cells_.size() + static_cast<std::size_t>(info.width * info.height / 4));
+        }
+    }
+
+    void run(std::int64_t row, std::int64_t col, std::int64_t len) {
+        const std::int64_t LIMIT = std::int64_t(1) << 32;
+        row += rowOffset_;
+        col += colOffset_;
+        for (std::int64_t c = col; c < col + len; c++) {
+            if (row < 0 || row >= LIMIT || c < 0 || c >= LIMIT) {
+                clipped_++;
+                continue;
+            }
+            cells_.insert(packCell(static_cast<std::uint64_t>(row), static_cast<std::uint64_t>(c)));
+        }
+    }
+
+    std::uint64_t clipped() const { return clipped_; }
+
+private:
+    FlatCellSet& cells_;
+    std::int64_t rowOffset_, colOffset_;
+    std::uint64_t clipped_ = 0;
+};
+
+// В квадродерево HashLife. Отрезки должны идти по строкам сверху вниз.
+// Клетки копятся в блоках 8x8 одной полосы из 8 строк; заполненная полоса
+// становится строкой узлов уровня 3, а строки узлов попарно сливаются
+// в строки следующего уровня, как разряды двоичного счётчика. Так каждый
+// узел дерева создаётся один раз, без спуска от корня для каждой клетки.
+// Клетка (row, col) узора попадает в клетку (x = col, y = row) поля.
+class QuadtreeSink {
+public:
+    using Node = HashLife::Node;
+
+    explicit QuadtreeSink(HashLife& life) : life_(life) {}
+
+    void begin(const PatternInfo&) {}
+
+    void run(std::int64_t row, std::int64_t col, std::int64_t len) {
+        std::int64_t band = floorDiv8(row);
+        if (!haveBand_ || band != band_) {
+            flushBand();
+            band_ = band;
+            haveBand_ = true;
+        }
+        const int r = static_cast<int>(row - band * 8);
+        for (std::int64_t c = col; c < col + len;) {
+            std::int64_t block = floorDiv8(c);
+            std::int64_t lo = c - block * 8;
+            std::int64_t hi = std::min<std::int64_t>(8, col + len - block * 8);
+            std::uint64_t bits = ((1ULL << hi) - 1) & ~((1ULL << lo) - 1);
+            blocks_[block] |= bits << (r * 8);
+            c = block * 8 + hi;
+        }
+    }
+
+    // Дописать незавершённые строки узлов в поле (вызвать после разбора)
+    void finish() {
+        flushBand();
+        for (std::size_t i = 0; i < pending_.size(); i++) {
+            if (!has_[i]) continue;
+            has_[i] = false;
+            const int level = static_cast<int>(i) + 3;
+            const std::int64_t size = std::int64_t(1) << level;
+            for (const auto& xn : pending_[i].nodes) {
+                life_.setBlock(xn.second, xn.first * size, pending_[i].y * size);
+            }
+            pending_[i].nodes.clear();
+        }
+    }
+
+private:
+    // Строка узлов одного уровня: номер строки y и пары (номер столбца, узел)
+    struct NodeRow {
+        std::int64_t y = 0;
+        std::vector<std::pair<std::int64_t, const Node*>> nodes;
+    };
+
+    static std::int64_t floorDiv8(std::int64_t v) { return v >= 0 ? v / 8 : -((-v + 7) / 8); }
+    static std::int64_t floorHalf(std::int64_t v) { return v >= 0 ? v / 2 : -((-v + 1) / 2); }
+
+    // Узел уровня 3 из 64 бит (бит r*8 + c — клетка строки r, столбца c):
+    // четыре узла 4x4 из таблицы по 16-битному рисунку и одно соединение
+    const Node* leafNode(std::uint64_t bits) {
+        if (bits == 0) return life_.empty(3);
+        const Node* q[4];
+        for (int i = 0; i < 4; i++) {
+            int r = (i >> 1) * 4, c = (i & 1) * 4;
+            unsigned pattern = 0;
+            for (int y = 0; y < 4; y++) pattern |= ((bits >> ((r + y) * 8 + c)) & 0xfu) << (y * 4);
+            q[i] = quad4(pattern);
+        }
+        return life_.makeNode(q[0], q[1], q[2], q[3]);
+    }
+
+    // Узел 4x4 по рисунку (бит y*4 + x), создаётся один раз
+    const Node* quad4(unsigned pattern) {
+        if (quad4_.empty()) quad4_.assign(1 << 16, nullptr);
+        const Node*& n = quad4_[pattern];
+        if (!n) {
+            const Node* q2[4];
+            for (int i = 0; i < 4; i++) {
+                int r = (i >> 1) * 2, c = (i & 1) * 2;
+                auto cell = [&](int y, int x) { return life_.leaf((pattern >> (y * 4 + x)) & 1u); };
+                q2[i] = life_.makeNode(cell(r, c), cell(r, c + 1), cell(r + 1, c), cell(r + 1, c + 1));
+            }
+            n = life_.makeNode(q2[0], q2[1], q2[2], q2[3]);
+        }
+        return n;
+    }
+
+    void flushBand() {
+        if (!haveBand_ || blocks_.empty()) return;
+        NodeRow row;
+        row.y = band_;
+        row.nodes.reserve(blocks_.size());
+        for (const auto& kv : blocks_) row.nodes.emplace_back(kv.first, leafNode(kv.second));
+        std::sort(row.nodes.begin(), row.nodes.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        blocks_.clear();
+        push(0, std::move(row));
+    }
+
+    // Строка узлов уровня i+3; строки приходят с растущим y
+    void push(std::size_t i, NodeRow row) {
+        if (pending_.size() <= i) {
+            pending_.resize(i + 1);
+            has_.resize(i + 1, false);
+        }
+        if (has_[i]) {
+            has_[i] = false;
+            NodeRow top = std::move(pending_[i]);
+            pending_[i].nodes.clear();
+            if (floorHalf(top.y) == floorHalf(row.y) && top.y + 1 == row.y) {
+                push(i + 1, combine(i, &top, &row));
+                return;
+            }
+            push(i + 1, combine(i, &top, nullptr));
+        }
+        if (floorHalf(row.y) * 2 != row.y) {
+            push(i + 1, combine(i, nullptr, &row));
+        } else {
+            pending_[i] = std::move(row);
+            has_[i] = true;
+        }
+    }
+
+    // Слить верхнюю (чётный y) и нижнюю строки уровня i+3 в строку уровня i+4
+    NodeRow combine(std::size_t i, const NodeRow* top, const NodeRow* bottom) {
+        const int level = static_cast<int>(i) + 3;
+        const Node* e = life_.empty(level);
+        NodeRow out;
+        out.y = floorHalf(top ? top->y : bottom->y);
+        std::size_t a = 0, b = 0;
+        const std::size_t na = top ? top->nodes.size() : 0;
+        const std::size_t nb = bottom ? bottom->nodes.size() : 0;
+        while (a < na || b < nb) {
+            std::int64_t xa = a < na ? floorHalf(top->nodes[a].first) : INT64_MAX;
+            std::int64_t xb = b < nb ? floorHalf(bottom->nodes[b].first) : INT64_MAX;
+            std::int64_t x = std::min(xa, xb);
+            const Node* q[4] = {e, e, e, e};
+            while (a < na && floorHalf(top->nodes[a].first) == x) {
+                q[top->nodes[a].first - 2 * x] = top->nodes[a].second;
+                a++;
+            }
+            while (b < nb && floorHalf(bottom->nodes[b].first) == x) {
+                q[2 + bottom->nodes[b].first - 2 * x] = bottom->nodes[b].second;
+                b++;
+            }
+            out.nodes.emplace_back(x, life_.makeNode(q[0], q[1], q[2], q[3]));
+        }
+        return out;
+    }
+
+    HashLife& life_;
+    std::unordered_map<std::int64_t, std::uint64_t> blocks_;  // столбец блока -> биты 8x8
+    std::int64_t band_ = 0;
+    bool haveBand_ = false;
+    std::vector<NodeRow> pending_;  // по уровню: строка, ждущая пары
+    std::vector<bool> has_;
+    std::vector<const Node*> quad4_;
+};
+
+// --------------------------------------------------------------
+// РАЗБОР
+// --------------------------------------------------------------
+
+// RLE: необязательные строки "#...", заголовок "x = W, y = H, rule = R",
+// затем отрезки "<n>b" (мёртвые), "<n>o" (живые), "<n>$" (конец строки), "!"
+template <class Sink>
+bool parseRle(std::istream& stream, Sink& sink, PatternInfo& info, std::string& error) {
+    PatternInput in(stream);
+    std::string line;
+    info = PatternInfo();
+
+    // Комментарии и заголовок
+    for (;;) {
+        int ch = in.peek();
+        while (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+            in.get();
+            ch = in.peek();
+        }
+        if (ch == '#') {
+            in.skipLine();
+            continue;
+        }
+        if (ch == 'x' || ch == 'X') {
+            in.readLine(line);
+            // Пары "ключ = значение" через запятую
+            std::size_t pos = 0;
+            while (pos < line.size()) {
+                std::size_t comma = line.find(',', pos);
+                if (comma == std::string::npos) comma = line.size();
+                std::string item = line.substr(pos, comma - pos);
+                pos = comma + 1;
+                std::size_t eq = item.find('=');
+                if (eq == std::string::npos) continue;
+                auto trim = [](std::string s) {
+                    std::size_t b = s.find_first_not_of(" \t");
+                    std::size_t e = s.find_last_not_of(" \t");
+                    return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+                };
+                std::string key = trim(item.substr(0, eq));
+                std::string value = trim(item.substr(eq + 1));
+                if (key == "x" || key == "X") {
+                    info.width = std::strtoll(value.c_str(), nullptr, 10);
+                } else if (key == "y" || key == "Y") {
+                    info.height = std::strtoll(value.c_str(), nullptr, 10);
+                } else if (key == "rule") {
+                    if (!parseRule(value, info.rule)) {
+                        error = patternError(in, "неподдерживаемое правило " + value);
+                        return false;
+                    }
+                    info.hasRule = true;
+                }
+            }
+        }
+        break;
+    }
+    sink.begin(info);
+
+    std::int64_t row = 0, col = 0, count = 0;
+    for (;;) {
+        int ch = in.get();
+        if (ch == EOF || ch == '!') break;
+        if (ch >= '0' && ch <= '9') {
+            count = count * 10 + (ch - '0');
+            if (count > (std::int64_t(1) << 40)) {
+                error = patternError(in, "слишком длинный отрезок");
+                return false;
+            }
+            continue;
+        }
+        std::int64_t n = count > 0 ? count : 1;
+        switch (ch) {
+        case 'b':
+        case '.':
+            col += n;
+            break;
+        case 'o':
+        case 'A':
+            sink.run(row, col, n);
+            col += n;
+            break;
+        case '$':
+            row += n;
+            col = 0;
+            break;
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            if (count > 0) {
+                error = patternError(in, "число повторов без символа клетки");
+                return false;
+            }
+            break;
+        default:
+            error = patternError(in, std::string("неожиданный символ '") + static_cast<char>(ch) + "'");
+            return false;
+        }
+        count = 0;
+    }
+    return true;
+}
+
+// Plaintext: строки "!..." — комментарии, '.' — мёртвая клетка, 'O' или '*' — живая.
+// Размер узора (по самой длинной строке) известен только после разбора.
+template <class Sink>
+bool parseCells(std::istream& stream, Sink& sink, PatternInfo& info, std::string& error) {
+    PatternInput in(stream);
+    info = PatternInfo();
+    sink.begin(info);
+
+    std::int64_t row = 0, col = 0, runStart = -1;
+    bool lineStart = true;
+    for (;;) {
+        int ch = in.get();
+        if (lineStart && ch == '!') {
+            in.skipLine();
+            continue;
+        }
+        lineStart = false;
+        if (ch == 'O' || ch == '*') {
+            if (runStart < 0) runStart = col;
+            col++;
+            continue;
+        }
+        if (runStart >= 0) {
+            sink.run(row, runStart, col - runStart);
+            runStart = -1;
+        }
+        if (ch == EOF) break;
+        switch (ch) {
+        case '.':
+            col++;
+            break;
+        case '\n':
+            row++;
+            col = 0;
+            lineStart = true;
+            break;
+        case '\r':
+        case ' ':
+        case '\t':
+            break;
+        default:
+            error = patternError(in, std::string("неожиданный символ '") + static_cast<char>(ch) + "'");
+            return false;
+        }
+        info.width = std::max(info.width, col);
+        info.height = std::max(info.height, row + (col > 0 ? 1 : 0));
+    }
+    return true;
+}
+
+// Macrocell: "[M2] ...", "#R правило", листья 8x8 строками ".*$" и узлы
+// "уровень nw ne sw se" (номера предыдущих строк с единицы, 0 — пустой
+// узел). Корень — последний узел; он заменяет поле life, центрированный.
+// useFileRule: правило из "#R" применяется к life (поле при этом очищается).
+inline bool parseMacrocell(std::istream& stream, HashLife& life, bool useFileRule, PatternInfo& info,
+                           std::string& error) {
+    using Node = HashLife::Node;
+    PatternInput in(stream);
+    std::string line;
+    info = PatternInfo();
+
+    if (!in.readLine(line) || line.compare(0, 4, "[M2]") != 0) {
+        error = "это не файл Macrocell (нет заголовка [M2])";
+        return false;
+    }
+    std::vector<const Node*> nodes;
+    nodes.push_back(nullptr);  // номер 0 — пустой узел
+    while (in.readLine(line)) {
+        if (line.empty()) continue;
+        if (line[0] == '#') {
+            if (line.size() > 1 && line[1] == 'R') {
+                std::size_t b = line.find_first_not_of(" \t", 2);
+                std::string text = b == std::string::npos ? std::string() : line.substr(b);
+                if (!parseRule(text, info.rule)) {
+                    error = patternError(in, "неподдерживаемое правило " + text);
+                    return false;
+                }
+                info.hasRule = true;
+                if (useFileRule && info.rule != life.rule()) {
+                    if (nodes.size() > 1 || !life.setRule(info.rule)) {
+                        error = patternError(in, "правило " + info.rule.toString() + " недоступно для HashLife");
+                        return false;
+                    }
+                }
+            }
+            continue;
+        }
+        if (line[0] == '.' || line[0] == '*' || line[0] == '$') {
+            // Лист 8x8: строки через '$', хвостовые мёртвые клетки опущены
+            std::uint64_t bits = 0;
+            int r = 0, c = 0;
+            for (char ch : line) {
+                if (ch == '$') {
+                    r++;
+                    c = 0;
+                } else if (ch == '.' || ch == '*') {
+                    if (r >= 8 || c >= 8) {
+                        error = patternError(in, "лист больше 8x8");
+                        return false;
+                    }
+                    if (ch == '*') bits |= 1ULL << (r * 8 + c);
+                    c++;
+                } else if (ch != ' ') {
+                    error = patternError(in, "неверная строка листа");
+                    return false;
+                }
+            }
+            const Node* q[8][8];
+            for (int y = 0; y < 8; y++) {
+                for (int x = 0; x < 8; x++) q[y][x] = life.leaf((bits >> (y * 8 + x)) & 1u);
+            }
+            // 8x8 -> 4x4 -> 2x2 -> 1
+            for (int size = 8; size > 1; size /= 2) {
+                for (int y = 0; y < size / 2; y++) {
+                    for (int x = 0; x < size / 2; x++) {
+                        q[y][x] = life.makeNode(q[2 * y][2 * x], q[2 * y][2 * x + 1],
+                                                q[2 * y + 1][2 * x], q[2 * y + 1][2 * x + 1]);
+                    }
+                }
+            }
+            nodes.push_back(q[0][0]);
+            continue;
+        }
+        // Узел: уровень и четыре номера
+        const char* p = line.c_str();
+        char* end;
+        long long v[5];
+        for (int i = 0; i < 5; i++) {
+            v[i] = std::strtoll(p, &end, 10);
+            if (end == p) {
+                error = patternError(in, "неверная строка узла");
+                return false;
+            }
+            p = end;
+        }
+        const int level = static_cast<int>(v[0]);
+        if (level < 4 || level > 62) {
+            error = patternError(in, "неподдерживаемый уровень узла " + std::to_string(level));
+            return false;
+        }
+        const Node* child[4];
+        for (int i = 0; i < 4; i++) {
+            if (v[i + 1] < 0 || static_cast<std::size_t>(v[i + 1]) >= nodes.size()) {
+                error = patternError(in, "узел ссылается на неизвестный узел");
+                return false;
+            }
+            child[i] = v[i + 1] == 0 ? life.empty(level - 1) : nodes[static_cast<std::size_t>(v[i + 1])];
+            if (child[i]->level != level - 1) {
+                error = patternError(in, "уровень потомка не совпадает с уровнем узла");
+                return false;
+            }
+        }
+        nodes.push_back(life.makeNode(child[0], child[1], child[2], child[3]));
+    }
+
+    // Центрированный корень не выровнен по своему размеру, поэтому он
+    // становится корнем поля целиком, а не ставится через setBlock
+    if (nodes.size() > 1) life.setRoot(nodes.back(), life.generation());
+    return true;
+}
+
+// --------------------------------------------------------------
+// ЗАПИСЬ
+// --------------------------------------------------------------
+
+// RLE: отрезки подаются по строкам сверху вниз, координаты — от левого
+// верхнего угла узора. Строки файла не длиннее 70 символов.
+class RleWriter {
+public:
+    RleWriter(std::ostream& out, std::int64_t width, std::int64_t height, const Rule& rule) : out_(out) {
+        out_ << "x = " << width << ", y = " << height << ", rule = " << rule.toString() << "\n";
+    }
+
+    void run(std::int64_t row, std::int64_t col, std::int64_t len) {
+        if (row > row_) {
+            token(row - row_, '$');
+            row_ = row;
+            col_ = 0;
+        }
+        if (col > col_) token(col - col_, 'b');
+        token(len, 'o');
+        col_ = col + len;
+    }
+
+    void finish() {
+        token(1, '!');
+        out_ << "\n";
+    }
+
+private:
+    void token(std::int64_t n, char tag) {
+        char text[24];
+        int len = n > 1 ? std::snprintf(text, sizeof(text), "%lld%c", static_cast<long long>(n), tag)
+                        : std::snprintf(text, sizeof(text), "%c", tag);
+        if (lineLength_ + len > 70) {
+            out_ << "\n";
+            lineLength_ = 0;
+        }
+        out_ << text;
+        lineLength_ += len;
+    }
+
+    std::ostream& out_;
+    std::int64_t row_ = 0, col_ = 0;
+    int lineLength_ = 0;
+};
+
+// Plaintext: пустая строка поля записывается как "."
+class CellsWriter {
+public:
+    explicit CellsWriter(std::ostream& out, const std::string& name = "") : out_(out) {
+        if (!name.empty()) out_ << "!Name: " << name << "\n";
+    }
+
+    void run(std::int64_t row, std::int64_t col, std::int64_t len) {
+        for (; row_ < row; row_++) {
+            out_ << (col_ == 0 ? ".\n" : "\n");
+            col_ = 0;
+        }
+        out_ << std::string(static_cast<std::size_t>(col - col_), '.')
+             << std::string(static_cast<std::size_t>(len), 'O');
+        col_ = col + len;
+    }
+
+    void finish() {
+        if (col_ > 0) out_ << "\n";
+    }
+
+private:
+    std::ostream& out_;
+    std::int64_t row_ = 0, col_ = 0;
+};
+
+// Отрезки живых клеток плотной сетки по строкам: fn(row, col, len)
+template <class Fn>
+void forEachRunDense(const BitGrid& g, Fn&& fn) {
+    const int words = g.wordsPerRow();
+    const std::uint64_t lastMask = g.lastWordMask();
+    for (int r = 0; r < g.rows(); r++) {
+        const std::uint64_t* p = g.row(r);
+        std::int64_t start = -1, end = -1;  // незакрытый отрезок, может продолжиться в следующем слове
+        for (int w = 0; w < words; w++) {
+            std::uint64_t v = p[w] & (w == words - 1 ? lastMask : ~0ULL);
+            while (v) {
+                int lo = __builtin_ctzll(v);
+                std::uint64_t rest = ~(v >> lo);
+                int n = rest == 0 ? 64 - lo : std::min(__builtin_ctzll(rest), 64 - lo);
+                std::int64_t s = std::int64_t(w) * 64 + lo;
+                if (s == end) {
+                    end += n;
+                } else {
+                    if (start >= 0) fn(std::int64_t(r), start, end - start);
+                    start = s;
+                    end = s + n;
+                }
+                v = (lo + n >= 64) ? 0 : (v & ~(((1ULL << (lo + n)) - 1)));
+            }
+        }
+        if (start >= 0) fn(std::int64_t(r), start, end - start);
+    }
+}
+
+// Отрезки по отсортированным ключам клеток (sortCellKeys)
+template <class It, class Fn>
+void forEachRunSorted(It begin, It end, Fn&& fn) {
+    while (begin != end) {
+        CellKey first = *begin;
+        std::int64_t len = 1;
+        for (++begin; begin != end && *begin == first + static_cast<CellKey>(len) &&
+                      cellRow(*begin) == cellRow(first);
+             ++begin) {
+            len++;
+        }
+        fn(std::int64_t(cellRow(first)), std::int64_t(cellCol(first)), len);
+    }
+}
+
+// Macrocell: узлы в порядке обхода снизу вверх, каждый один раз
+inline void writeMacrocell(std::ostream& out, const HashLife& life) {
+    using Node = HashLife::Node;
+    out << "[M2] (memoiza)\n#R " << life.rule().toString() << "\n";
+    if (life.population() == 0) return;
+
+    std::unordered_map<const Node*, std::uint64_t> ids;
+    std::uint64_t next = 1;
+    // Биты листа 8x8: бит r*8 + c
+    auto leafBits = [](const Node* n) {
+        std::uint64_t bits = 0;
+        auto rec = [&bits](auto& self, const Node* q, int r, int c) -> void {
+            if (q->population == 0) return;
+            if (q->level == 0) {
+                bits |= 1ULL << (r * 8 + c);
+                return;
+            }
+            int h = 1 << (q->level - 1);
+            self(self, q->nw, r, c);
+            self(self, q->ne, r, c + h);
+            self(self, q->sw, r + h, c);
+            self(self, q->se, r + h, c + h);
+        };
+        rec(rec, n, 0, 0);
+        return bits;
+    };
+    auto write = [&](auto& self, const Node* n) -> std::uint64_t {
+        if (n->population == 0) return 0;
+        auto it = ids.find(n);
+        if (it != ids.end()) return it->second;
+        if (n->level == 3) {
+            std::uint64_t bits = leafBits(n);
+            std::string text;
+            for (int r = 0; r < 8; r++) {
+                std::uint64_t rowBits = (bits >> (r * 8)) & 0xff;
+                if ((bits >> (r * 8)) == 0) break;  // остальные строки пусты
+                for (int c = 0; c < 8 && (rowBits >> c); c++) text += ((rowBits >> c) & 1u) ? '*' : '.';
+                text += '$';
+            }
+            out << text << "\n";
+        } else {
+            std::uint64_t a = self(self, n->nw);
+            std::uint64_t b = self(self, n->ne);
+            std::uint64_t c = self(self, n->sw);
+            std::uint64_t d = self(self, n->se);
+            out << n->level << " " << a << " " << b << " " << c << " " << d << "\n";
+        }
+        ids[n] = next;
+        return next++;
+    };
+    write(write, life.root());
+}
+
+// --------------------------------------------------------------
+// ФАЙЛЫ
+// --------------------------------------------------------------
+
+// Формат по расширению, иначе по первой значимой строке
+inline PatternFormat detectPatternFormat(const std::string& path) {
+    auto endsWith = [&path](const char* ext) {
+        std::string e = ext;
+        if (path.size() < e.size()) return false;
+        for (std::size_t i = 0; i < e.size(); i++) {
+            char ch = path[path.size() - e.size() + i];
+            if (ch >= 'A' && ch <= 'Z') ch = static_cast<char>(ch - 'A' + 'a');
+            if (ch != e[i]) return false;
+        }
+        return true;
+    };
+    if (endsWith(".rle")) return PatternFormat::Rle;
+    if (endsWith(".cells")) return PatternFormat::Cells;
+    if (endsWith(".mc")) return PatternFormat::Macrocell;
+
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line == "\r") continue;
+        if (line.compare(0, 4, "[M2]") == 0) return PatternFormat::Macrocell;
+        if (line[0] == '!' || line[0] == '.' || line[0] == 'O') return PatternFormat::Cells;
+        if (line[0] == '#' || line[0] == 'x') return PatternFormat::Rle;
+        break;
+    }
+    return PatternFormat::Unknown;
+}
+
+// Прочитать узор в приёмник. Узор Macrocell сначала строится в HashLife,
+// затем сдвигается так, чтобы левый верхний угол живых клеток был (0, 0),
+// и отдаётся клетками в произвольном порядке.
+template <class Sink>
+bool readPattern(const std::string& path, Sink& sink, PatternInfo& info, std::string& error) {
+    PatternFormat format = detectPatternFormat(path);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "невозможно открыть файл " + path;
+        return false;
+    }
+    switch (format) {
+    case PatternFormat::Rle:
+        return parseRle(in, sink, info, error);
+    case PatternFormat::Cells:
+        return parseCells(in, sink, info, error);
+    case PatternFormat::Macrocell: {
+        HashLife life;
+        if (!parseMacrocell(in, life, false, info, error)) return false;
+        std::int64_t minX = INT64_MAX, minY = INT64_MAX, maxX = INT64_MIN, maxY = INT64_MIN;
+        life.forEachLive([&](std::int64_t x, std::int64_t y) {
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        });
+        if (life.population() > 0) {
+            info.width = maxX - minX + 1;
+            info.height = maxY - minY + 1;
+        }
+        sink.begin(info);
+        life.forEachLive([&](std::int64_t x, std::int64_t y) { sink.run(y - minY, x - minX, 1); });
+        return true;
+    }
+    case PatternFormat::Unknown:
+        break;
+    }
+    error = "неизвестный формат узора: " + path;
+    return false;
+}
+
+// Прочитать узор прямо в квадродерево. useFileRule — см. parseMacrocell;
+// для RLE правило из заголовка применяется так же, до первой клетки.
+inline bool readPattern(const std::string& path, HashLife& life, bool useFileRule, PatternInfo& info,
+                        std::string& error) {
+    PatternFormat format = detectPatternFormat(path);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "невозможно открыть файл " + path;
+        return false;
+    }
+    if (format == PatternFormat::Macrocell) return parseMacrocell(in, life, useFileRule, info, error);
+    if (format == PatternFormat::Unknown) {
+        error = "неизвестный формат узора: " + path;
+        return false;
+    }
+
+    // Правило применяется в begin(): после заголовка, до первой клетки
+    struct RuleSink : QuadtreeSink {
+        RuleSink(HashLife& l, bool use) : QuadtreeSink(l), life(l), useRule(use) {}
+        void begin(const PatternInfo& i) {
+            if (useRule && i.hasRule && i.rule != life.rule() && !life.setRule(i.rule)) badRule = true;
+        }
+        HashLife& life;
+        bool useRule;
+        bool badRule = false;
+    } sink(life, useFileRule);
+    bool ok = format == PatternFormat::Rle ? parseRle(in, sink, info, error) : parseCells(in, sink, info, error);
+    if (ok && sink.badRule) {
+        error = "правило " + info.rule.toString() + " недоступно для HashLife";
+        return false;
+    }
+    sink.finish();
+    return ok;
+}
+
+} // namespace memoiza
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "bit_grid.hpp"
+
+// --------------------------------------------------------------
+// ТЕРМИНАЛЬНЫЙ ВЫВОД: РАЗНОСТНЫЕ КАДРЫ С ОГРАНИЧЕНИЕМ ЧАСТОТЫ
+// --------------------------------------------------------------
+//
+// Кадр — поле, уменьшенное до размера окна: клетка экрана покрывает
+// квадрат s x s клеток поля и рисуется символом по доле живых в нём.
+// Экран перерисуется не целиком: выводятся только изменившиеся клетки
+// экрана (переход курсора и символ), весь кадр собирается в одну строку
+// и пишется одним вызовом. Фоновый поток рисует кадры с заданной
+// частотой; симуляция не ждёт вывода, а только публикует состояние,
+// когда поток вывода готов взять новое (одна атомарная проверка на шаг).
+
+namespace memoiza {
+
+// Размер терминала в символах; false — вывод не в терминал
+inline bool terminalSize(int& rows, int& cols) {
+    winsize ws{};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0 || ws.ws_row == 0 || ws.ws_col == 0) return false;
+    rows = ws.ws_row;
+    cols = ws.ws_col;
+    return true;
+}
+
+class TerminalRenderer {
+public:
+    // viewRows x viewCols — клеток экрана (каждая шириной в два символа)
+    TerminalRenderer(std::ostream& out, int viewRows, int viewCols)
+        : out_(out), viewRows_(std::max(1, viewRows)), viewCols_(std::max(1, viewCols)) {}
+
+    ~TerminalRenderer() { stop(); }
+
+    TerminalRenderer(const TerminalRenderer&) = delete;
+    TerminalRenderer& operator=(const TerminalRenderer&) = delete;
+
+    // Нарисовать кадр сейчас; full — очистить экран и вывести кадр целиком
+    // (нужно, если после прошлого кадра в терминал писали что-то ещё)
+    void draw(const BitGrid& g, long long iteration, bool full = false) {
+        std::lock_guard<std::mutex> lock(drawMutex_);
+        render(g, iteration, full);
+    }
+
+    // Запустить поток вывода: не больше fps кадров в секунду
+    void start(int fps) {
+        if (running_.load() || fps <= 0) return;
+        interval_ = std::chrono::microseconds(1000000 / fps);
+        wanted_.store(true);
+        ready_ = false;
+        running_.store(true);
+        thread_ = std::thread([this] { loop(); });
+    }
+
+    // Остановить поток вывода (кадр, ожидающий вывода, отбрасывается)
+    void stop() {
+        if (!running_.exchange(false)) return;
+        thread_.join();
+        wanted_.store(false);
+    }
+
+    // Вызывается симуляцией на каждом шаге: состояние копируется, только
+    // если поток вывода ждёт новый кадр, иначе — одна атомарная загрузка
+    void publish(const BitGrid& g, long long iteration) {
+        if (!wanted_.load(std::memory_order_acquire)) return;
+        std::lock_guard<std::mutex> lock(frameMutex_);
+        pending_ = g;  // память буфера переиспользуется
+        pendingIter_ = iteration;
+        ready_ = true;
+        wanted_.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    void loop() {
+        auto next = std::chrono::steady_clock::now();
+        while (running_.load()) {
+            next += interval_;
+            std::this_thread::sleep_until(next);
+            long long iteration;
+            {
+                std::lock_guard<std::mutex> lock(frameMutex_);
+                if (!ready_) continue;
+                std::swap(pending_, shown_);
+                iteration = pendingIter_;
+                ready_ = false;
+            }
+            wanted_.store(true, std::memory_order_release);
+            draw(shown_, iteration);
+        }
+    }
+
+    // Живых клеток в столбцах [c0, c1) строки
+    static int countRange(const std::uint64_t* p, int c0, int c1) {
+        int count = 0;
+        for (int w = c0 >> 6; w <= (c1 - 1) >> 6; w++) {
+            int lo = std::max(c0, w << 6) - (w << 6);
+            int hi = std::min(c1, (w + 1) << 6) - (w << 6);
+            std::uint64_t mask = (hi == 64 ? ~0ULL : (1ULL << hi) - 1) & ~((1ULL << lo) - 1);
+            count += __builtin_popcountll(p[w] & mask);
+        }
+        return count;
+    }
+
+    void moveTo(int row, int col) {
+        buf_ += "\033[";
+        buf_ += std::to_string(row);
+        buf_ += ';';
+        buf_ += std::to_string(col);
+        buf_ += 'H';
+    }
+
+    void render(const BitGrid& g, long long iteration, bool full) {
+        // Масштаб: одна клетка экрана на квадрат scale x scale клеток поля
+        const int scale = std::max({1, (g.rows() + viewRows_ - 1) / viewRows_, (g.cols() + viewCols_ - 1) / viewCols_});
+        const int rows = (g.rows() + scale - 1) / scale;
+        const int cols = (g.cols() + scale - 1) / scale;
+
+        // Уровень клетки экрана: 0 — пусто, 4 — все клетки квадрата живы
+        frame_.assign(static_cast<std::size_t>(rows) * cols, 0);
+        std::vector<int>& counts = counts_;
+        for (int vr = 0; vr < rows; vr++) {
+            counts.assign(cols, 0);
+            const int r1 = std::min(g.rows(), (vr + 1) * scale);
+            for (int r = vr * scale; r < r1; r++) {
+                const std::uint64_t* p = g.row(r);
+                for (int vc = 0; vc < cols; vc++) {
+                    counts[vc] += countRange(p, vc * scale, std::min(g.cols(), (vc + 1) * scale));
+                }
+            }
+            for (int vc = 0; vc < cols; vc++) {
+                int n = counts[vc];
+                frame_[static_cast<std::size_t>(vr) * cols + vc] =
+                    static_cast<std::uint8_t>(n == 0 ? 0 : std::min(4, 1 + n * 4 / (scale * scale)));
+            }
+        }
+
+        full = full || rows != shownRows_ || cols != shownCols_ || scale != shownScale_;
+        buf_.clear();
+        if (full) buf_ += "\033[2J";
+        moveTo(1, 1);
+        buf_ += "Итерация: " + std::to_string(iteration);
+        if (scale > 1) buf_ += " (масштаб 1:" + std::to_string(scale) + ")";
+        buf_ += "\033[K\033[32m";
+
+        static const char* const GLYPHS[5] = {"  ", "░░", "▒▒", "▓▓", "██"};
+        for (int vr = 0; vr < rows; vr++) {
+            int cursor = -1;  // столбец, куда курсор встанет без перехода
+            for (int vc = 0; vc < cols; vc++) {
+                std::size_t i = static_cast<std::size_t>(vr) * cols + vc;
+                if (!full && frame_[i] == shownFrame_[i]) continue;
+                if (cursor != vc) moveTo(vr + 2, vc * 2 + 1);
+                buf_ += GLYPHS[frame_[i]];
+                cursor = vc + 1;
+            }
+        }
+        buf_ += "\033[0m";
+        if (full) {
+            moveTo(rows + 2, 1);
+            buf_ += std::string(static_cast<std::size_t>(cols) * 2, '-');
+        }
+        // Курсор под кадр: следующий текст программы пойдёт ниже поля
+        moveTo(rows + 3, 1);
+
+        out_.write(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+        out_.flush();
+        shownFrame_.swap(frame_);
+        shownRows_ = rows;
+        shownCols_ = cols;
+        shownScale_ = scale;
+    }
+
+    std::ostream& out_;
+    const int viewRows_, viewCols_;
+
+    std::mutex drawMutex_;  // кадр рисует один поток за раз
+    std::string buf_;
+    std::vector<std::uint8_t> frame_, shownFrame_;
+    std::vector<int> counts_;
+    int shownRows_ = -1, shownCols_ = -1, shownScale_ = 0;
+
+    std::mutex frameMutex_;  // pending_ и ready_
+    BitGrid pending_, shown_;
+    long long pendingIter_ = 0;
+    bool ready_ = false;
+    std::atomic<bool> wanted_{false};
+    std::atomic<bool> running_{false};
+    std::chrono::microseconds interval_{100000};
+    std::thread thread_;
+};
+
+} // namespace memoiza
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "bit_grid.hpp"
+
+// --------------------------------------------------------------
+// ПРАВИЛА ВИДА B/S (LIFE-LIKE)
+// --------------------------------------------------------------
+//
+// Правило — таблица на 9 значений числа соседей: бит n маски birth
+// означает рождение мёртвой клетки при n живых соседях, бит n маски
+// survive — выживание живой. Строка правила разбирается один раз при
+// запуске. Для плотной сетки соседи считаются побитово (четыре разряда
+// числа соседей для 64 клеток сразу), а распространённые правила
+// получают ядра, где таблица — параметр шаблона: проверка правила
+// сворачивается компилятором в несколько логических операций.
+
+namespace memoiza {
+
+struct Rule {
+    std::uint16_t birth = 1u << 3;
+    std::uint16_t survive = (1u << 2) | (1u << 3);
+
+    // Следующее состояние клетки по числу живых соседей (0..8)
+    bool next(bool alive, int neighbors) const {
+        return ((alive ? survive : birth) >> neighbors) & 1u;
+    }
+
+    constexpr bool operator==(const Rule& o) const { return birth == o.birth && survive == o.survive; }
+    constexpr bool operator!=(const Rule& o) const { return !(*this == o); }
+
+    // Запись вида "B36/S23"
+    std::string toString() const {
+        std::string s = "B";
+        for (int n = 0; n <= 8; n++) {
+            if ((birth >> n) & 1u) s += static_cast<char>('0' + n);
+        }
+        s += "/S";
+        for (int n = 0; n <= 8; n++) {
+            if ((survive >> n) & 1u) s += static_cast<char>('0' + n);
+        }
+        return s;
+    }
+};
+
+// Известные правила
+static constexpr Rule CONWAY_RULE{0x008, 0x00C};         // B3/S23
+static constexpr Rule HIGHLIFE_RULE{0x048, 0x00C};       // B36/S23
+static constexpr Rule DAY_AND_NIGHT_RULE{0x1C8, 0x1D8};  // B3678/S34678
+static constexpr Rule SEEDS_RULE{0x004, 0x000};          // B2/S
+
+// Разобрать правило: "B3/S23" (регистр не важен), классическую запись
+// "23/3" (сначала выживание) или имя: life, highlife, daynight, seeds.
+// false — строка не является правилом.
+inline bool parseRule(const std::string& text, Rule& rule) {
+    std::string s;
+    for (char ch : text) s += static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    if (s == "life" || s == "conway") {
+        rule = CONWAY_RULE;
+        return true;
+    }
+    if (s == "highlife") {
+        rule = HIGHLIFE_RULE;
+        return true;
+    }
+    if (s == "daynight") {
+        rule = DAY_AND_NIGHT_RULE;
+        return true;
+    }
+    if (s == "seeds") {
+        rule = SEEDS_RULE;
+        return true;
+    }
+
+    std::size_t slash = s.find('/');
+    if (slash == std::string::npos) return false;
+    std::string left = s.substr(0, slash);
+    std::string right = s.substr(slash + 1);
+    // Классическая запись S/B: переставляем в B/S
+    bool classic = !left.empty() && left[0] != 'b' && left[0] != 's';
+    if (classic) {
+        left = "s" + left;
+        right = "b" + right;
+    }
+    if (left.empty() || right.empty()) return false;
+    if (left[0] == 's' && right[0] == 'b') std::swap(left, right);
+    if (left[0] != 'b' || right[0] != 's') return false;
+
+    auto digits = [](const std::string& part, std::uint16_t& mask) {
+        mask = 0;
+        for (std::size_t i = 1; i < part.size(); i++) {
+            if (part[i] < '0' || part[i] > '8') return false;
+            mask |= static_cast<std::uint16_t>(1u << (part[i] - '0'));
+        }
+        return true;
+    };
+    Rule parsed;
+    if (!digits(left, parsed.birth) || !digits(right, parsed.survive)) return false;
+    rule = parsed;
+    return true;
+}
+
+// --------------------------------------------------------------
+// ПОБИТОВОЕ ПРИМЕНЕНИЕ ПРАВИЛА
+// --------------------------------------------------------------
+
+// Число живых соседей 64 клеток в четырёх разрядах: n = n0 + 2n1 + 4n2 + 8n3
+struct CountPlanes {
+    std::uint64_t n0, n1, n2, n3;
+};
+
+inline CountPlanes countPlanes(std::uint64_t upL, std::uint64_t up, std::uint64_t upR,
+                               std::uint64_t midL, std::uint64_t mid, std::uint64_t midR,
+                               std::uint64_t downL, std::uint64_t down, std::uint64_t downR) {
+    std::uint64_t aW = (up << 1) | (upL >> 63);
+    std::uint64_t aE = (up >> 1) | (upR << 63);
+    std::uint64_t mW = (mid << 1) | (midL >> 63);
+    std::uint64_t mE = (mid >> 1) | (midR << 63);
+    std::uint64_t bW = (down << 1) | (downL >> 63);
+    std::uint64_t bE = (down >> 1) | (downR << 63);
+
+    // Суммы по строкам (как в lifeWord), затем сложение разрядов
+    std::uint64_t a0, a1, b0, b1;
+    fullAdd(aW, up, aE, a0, a1);
+    fullAdd(bW, down, bE, b0, b1);
+    std::uint64_t m0 = mW ^ mE;
+    std::uint64_t m1 = mW & mE;
+
+    CountPlanes p;
+    std::uint64_t c1;
+    fullAdd(a0, b0, m0, p.n0, c1);
+    // Двойки: a1 + b1 + m1 + c1 = t0 + c1 + 2*t1
+    std::uint64_t t0, t1;
+    fullAdd(a1, b1, m1, t0, t1);
+    p.n1 = t0 ^ c1;
+    std::uint64_t carry = t0 & c1;
+    p.n2 = t1 ^ carry;
+    p.n3 = t1 & carry;
+    return p;
+}
+
+// Клетки, у которых ровно n соседей
+inline std::uint64_t countEquals(const CountPlanes& p, int n) {
+    return ((n & 1) ? p.n0 : ~p.n0) & ((n & 2) ? p.n1 : ~p.n1) &
+           ((n & 4) ? p.n2 : ~p.n2) & ((n & 8) ? p.n3 : ~p.n3);
+}
+
+// Клетки, число соседей которых входит в маску Mask (известна при компиляции)
+template <std::uint16_t Mask, int... N>
+inline std::uint64_t countInMask(const CountPlanes& p, std::integer_sequence<int, N...>) {
+    return (0ULL | ... | (((Mask >> N) & 1u) ? countEquals(p, N) : 0ULL));
+}
+
+// Правило — параметр шаблона: лишние сравнения исчезают при компиляции
+template <std::uint16_t Birth, std::uint16_t Survive>
+struct FixedRuleWord {
+    static std::uint64_t apply(const Rule&, std::uint64_t upL, std::uint64_t up, std::uint64_t upR,
+                               std::uint64_t midL, std::uint64_t mid, std::uint64_t midR,
+                               std::uint64_t downL, std::uint64_t down, std::uint64_t downR) {
+        CountPlanes p = countPlanes(upL, up, upR, midL, mid, midR, downL, down, downR);
+        auto all = std::make_integer_sequence<int, 9>();
+        return (countInMask<Birth>(p, all) & ~mid) | (countInMask<Survive>(p, all) & mid);
+    }
+};
+
+// Conway: ручная формула lifeWord быстрее общей схемы
+struct ConwayWord {
+    static std::uint64_t apply(const Rule&, std::uint64_t upL, std::uint64_t up, std::uint64_t upR,
+                               std::uint64_t midL, std::uint64_t mid, std::uint64_t midR,
+                               std::uint64_t downL, std::uint64_t down, std::uint64_t downR) {
+        return lifeWord(upL, up, upR, midL, mid, midR, downL, down, downR);
+    }
+};
+
+// Произвольное правило: таблица читается во время выполнения
+struct TableRuleWord {
+    static std::uint64_t apply(const Rule& rule, std::uint64_t upL, std::uint64_t up, std::uint64_t upR,
+                               std::uint64_t midL, std::uint64_t mid, std::uint64_t midR,
+                               std::uint64_t downL, std::uint64_t down, std::uint64_t downR) {
+        CountPlanes p = countPlanes(upL, up, upR, midL, mid, midR, downL, down, downR);
+        std::uint64_t born = 0, kept = 0;
+        for (int n = 0; n <= 8; n++) {
+            std::uint64_t eq = countEquals(p, n);
+            if ((rule.birth >> n) & 1u) born |= eq;
+            if ((rule.survive >> n) & 1u) kept |= eq;
+        }
+        return (born & ~mid) | (kept & mid);
+    }
+};
+
+// Шаг прямоугольника: строки [rowBegin, rowEnd), слова [wordBegin, wordEnd).
+// Возвращает true, если хоть одна клетка изменилась.
+template <class WordRule>
+bool stepBlockWith(const Rule& rule, const BitGrid& src, BitGrid& dst,
+                   int rowBegin, int rowEnd, int wordBegin, int wordEnd) {
+    const int lastWord = src.wordsPerRow() - 1;
+    const std::uint64_t lastMask = src.lastWordMask();
+    std::uint64_t diff = 0;
+    for (int r = rowBegin; r < rowEnd; r++) {
+        const std::uint64_t* up = src.row(r - 1);
+        const std::uint64_t* mid = src.row(r);
+        const std::uint64_t* down = src.row(r + 1);
+        std::uint64_t* out = dst.row(r);
+        for (int w = wordBegin; w < wordEnd; w++) {
+            std::uint64_t v = WordRule::apply(rule, up[w - 1], up[w], up[w + 1],
+                                              mid[w - 1], mid[w], mid[w + 1],
+                                              down[w - 1], down[w], down[w + 1]);
+            // Биты за правым краем мертвы; бит заполнения (на торе он занят) не сравниваем
+            std::uint64_t mask = (w == lastWord) ? lastMask : ~0ULL;
+            v &= mask;
+            out[w] = v;
+            diff |= v ^ (mid[w] & mask);
+        }
+    }
+    return diff != 0;
+}
+
+} // namespace memoiza
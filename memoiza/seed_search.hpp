@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <random>
+#include <utility>
+
+#include "bit_grid.hpp"
+#include "cycle_detect.hpp"
+#include "edges.hpp"
+#include "step_kernels.hpp"
+#include "thread_pool.hpp"
+
+// --------------------------------------------------------------
+// ПАКЕТНЫЙ ПОИСК НАЧАЛЬНЫХ ПОЛЕЙ С ЦИКЛОМ ЗАДАННОЙ ДЛИНЫ
+// --------------------------------------------------------------
+//
+// Каждое начальное поле — случайная смесь клеток, полностью заданная
+// 64-битным зерном: поле i пакета с базовым зерном base получает зерно
+// soupSeed(base, i), и по нему же воспроизводится. Поля независимы,
+// поэтому пакет делится между потоками пула кусками; у каждого потока
+// свой генератор mt19937 и свои буферы, общего изменяемого состояния
+// нет, кроме счётчиков. Цикл ищется алгоритмом Брента; поле, которое
+// вымерло или разрослось сверх лимита, бросается сразу.
+
+namespace memoiza {
+
+struct SeedSearchOptions {
+    int rows = 20;
+    int cols = 20;
+    double density = 0.5;             // доля живых клеток в смеси
+    std::uint64_t baseSeed = 1;
+    std::uint64_t count = 1000;       // сколько полей перебрать
+    std::uint64_t maxIter = 2000;     // лимит шагов на поиск цикла
+    std::uint64_t targetLength = 10;  // нужная длина цикла
+    std::uint64_t maxPopulation = 0;  // 0 — без лимита
+    std::uint64_t maxHits = 0;        // 0 — перебрать весь пакет
+};
+
+// Чем закончился поиск цикла для одного поля
+enum class SeedOutcome { Cycle, DiedOut, Overflow, NoCycle };
+
+struct SeedResult {
+    std::uint64_t seed = 0;
+    SeedOutcome outcome = SeedOutcome::NoCycle;
+    std::uint64_t start = 0;       // начало цикла или итерация обрыва
+    std::uint64_t length = 0;
+    std::uint64_t population = 0;  // живых клеток в начальном поле
+};
+
+struct SeedSearchStats {
+    std::uint64_t tried = 0;
+    std::uint64_t hits = 0;
+    std::uint64_t cycles = 0;     // циклы другой длины
+    std::uint64_t diedOut = 0;
+    std::uint64_t overflowed = 0;
+    std::uint64_t noCycle = 0;
+};
+
+// Зерно поля index пакета base (splitmix64: соседние индексы дают
+// несвязанные зёрна)
+inline std::uint64_t soupSeed(std::uint64_t base, std::uint64_t index) {
+    std::uint64_t z = base + (index + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Заполнить поле смесью по зерну. Результат зависит только от зерна и
+// плотности: seed_seq и mt19937 определены стандартом побитово.
+inline void fillSoup(BitGrid& g, std::uint64_t seed, double density, std::mt19937& gen) {
+    std::seed_seq seq{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+    gen.seed(seq);
+    const std::uint64_t threshold = static_cast<std::uint64_t>(density * 4294967296.0);
+    g.clear();
+    for (int r = 0; r < g.rows(); r++) {
+        for (int c = 0; c < g.cols(); c++) {
+            if (gen() < threshold) g.set(r, c, true);
+        }
+    }
+}
+
+// Рабочие буферы одного потока
+struct SeedWorker {
+    std::mt19937 gen;
+    BitGrid soup;
+    BitGrid spare;
+};
+
+// Поиск цикла для поля с зерном seed в однопоточном режиме
+template <class Edges>
+SeedResult runSeed(const SeedSearchOptions& opt, std::uint64_t seed, SeedWorker& w) {
+    if (w.soup.rows() != opt.rows || w.soup.cols() != opt.cols) {
+        w.soup = BitGrid(opt.rows, opt.cols);
+        w.spare = BitGrid(opt.rows, opt.cols);
+    }
+    fillSoup(w.soup, seed, opt.density, w.gen);
+
+    SeedResult res;
+    res.seed = seed;
+    res.population = w.soup.population();
+    StepRowsFn kernel = ruleStepRows();
+    BitGrid& spare = w.spare;
+    bool died = false;
+    CycleInfo info = findCycleBrentUntil(
+        w.soup,
+        [&](BitGrid& g) {
+            Edges::prepare(g);
+            kernel(g, spare, 0, g.rows());
+            Edges::finish(g);
+            std::swap(g, spare);
+        },
+        [](const BitGrid& a, const BitGrid& b) { return a == b; },
+        [&](const BitGrid& g) {
+            std::uint64_t pop = g.population();
+            died = (pop == 0);
+            return died || (opt.maxPopulation != 0 && pop > opt.maxPopulation);
+        },
+        opt.maxIter);
+
+    if (info.found && res.population == 0) {
+        res.outcome = SeedOutcome::DiedOut;
+    } else if (info.found) {
+        res.outcome = SeedOutcome::Cycle;
+        res.start = info.start;
+        res.length = info.length;
+    } else if (info.stopped) {
+        res.outcome = died ? SeedOutcome::DiedOut : SeedOutcome::Overflow;
+        res.start = info.steps;
+    }
+    return res;
+}
+
+// Перебрать пакет в пуле. onHit(const SeedResult&) вызывается сразу
+// при каждой находке (под мьютексом, из любого потока); при maxHits
+// остальные поля пропускаются, как только находок достаточно.
+template <class Edges, class OnHit>
+SeedSearchStats searchSeeds(const SeedSearchOptions& opt, ThreadPool& pool, OnHit&& onHit) {
+    std::atomic<std::uint64_t> tried{0}, hits{0}, cycles{0}, died{0}, overflowed{0}, noCycle{0};
+    std::atomic<bool> done{false};
+    std::mutex hitMutex;
+
+    // Куски по 64 поля: накладные расходы пула малы, баланс хороший
+    pool.parallelFor(0, opt.count, 64, [&](std::size_t lo, std::size_t hi) {
+        SeedWorker w;
+        for (std::size_t i = lo; i < hi && !done.load(std::memory_order_relaxed); i++) {
+            SeedResult res = runSeed<Edges>(opt, soupSeed(opt.baseSeed, i), w);
+            tried.fetch_add(1, std::memory_order_relaxed);
+            switch (res.outcome) {
+            case SeedOutcome::Cycle:
+                if (res.length != opt.targetLength) {
+                    cycles.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(hitMutex);
+                    if (done.load(std::memory_order_relaxed)) break;
+                    std::uint64_t n = hits.fetch_add(1, std::memory_order_relaxed) + 1;
+                    onHit(res);
+                    if (opt.maxHits != 0 && n >= opt.maxHits) done.store(true);
+                }
+                break;
+            case SeedOutcome::DiedOut:
+                died.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case SeedOutcome::Overflow:
+                overflowed.fetch_add(1, std::memory_order_relaxed);
+                break;
+            case SeedOutcome::NoCycle:
+                noCycle.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+        }
+    });
+
+    SeedSearchStats stats;
+    stats.tried = tried;
+    stats.hits = hits;
+    stats.cycles = cycles;
+    stats.diedOut = died;
+    stats.overflowed = overflowed;
+    stats.noCycle = noCycle;
+    return stats;
+}
+
+} // namespace memoiza
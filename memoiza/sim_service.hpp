@@ -0,0 +1,616 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "checkpoint_store.hpp"
+#include "engine.hpp"
+#include "flat_cell_set.hpp"
+#include "pattern_io.hpp"
+#include "thread_pool.hpp"
+#include "zobrist.hpp"
+
+// --------------------------------------------------------------
+// СЕРВИС СИМУЛЯЦИЙ: ОБЩИЕ РЕЗУЛЬТАТЫ И АСИНХРОННЫЕ ЗАДАНИЯ
+// --------------------------------------------------------------
+//
+// Запрос — одна строка "<id> <команда> <аргументы>", ответ — одна строка
+// JSON с тем же id; ответы на разные запросы могут приходить не по
+// порядку. Команды:
+//   load path=<файл> | rle=<тело RLE> [size=RxC] [topology=bounded|torus]
+//        [rule=B3/S23] [engine=adaptive]
+//                          — загрузить узор (левый верхний угол в (0, 0))
+//   step <sim> <n>         — продвинуть общую границу расчёта на n поколений
+//   query <sim> <gen> [population|hash|state]
+//                          — поколение gen (state — клетки в RLE)
+//   cycle <sim> [n]        — найденный цикл; n — сколько ещё поколений искать
+//   stats                  — число симуляций, заданий и попаданий в кэш
+//
+// Симуляция определяется начальными клетками, размером, топологией и
+// правилом (не движком): одинаковый load от разных клиентов получает
+// одну симуляцию sim и её уже посчитанные поколения. Для каждого
+// поколения хранятся хеш, население и клетки (CheckpointStore); повтор
+// хеша — цикл, после него любое поколение отвечается сразу.
+//
+// Шагает симуляцию задание на исполнителе (ThreadPool), не больше одного
+// на симуляцию, по chunk поколений за раз, чтобы длинные расчёты
+// чередовались. Поле движка, сортировку и кодирование кадра и проверку
+// цикла задание делает вне мьютекса симуляции; под ним лишь дописываются
+// готовые хеш, население и кадр и снимаются готовые ожидания. Клетки для
+// ответа state восстанавливаются из копии кадров уже после мьютекса.
+// Поэтому запрос к уже посчитанному поколению отвечается сразу в потоке
+// клиента, а не ждёт шага.
+
+namespace memoiza {
+
+// Ответ клиенту: одна строка JSON без перевода строки. Вызывается ровно
+// один раз на запрос, из потока клиента или исполнителя.
+using ServiceReply = std::function<void(const std::string&)>;
+
+struct ServiceLimits {
+    std::uint64_t maxGeneration = 1 << 20;  // дальше считаем только до цикла
+    std::size_t maxSimulations = 64;        // лишние простаивающие вытесняются
+    std::uint64_t chunk = 256;              // поколений за одно задание
+    // Память записанных поколений (хеши, население, кадры, словарь хешей):
+    // симуляция, дошедшая до maxSimulationBytes без цикла, дальше не
+    // считается; сверх maxTotalBytes на все вытесняются простаивающие
+    std::size_t maxSimulationBytes = std::size_t(256) << 20;
+    std::size_t maxTotalBytes = std::size_t(2) << 30;
+};
+
+class SimulationService {
+public:
+    // executorThreads — потоки заданий; compute — пул для шагов движков
+    SimulationService(unsigned executorThreads, ThreadPool& compute, const ServiceLimits& limits = ServiceLimits())
+        : compute_(compute), limits_(limits), executor_(executorThreads + 1) {}
+
+    ~SimulationService() { stop(); }
+
+    // Больше не считать: ожидания получают ошибку, как только их задание
+    // закончит текущее поколение; новые запросы к будущим поколениям — сразу
+    void stop() { stopping_ = true; }
+
+    SimulationService(const SimulationService&) = delete;
+    SimulationService& operator=(const SimulationService&) = delete;
+
+    void handle(const std::string& line, const ServiceReply& reply) {
+        std::istringstream in(line);
+        std::string id, command;
+        in >> id >> command;
+        if (id.empty()) return;
+        requests_++;
+        std::vector<std::string> args;
+        for (std::string arg; in >> arg;) args.push_back(arg);
+
+        if (command == "load") {
+            load(id, args, reply);
+        } else if (command == "step" || command == "query" || command == "cycle") {
+            request(id, command, args, reply);
+        } else if (command == "stats") {
+            std::ostringstream out;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                out << "{\"id\":\"" << escape(id) << "\",\"ok\":true,\"simulations\":" << simulations_.size()
+                    << ",\"running\":" << running_.load() << ",\"requests\":" << requests_.load()
+                    << ",\"cacheHits\":" << cacheHits_.load() << "}";
+            }
+            reply(out.str());
+        } else {
+            reply(error(id, "unknown command: " + command));
+        }
+    }
+
+private:
+    struct Waiter {
+        enum Kind { State, Cycle } kind;
+        std::string id;
+        std::uint64_t generation;
+        std::string what;
+        ServiceReply reply;
+    };
+
+    struct Simulation {
+        std::string key;
+        // Только у задания, которое шагает; задание читает и пишет их без
+        // мьютекса. Кадры в states и seen тоже пишет только задание.
+        std::unique_ptr<Board> board;
+        std::vector<CellKey> cells;
+        std::vector<std::uint8_t> frame;
+
+        std::mutex mutex;
+        std::vector<Hash128> hashes;   // поколения 0 .. recorded-1
+        std::vector<std::uint64_t> populations;
+        CheckpointStore states;
+        std::unordered_multimap<Hash128, std::uint64_t, Hash128Hasher> seen;  // хеш -> поколения
+        bool cycleFound = false;
+        std::uint64_t cycleStart = 0, cycleLength = 0;
+        std::uint64_t target = 0;      // до какого поколения считать
+        bool running = false;
+        std::vector<Waiter> waiters;
+        std::uint64_t lastUsed = 0;
+        std::size_t bytes = 0;         // память записанных поколений, см. footprint
+        Rule rule;
+        std::int64_t rows = 0, cols = 0;
+    };
+
+    // Ответ, собранный под мьютексом симуляции. Для state в нём только
+    // начало текста и копия кадров: клетки и RLE строит send() без мьютекса.
+    struct Answer {
+        ServiceReply reply;
+        std::string text;
+        bool withState = false;
+        CheckpointStore frames;
+        std::int64_t rows = 0, cols = 0;
+        Rule rule;
+
+        void send() {
+            if (withState) {
+                std::vector<CellKey> cells;
+                frames.stateAt(frames.recorded() - 1, cells);
+                std::ostringstream rle;
+                RleWriter writer(rle, cols, rows, rule);
+                forEachRunSorted(cells.begin(), cells.end(),
+                                 [&](std::int64_t row, std::int64_t col, std::int64_t len) { writer.run(row, col, len); });
+                writer.finish();
+                text += ",\"population\":" + std::to_string(cells.size()) + ",\"rle\":\"" + escape(rle.str()) + "\"}";
+            }
+            reply(text);
+        }
+    };
+
+    static std::string escape(const std::string& text) {
+        std::string out;
+        for (char ch : text) {
+            if (ch == '"' || ch == '\\') {
+                out += '\\';
+                out += ch;
+            } else if (ch == '\n') {
+                out += "\\n";
+            } else if (static_cast<unsigned char>(ch) < 0x20) {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", ch);
+                out += code;
+            } else {
+                out += ch;
+            }
+        }
+        return out;
+    }
+
+    static std::string error(const std::string& id, const std::string& what) {
+        return "{\"id\":\"" + escape(id) + "\",\"ok\":false,\"error\":\"" + escape(what) + "\"}";
+    }
+
+    static std::string hex(const Hash128& h) {
+        char text[40];
+        std::snprintf(text, sizeof(text), "%016llx%016llx", static_cast<unsigned long long>(h.hi),
+                      static_cast<unsigned long long>(h.lo));
+        return text;
+    }
+
+    static bool parseCount(const std::string& text, std::uint64_t& value) {
+        if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || text.size() > 19) {
+            return false;
+        }
+        value = std::strtoull(text.c_str(), nullptr, 10);
+        return true;
+    }
+
+    // --------------------------------------------------------------
+    // ЗАГРУЗКА
+    // --------------------------------------------------------------
+
+    void load(const std::string& id, const std::vector<std::string>& args, const ServiceReply& reply) {
+        std::string path, rle, engine = "adaptive";
+        EngineConfig config;
+        config.rows = config.cols = 0;
+        bool ruleGiven = false;
+        for (const std::string& arg : args) {
+            std::size_t eq = arg.find('=');
+            std::string key = arg.substr(0, eq);
+            std::string value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+            if (key == "path") {
+                path = value;
+            } else if (key == "rle") {
+                rle = value;
+            } else if (key == "engine") {
+                engine = value;
+            } else if (key == "size") {
+                long long rows = 0, cols = 0;
+                char tail = 0;
+                if (std::sscanf(value.c_str(), "%lldx%lld%c", &rows, &cols, &tail) != 2 || rows <= 0 || cols <= 0) {
+                    reply(error(id, "bad size: " + value));
+                    return;
+                }
+                config.rows = rows;
+                config.cols = cols;
+            } else if (key == "topology") {
+                if (!parseTopology(value, config.topology) || config.topology == Topology::Plane) {
+                    reply(error(id, "bad topology: " + value + " (bounded or torus)"));
+                    return;
+                }
+            } else if (key == "rule") {
+                if (!parseRule(value, config.rule)) {
+                    reply(error(id, "bad rule: " + value));
+                    return;
+                }
+                ruleGiven = true;
+            } else {
+                reply(error(id, "unknown argument: " + arg));
+                return;
+            }
+        }
+        if (path.empty() == rle.empty()) {
+            reply(error(id, "load needs exactly one of path= and rle="));
+            return;
+        }
+
+        FlatCellSet cells;
+        SparseSink sink(cells);
+        PatternInfo info;
+        std::string problem;
+        bool parsed;
+        if (!path.empty()) {
+            parsed = readPattern(path, sink, info, problem);
+        } else {
+            std::istringstream text(rle);
+            parsed = parseRle(text, sink, info, problem);
+        }
+        if (!parsed) {
+            reply(error(id, problem));
+            return;
+        }
+        if (info.hasRule && !ruleGiven) config.rule = info.rule;
+        std::int64_t height = std::max<std::int64_t>(info.height, 1), width = std::max<std::int64_t>(info.width, 1);
+        for (CellKey cell : cells) {
+            height = std::max<std::int64_t>(height, std::int64_t(cellRow(cell)) + 1);
+            width = std::max<std::int64_t>(width, std::int64_t(cellCol(cell)) + 1);
+        }
+        if (config.rows == 0) {
+            config.rows = height;
+            config.cols = width;
+        }
+        if (sink.clipped() > 0 || height > config.rows || width > config.cols) {
+            reply(error(id, "pattern does not fit the field"));
+            return;
+        }
+        config.pool = &compute_;
+
+        // Ключ симуляции: клетки, размер, топология и правило
+        Hash128 h;
+        for (CellKey cell : cells) h ^= cellKey(cellRow(cell), cellCol(cell));
+        std::uint64_t shape = mix64(std::uint64_t(config.rows) * 0x9e3779b97f4a7c15ULL ^ std::uint64_t(config.cols));
+        shape = mix64(shape ^ (std::uint64_t(config.topology == Topology::Torus) << 40) ^
+                      (std::uint64_t(config.rule.birth) << 16) ^ config.rule.survive);
+        char key[20];
+        std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(mix64(h.lo ^ mix64(h.hi ^ shape))));
+
+        std::shared_ptr<Simulation> sim;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = simulations_.find(key);
+            if (it != simulations_.end()) {
+                sim = it->second;
+                sim->lastUsed = ++clock_;
+            }
+        }
+        if (sim) {
+            cacheHits_++;
+            std::unique_lock<std::mutex> lock(sim->mutex);
+            std::string text = loaded(id, *sim, true);
+            lock.unlock();
+            reply(text);
+            return;
+        }
+
+        sim = std::make_shared<Simulation>();
+        sim->key = key;
+        sim->rule = config.rule;
+        sim->rows = config.rows;
+        sim->cols = config.cols;
+        sim->board = makeEngine(engine, config, problem);
+        if (!sim->board) {
+            reply(error(id, problem));
+            return;
+        }
+        for (CellKey cell : cells) sim->board->set(cellRow(cell), cellCol(cell), true);
+        sim->cells.assign(cells.begin(), cells.end());
+        record(*sim, sim->board->hash(), sim->cells);
+
+        std::string text;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // Загрузка того же узора из другого потока могла успеть раньше
+            auto inserted = simulations_.emplace(key, sim);
+            if (!inserted.second) {
+                sim = inserted.first->second;
+                cacheHits_++;
+            }
+            sim->lastUsed = ++clock_;
+            evictLocked(sim.get());
+            std::lock_guard<std::mutex> simLock(sim->mutex);
+            text = loaded(id, *sim, !inserted.second);
+        }
+        reply(text);
+    }
+
+    std::string loaded(const std::string& id, const Simulation& sim, bool shared) const {
+        std::ostringstream out;
+        out << "{\"id\":\"" << escape(id) << "\",\"ok\":true,\"sim\":\"" << sim.key << "\",\"rows\":" << sim.rows
+            << ",\"cols\":" << sim.cols << ",\"rule\":\"" << sim.rule.toString()
+            << "\",\"population\":" << sim.populations[0] << ",\"computed\":" << sim.hashes.size() - 1
+            << ",\"shared\":" << (shared ? "true" : "false") << "}";
+        return out.str();
+    }
+
+    // Вытеснить давно не нужные симуляции без заданий, пока их больше
+    // maxSimulations или вместе они занимают больше maxTotalBytes; keep —
+    // симуляция, с которой сейчас работают, она не вытесняется
+    void evictLocked(const Simulation* keep) {
+        for (;;) {
+            auto victim = simulations_.end();
+            std::size_t total = 0;
+            for (auto it = simulations_.begin(); it != simulations_.end(); ++it) {
+                std::lock_guard<std::mutex> lock(it->second->mutex);
+                total += it->second->bytes;
+                if (it->second->running || it->second.get() == keep) continue;
+                if (victim == simulations_.end() || it->second->lastUsed < victim->second->lastUsed) victim = it;
+            }
+            if (simulations_.size() <= limits_.maxSimulations && total <= limits_.maxTotalBytes) return;
+            if (victim == simulations_.end()) return;
+            simulations_.erase(victim);
+        }
+    }
+
+    // --------------------------------------------------------------
+    // ЗАПРОСЫ К ПОКОЛЕНИЯМ
+    // --------------------------------------------------------------
+
+    void request(const std::string& id, const std::string& command, const std::vector<std::string>& args,
+                 const ServiceReply& reply) {
+        if (args.empty()) {
+            reply(error(id, command + " needs a simulation id"));
+            return;
+        }
+        std::shared_ptr<Simulation> sim;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = simulations_.find(args[0]);
+            if (it != simulations_.end()) {
+                sim = it->second;
+                sim->lastUsed = ++clock_;
+            }
+        }
+        if (!sim) {
+            reply(error(id, "unknown simulation: " + args[0]));
+            return;
+        }
+
+        Waiter waiter{command == "cycle" ? Waiter::Cycle : Waiter::State, id, 0, "all", reply};
+        std::uint64_t count = 0;
+        if (command == "cycle") {
+            if (args.size() > 1 && !parseCount(args[1], count)) {
+                reply(error(id, "bad generation count: " + args[1]));
+                return;
+            }
+        } else if (args.size() < 2 || !parseCount(args[1], count)) {
+            reply(error(id, command + " needs a generation number"));
+            return;
+        }
+        if (command == "query" && args.size() > 2) {
+            waiter.what = args[2];
+            if (waiter.what != "population" && waiter.what != "hash" && waiter.what != "state") {
+                reply(error(id, "bad query: " + waiter.what + " (population, hash or state)"));
+                return;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(sim->mutex);
+        std::uint64_t frontier = sim->hashes.size() - 1;
+        waiter.generation = command == "query" ? count : frontier + std::min(count, ~std::uint64_t(0) - frontier);
+        if (ready(*sim, waiter)) {
+            cacheHits_++;
+            Answer a;
+            a.reply = reply;
+            answer(*sim, waiter, a);
+            lock.unlock();
+            a.send();
+            return;
+        }
+        if (stopping_) {
+            lock.unlock();
+            reply(error(id, "service is stopping"));
+            return;
+        }
+        // Без цикла дальше maxGeneration не считаем: если цикл не найдётся, ошибка
+        sim->target = std::max(sim->target, std::min(waiter.generation, limits_.maxGeneration));
+        sim->waiters.push_back(std::move(waiter));
+        if (!sim->running) {
+            sim->running = true;
+            running_++;
+            lock.unlock();
+            executor_.submit([this, sim] { run(sim); });
+        }
+    }
+
+    bool ready(const Simulation& sim, const Waiter& waiter) const {
+        return sim.cycleFound || waiter.generation < sim.hashes.size();
+    }
+
+    // Записанное поколение, равное generation с учётом цикла
+    std::uint64_t resolve(const Simulation& sim, std::uint64_t generation) const {
+        if (sim.cycleFound && generation >= sim.cycleStart) {
+            generation = sim.cycleStart + (generation - sim.cycleStart) % sim.cycleLength;
+        }
+        return generation;
+    }
+
+    // Ответ на готовое ожидание; под мьютексом sim
+    void answer(const Simulation& sim, const Waiter& waiter, Answer& a) const {
+        std::ostringstream out;
+        out << "{\"id\":\"" << escape(waiter.id) << "\",\"ok\":true,\"sim\":\"" << sim.key << "\"";
+        if (waiter.kind == Waiter::Cycle) {
+            if (sim.cycleFound) {
+                out << ",\"cycle\":true,\"start\":" << sim.cycleStart << ",\"length\":" << sim.cycleLength;
+            } else {
+                out << ",\"cycle\":false,\"computed\":" << sim.hashes.size() - 1;
+            }
+            out << "}";
+            a.text = out.str();
+            return;
+        }
+        std::uint64_t stored = resolve(sim, waiter.generation);
+        out << ",\"generation\":" << waiter.generation;
+        if (stored != waiter.generation) out << ",\"equivalent\":" << stored;
+        if (waiter.what == "all" || waiter.what == "population") out << ",\"population\":" << sim.populations[stored];
+        if (waiter.what == "all" || waiter.what == "hash") out << ",\"hash\":\"" << hex(sim.hashes[stored]) << "\"";
+        if (waiter.what == "state") {
+            // Закрывающую скобку допишет send()
+            a.withState = sim.states.copyFramesFor(stored, a.frames);
+            a.rows = sim.rows;
+            a.cols = sim.cols;
+            a.rule = sim.rule;
+        }
+        if (!a.withState) out << "}";
+        a.text = out.str();
+    }
+
+    // --------------------------------------------------------------
+    // ЗАДАНИЕ ШАГА
+    // --------------------------------------------------------------
+
+    // Записать очередное поколение (клетки в любом порядке). Сортировка,
+    // кадр и проверка цикла — вне мьютекса: кадры и seen пишет только
+    // задание; под мьютексом sim лишь дописывается готовое.
+    void record(Simulation& sim, const Hash128& hash, const std::vector<CellKey>& cells) {
+        std::uint64_t generation = sim.states.recorded();
+        sim.states.encodeNext(cells.begin(), cells.end(), sim.frame);
+        // Совпадение хеша — только кандидат: цикл, если совпали и клетки
+        bool cycle = false;
+        std::uint64_t start = 0;
+        std::vector<CellKey> earlier;
+        auto candidates = sim.seen.equal_range(hash);
+        for (auto it = candidates.first; it != candidates.second && !cycle; ++it) {
+            if (sim.states.stateAt(it->second, earlier) && earlier == sim.states.lastState()) {
+                cycle = true;
+                start = it->second;
+            }
+        }
+        if (!cycle) sim.seen.emplace(hash, generation);
+
+        std::lock_guard<std::mutex> lock(sim.mutex);
+        sim.hashes.push_back(hash);
+        sim.populations.push_back(cells.size());
+        sim.states.appendEncoded(sim.frame);
+        sim.bytes = footprint(sim);
+        if (cycle) {
+            sim.cycleFound = true;
+            sim.cycleStart = start;
+            sim.cycleLength = generation - start;
+            sim.states.setCycle(sim.cycleStart, sim.cycleLength);
+        }
+    }
+
+    // Память записанных поколений; seen читает только задание
+    static std::size_t footprint(const Simulation& sim) {
+        // Узел словаря: хеш, поколение, кешированный хеш ключа и указатель
+        const std::size_t seenNode = sizeof(Hash128) + 3 * sizeof(std::uint64_t);
+        return sim.states.bytes() + sim.hashes.capacity() * sizeof(Hash128) +
+               sim.populations.capacity() * sizeof(std::uint64_t) + sim.seen.size() * seenNode +
+               sim.seen.bucket_count() * sizeof(void*);
+    }
+
+    bool overBudget(const Simulation& sim) const { return sim.bytes > limits_.maxSimulationBytes; }
+
+    // Снять готовые ожидания; finished — расчёт закончен, остальные получают ошибку
+    void collect(Simulation& sim, bool finished, std::vector<Answer>& answers) {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < sim.waiters.size(); i++) {
+            Waiter& waiter = sim.waiters[i];
+            if (ready(sim, waiter) || (waiter.kind == Waiter::Cycle && finished)) {
+                answers.emplace_back();
+                answers.back().reply = std::move(waiter.reply);
+                answer(sim, waiter, answers.back());
+            } else if (finished) {
+                answers.emplace_back();
+                answers.back().reply = std::move(waiter.reply);
+                answers.back().text = error(waiter.id, stopping_ ? "service is stopping"
+                                                       : overBudget(sim)
+                                                           ? "no cycle found within " +
+                                                                 std::to_string(limits_.maxSimulationBytes) +
+                                                                 " bytes of history"
+                                                           : "no cycle found within " +
+                                                                 std::to_string(limits_.maxGeneration) +
+                                                                 " generations");
+            } else {
+                if (kept != i) sim.waiters[kept] = std::move(waiter);
+                kept++;
+            }
+        }
+        sim.waiters.resize(kept);
+    }
+
+    void run(std::shared_ptr<Simulation> sim) {
+        std::vector<Answer> answers;
+        for (std::uint64_t i = 0;; i++) {
+            bool finished;
+            {
+                std::lock_guard<std::mutex> lock(sim->mutex);
+                finished = stopping_ || sim->cycleFound || sim->hashes.size() > sim->target || overBudget(*sim);
+                collect(*sim, finished, answers);
+                if (finished) {
+                    sim->running = false;
+                    running_--;
+                }
+            }
+            if (finished) {
+                // История выросла: возможно, пора вытеснить другие симуляции
+                std::lock_guard<std::mutex> lock(mutex_);
+                evictLocked(sim.get());
+            }
+            // Ответы отправляются вне мьютекса: запись в сокет может ждать
+            for (Answer& a : answers) a.send();
+            answers.clear();
+            if (finished) return;
+            if (i == limits_.chunk) {
+                // Уступить исполнитель другим симуляциям
+                executor_.submit([this, sim] { run(sim); });
+                return;
+            }
+
+            sim->board->step();
+            sim->cells.clear();
+            sim->board->forEachLive([&](std::int64_t row, std::int64_t col) {
+                sim->cells.push_back(packCell(static_cast<std::uint64_t>(row), static_cast<std::uint64_t>(col)));
+            });
+            record(*sim, sim->board->hash(), sim->cells);
+        }
+    }
+
+    ThreadPool& compute_;
+    ServiceLimits limits_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::uint64_t> requests_{0};
+    std::atomic<std::uint64_t> cacheHits_{0};
+    std::atomic<int> running_{0};
+
+    std::mutex mutex_;  // simulations_ и clock_
+    std::unordered_map<std::string, std::shared_ptr<Simulation>> simulations_;
+    std::uint64_t clock_ = 0;
+
+    // Последним: разрушается первым и дожидается заданий
+    ThreadPool executor_;
+};
+
+} // namespace memoiza
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "flat_cell_set.hpp"
+#include "rule.hpp"
+#include "zobrist.hpp"
+
+// --------------------------------------------------------------
+// РАЗРЕЖЕННЫЙ ШАГ ПО ОТСОРТИРОВАННЫМ КЛЕТКАМ
+// --------------------------------------------------------------
+//
+// Живые клетки — отсортированный массив упакованных ключей, то есть
+// строки идут подряд, а внутри строки клетки упорядочены по столбцу.
+// Строка r следующего поколения зависит только от строк r-1, r, r+1:
+// три строки проходятся одновременно окном столбцов [x-1, x+1], и число
+// живых клеток в окне сразу даёт ответ для клетки x. Хеш-таблиц нет,
+// ни один ключ не ищется, а результат получается уже отсортированным.
+// Пустые строки и столбцы перепрыгиваются, поэтому стоимость зависит
+// только от числа клеток, а не от размера поля (до 2^32 x 2^32).
+// Клетки вдали от живых не рассматриваются, поэтому правила с B0
+// (рождение без соседей) здесь не поддерживаются.
+
+namespace memoiza {
+
+namespace detail {
+
+// Окно столбцов [x-1, x+1] внутри клеток одной строки
+struct RowWindow {
+    const CellKey* lo;   // первая клетка со столбцом >= x-1
+    const CellKey* hi;   // первая клетка со столбцом > x+1
+    const CellKey* end;  // конец строки
+
+    void moveTo(std::uint64_t x) {
+        while (lo != end && std::uint64_t(cellCol(*lo)) + 1 < x) ++lo;
+        if (hi < lo) hi = lo;
+        while (hi != end && cellCol(*hi) <= x + 1) ++hi;
+    }
+
+    // Первый столбец >= x среди оставшихся клеток (или UINT64_MAX)
+    std::uint64_t firstFrom(std::uint64_t x) const {
+        for (const CellKey* p = lo; p != end; ++p) {
+            if (cellCol(*p) >= x) return cellCol(*p);
+        }
+        return UINT64_MAX;
+    }
+};
+
+// Конец клеток строки row, начиная с p
+inline const CellKey* rowEnd(const CellKey* p, const CellKey* end, std::uint64_t row) {
+    while (p != end && cellRow(*p) == row) ++p;
+    return p;
+}
+
+} // namespace detail
+
+// Следующее поколение строк [rowBegin, rowEnd) поля с cols столбцами.
+// [begin, end) — все живые клетки по возрастанию ключа; за краем поля
+// клеток нет; rule не должно содержать B0. Живые клетки дописываются
+// в out по возрастанию ключа. Если hash не nullptr, в него XOR-ятся ключи родившихся и умерших клеток;
+// если flips не nullptr, к нему прибавляется их число.
+inline void stepSortedRows(const CellKey* begin, const CellKey* end,
+                           std::uint64_t rowBegin, std::uint64_t rowEnd, std::uint64_t cols,
+                           const Rule& rule, std::vector<CellKey>& out, Hash128* hash = nullptr,
+                           std::uint64_t* flips = nullptr) {
+    if (rowBegin >= rowEnd) return;
+    // Первая клетка, которая может влиять на строку rowBegin
+    const CellKey* base = std::lower_bound(begin, end, packCell(rowBegin > 0 ? rowBegin - 1 : 0, 0));
+    if (base == end) return;
+    std::uint64_t r = std::max<std::uint64_t>(rowBegin, cellRow(*base) > 0 ? cellRow(*base) - 1 : 0);
+
+    while (r < rowEnd) {
+        // Строки r-1, r, r+1
+        while (base != end && std::uint64_t(cellRow(*base)) + 1 < r) ++base;
+        const CellKey* up = base;
+        const CellKey* mid = (r > 0) ? detail::rowEnd(up, end, r - 1) : up;
+        const CellKey* down = detail::rowEnd(mid, end, r);
+        const CellKey* after = detail::rowEnd(down, end, r + 1);
+
+        detail::RowWindow w[3] = {{up, up, mid}, {mid, mid, down}, {down, down, after}};
+
+        // Первый столбец, рядом с которым есть живая клетка
+        std::uint64_t first = UINT64_MAX;
+        for (const auto& win : w) {
+            if (win.lo != win.end) first = std::min<std::uint64_t>(first, cellCol(*win.lo));
+        }
+
+        std::uint64_t x = first > 0 ? first - 1 : 0;
+        while (first != UINT64_MAX && x < cols) {
+            int total = 0;
+            for (auto& win : w) {
+                win.moveTo(x);
+                total += static_cast<int>(win.hi - win.lo);
+            }
+            bool self = false;
+            for (const CellKey* p = w[1].lo; p != w[1].hi; ++p) {
+                if (cellCol(*p) == x) self = true;
+            }
+            // total включает саму клетку
+            bool aliveNext = rule.next(self, total - (self ? 1 : 0));
+            if (aliveNext) out.push_back(packCell(r, x));
+            if (self != aliveNext) {
+                if (hash != nullptr) *hash ^= cellKey(r, x);
+                if (flips != nullptr) ++*flips;
+            }
+
+            // Следующий столбец, окно которого не пусто
+            std::uint64_t m = UINT64_MAX;
+            for (const auto& win : w) m = std::min(m, win.firstFrom(x));
+            if (m == UINT64_MAX) break;
+            x = std::max(x + 2, m) - 1;
+        }
+
+        // Следующая строка, рядом с которой есть живые клетки
+        if (mid == end) break;
+        std::uint64_t nextLive = cellRow(*mid);
+        r = std::max(r + 2, nextLive) - 1;
+    }
+}
+
+// Отсортировать ключи клеток поразрядно (по 16 бит, пропуская разряды,
+// одинаковые у всех ключей); tmp — рабочий буфер, его ёмкость сохраняется
+inline void sortCellKeys(std::vector<CellKey>& keys, std::vector<CellKey>& tmp) {
+    if (keys.size() < 256) {
+        std::sort(keys.begin(), keys.end());
+        return;
+    }
+    std::uint64_t orAll = 0, andAll = ~0ULL;
+    for (CellKey k : keys) {
+        orAll |= k;
+        andAll &= k;
+    }
+    std::uint64_t varying = orAll ^ andAll;
+    tmp.resize(keys.size());
+    static thread_local std::vector<std::size_t> counts(1 << 16);
+    for (int shift = 0; shift < 64; shift += 16) {
+        if (((varying >> shift) & 0xffff) == 0) continue;
+        std::fill(counts.begin(), counts.end(), 0);
+        for (CellKey k : keys) counts[(k >> shift) & 0xffff]++;
+        std::size_t sum = 0;
+        for (auto& c : counts) {
+            std::size_t n = c;
+            c = sum;
+            sum += n;
+        }
+        for (CellKey k : keys) tmp[counts[(k >> shift) & 0xffff]++] = k;
+        keys.swap(tmp);
+    }
+}
+
+} // namespace memoiza
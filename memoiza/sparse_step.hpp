@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "flat_cell_set.hpp"
+#include "metrics.hpp"
+#include "rule.hpp"
+#include "sparse_rows.hpp"
+#include "thread_pool.hpp"
+#include "zobrist.hpp"
+
+// --------------------------------------------------------------
+// ШАГ РАЗРЕЖЕННОГО ПОЛЯ
+// --------------------------------------------------------------
+//
+// Поле rows x cols задано множеством живых клеток, за краем клеток нет.
+// Два способа: Hash — счётчики соседей в плоской хеш-таблице, Rows —
+// один проход по отсортированным клеткам (sparse_rows.hpp). Поле режется
+// на полосы строк; полосы считаются параллельно и не пишут в общие
+// структуры. Рабочие буферы живут в объекте SparseStepper, поэтому в
+// установившемся режиме шаг не выделяет память. Правила с B0 не
+// поддерживаются: рассматриваются только клетки рядом с живыми.
+//
+// ОГРАНИЧЕНИЕ ЧИСЛА ЖИВЫХ КЛЕТОК (LiveCap). Если после шага живых клеток
+// больше limit, удаляются лишние случайные. Выбор зависит только от
+// самого состояния и seed: удаляемые — номера в порядке возрастания
+// ключей клеток, генератор засевается хешем Зобриста состояния. Поэтому
+// шаг — чистая функция (повтор состояния означает настоящий цикл), и
+// результат не зависит от способа и числа потоков. Номера выбираются
+// алгоритмом Флойда за O(удаляемых); полосы Rows уже отсортированы,
+// полосы Hash сортируются параллельно только на шагах, где ограничение
+// сработало, а удаляемые клетки просто не попадают в следующее поколение.
+
+namespace memoiza {
+
+enum class SparseMethod { Hash, Rows };
+
+// Ограничение числа живых клеток, встроенное в шаг
+struct LiveCap {
+    std::size_t limit;
+    std::uint32_t seed;
+};
+
+class SparseStepper {
+public:
+    // Меньше этого числа живых клеток полосы не окупаются
+    static const std::size_t PARALLEL_MIN_CELLS = 4096;
+
+    explicit SparseStepper(SparseMethod method = SparseMethod::Hash) : method_(method) {}
+
+    SparseMethod method() const { return method_; }
+    void setMethod(SparseMethod method) { method_ = method; }
+
+    // Время ограничения, удалённые, рождения и смерти — в metrics
+    void setMetrics(Metrics* metrics) { metrics_ = metrics; }
+
+    // Следующее поколение current в next (ёмкость next переиспользуется).
+    // hash — хеш current, обновляется по изменившимся клеткам; cap
+    // требует hash. Возвращает число клеток, удалённых ограничением.
+    std::size_t step(const FlatCellSet& current, FlatCellSet& next, std::uint64_t rows, std::uint64_t cols,
+                     const Rule& rule, ThreadPool& pool, Hash128* hash = nullptr, const LiveCap* cap = nullptr) {
+        std::uint64_t flips = 0;
+        std::uint64_t* countFlips = (metrics_ != nullptr && metrics_->enabled()) ? &flips : nullptr;
+        removed_ = 0;
+        if (method_ == SparseMethod::Rows) {
+            stepRows(current, next, rows, cols, rule, pool, hash, countFlips, cap);
+        } else if (pool.size() == 1 || current.size() < PARALLEL_MIN_CELLS) {
+            stepSerial(current, next, rows, cols, rule, hash, countFlips);
+            if (cap != nullptr) enforce(next, *cap, *hash);
+        } else {
+            stepBands(current, next, rows, cols, rule, pool, hash, countFlips, cap);
+        }
+        // Рождения и смерти — по полю до ограничения: удалённые считаются отдельно
+        if (countFlips != nullptr) metrics_->countStep(current.size(), next.size() + removed_, flips);
+        return removed_;
+    }
+
+    // Однопоточный шаг без полос (эталон для проверок); к flips
+    // прибавляется число изменившихся клеток
+    void stepSerial(const FlatCellSet& current, FlatCellSet& next, std::uint64_t rows, std::uint64_t cols,
+                    const Rule& rule, Hash128* hash = nullptr, std::uint64_t* flips = nullptr) {
+        next.clear();
+        next.reserve(current.size());
+        FlatCellMap<int>& neighborCount = serialCounts_;
+        neighborCount.clear();
+        neighborCount.reserve(current.size() * 9);  // Грубая оценка
+
+        // Сама клетка заводит кандидата, соседи добавляют по 1
+        forEachNeighborhood(current, 0, rows, cols, [&](CellKey candidate, int add) {
+            neighborCount[candidate] += add;
+        });
+
+        neighborCount.forEach([&](CellKey cell, int cnt) {
+            bool aliveNow = current.contains(cell);
+            bool aliveNext = rule.next(aliveNow, cnt);
+            if (aliveNext) next.insert(cell);
+            if (aliveNow != aliveNext) {
+                if (hash != nullptr) *hash ^= cellKey(cellRow(cell), cellCol(cell));
+                if (flips != nullptr) ++*flips;
+            }
+        });
+    }
+
+    // Удалить лишние клетки grid (см. LiveCap); hash — хеш grid.
+    // Возвращает число удалённых клеток.
+    std::size_t enforce(FlatCellSet& grid, const LiveCap& cap, Hash128& hash) {
+        if (grid.size() <= cap.limit) return 0;
+        auto timer = capTimer();
+        std::size_t toRemove = grid.size() - cap.limit;
+        keys_.assign(grid.begin(), grid.end());
+        sortCellKeys(keys_, scratch_);
+        CapRandom rng(cap.seed, hash);
+        chooseVictims(keys_.size(), toRemove, rng);
+        for (std::uint64_t i : victims_) {
+            grid.erase(keys_[i]);
+            hash ^= cellKey(cellRow(keys_[i]), cellCol(keys_[i]));
+        }
+        return noteRemoved(toRemove);
+    }
+
+private:
+    // Рабочие структуры одной полосы
+    struct Band {
+        std::vector<CellKey> cells;   // клетки полосы вместе с ореолом
+        FlatCellSet local;            // они же множеством
+        FlatCellMap<int> counts;      // счётчики соседей
+        std::vector<CellKey> alive;   // живые клетки следующего поколения
+        Hash128 changes;              // XOR ключей изменившихся клеток
+        std::uint64_t flips = 0;      // число изменившихся клеток
+    };
+
+    // Генератор выбора удаляемых: splitmix64, одинаковый на всех платформах
+    struct CapRandom {
+        std::uint64_t state;
+
+        CapRandom(std::uint32_t seed, const Hash128& hash) : state(mix64(mix64(hash.lo ^ seed) ^ hash.hi)) {}
+
+        std::uint64_t next() {
+            state += 0x9e3779b97f4a7c15ULL;
+            return mix64(state);
+        }
+
+        // Равномерно в [0, bound)
+        std::uint64_t below(std::uint64_t bound) {
+            return static_cast<std::uint64_t>((static_cast<unsigned __int128>(next()) * bound) >> 64);
+        }
+    };
+
+    // Клетки current и их соседи в строках [rowLo, rowHi): fn(кандидат, 0)
+    // для самой клетки и fn(кандидат, 1) для соседа
+    template <class Set, class Fn>
+    static void forEachNeighborhood(const Set& cells, std::uint64_t rowLo, std::uint64_t rowHi,
+                                    std::uint64_t cols, Fn&& fn) {
+        for (CellKey cell : cells) {
+            std::int64_t r = static_cast<std::int64_t>(cellRow(cell));
+            std::int64_t c = static_cast<std::int64_t>(cellCol(cell));
+            for (int dr = -1; dr <= 1; dr++) {
+                std::int64_t rr = r + dr;
+                if (rr < static_cast<std::int64_t>(rowLo) || rr >= static_cast<std::int64_t>(rowHi)) continue;
+                for (int dc = -1; dc <= 1; dc++) {
+                    std::int64_t cc = c + dc;
+                    if (cc < 0 || cc >= static_cast<std::int64_t>(cols)) continue;
+                    fn(packCell(static_cast<std::uint64_t>(rr), static_cast<std::uint64_t>(cc)),
+                       (dr == 0 && dc == 0) ? 0 : 1);
+                }
+            }
+        }
+    }
+
+    // Рабочие полосы (не меньше count штук), очищенные
+    Band* bands(std::size_t count) {
+        if (bands_.size() < count) bands_.resize(count);
+        for (std::size_t b = 0; b < count; b++) {
+            bands_[b].cells.clear();
+            bands_[b].alive.clear();
+            bands_[b].changes = Hash128();
+            bands_[b].flips = 0;
+        }
+        return bands_.data();
+    }
+
+    // Полосы по строкам со своими клетками и ореолом из граничных строк соседей
+    void stepBands(const FlatCellSet& current, FlatCellSet& next, std::uint64_t rows, std::uint64_t cols,
+                   const Rule& rule, ThreadPool& pool, Hash128* hash, std::uint64_t* flips, const LiveCap* cap) {
+        std::uint64_t bandRows = std::max<std::uint64_t>(1, (rows + pool.size() * 4 - 1) / (pool.size() * 4));
+        std::size_t count = static_cast<std::size_t>((rows + bandRows - 1) / bandRows);
+
+        Band* band = bands(count);
+        for (CellKey cell : current) {
+            std::uint64_t row = cellRow(cell);
+            std::size_t b = static_cast<std::size_t>(row / bandRows);
+            band[b].cells.push_back(cell);
+            if (row % bandRows == 0 && b > 0) {
+                band[b - 1].cells.push_back(cell);
+            }
+            if (row % bandRows == bandRows - 1 && b + 1 < count) {
+                band[b + 1].cells.push_back(cell);
+            }
+        }
+
+        pool.parallelFor(0, count, 1, [&](std::size_t lo, std::size_t hi) {
+            for (std::size_t b = lo; b < hi; b++) {
+                std::uint64_t rowLo = b * bandRows;
+                std::uint64_t rowHi = std::min(rows, (b + 1) * bandRows);
+                FlatCellSet& local = band[b].local;
+                local.clear();
+                local.reserve(band[b].cells.size());
+                for (CellKey cell : band[b].cells) local.insert(cell);
+                FlatCellMap<int>& neighborCount = band[b].counts;
+                neighborCount.clear();
+                neighborCount.reserve(local.size() * 9);
+
+                forEachNeighborhood(local, rowLo, rowHi, cols, [&](CellKey candidate, int add) {
+                    neighborCount[candidate] += add;
+                });
+
+                neighborCount.forEach([&](CellKey cell, int cnt) {
+                    bool aliveNow = local.contains(cell);
+                    bool aliveNext = rule.next(aliveNow, cnt);
+                    if (aliveNext) band[b].alive.push_back(cell);
+                    if (aliveNow != aliveNext) {
+                        band[b].changes ^= cellKey(cellRow(cell), cellCol(cell));
+                        band[b].flips++;
+                    }
+                });
+            }
+        });
+
+        merge(band, count, next, hash, flips, cap, false, pool);
+    }
+
+    // Скользящее окно по трём строкам отсортированных клеток, без поиска
+    // ключей в таблице
+    void stepRows(const FlatCellSet& current, FlatCellSet& next, std::uint64_t rows, std::uint64_t cols,
+                  const Rule& rule, ThreadPool& pool, Hash128* hash, std::uint64_t* flips, const LiveCap* cap) {
+        keys_.assign(current.begin(), current.end());
+        sortCellKeys(keys_, scratch_);
+        const CellKey* first = keys_.data();
+        const CellKey* last = keys_.data() + keys_.size();
+
+        std::size_t count = 1;
+        if (pool.size() > 1 && current.size() >= PARALLEL_MIN_CELLS) {
+            count = static_cast<std::size_t>(std::min<std::uint64_t>(rows, pool.size() * 4));
+        }
+        std::uint64_t bandRows = (rows + count - 1) / count;
+
+        Band* band = bands(count);
+        pool.parallelFor(0, count, 1, [&](std::size_t lo, std::size_t hi) {
+            for (std::size_t b = lo; b < hi; b++) {
+                std::uint64_t rowLo = std::min(rows, b * bandRows);
+                std::uint64_t rowHi = std::min(rows, (b + 1) * bandRows);
+                stepSortedRows(first, last, rowLo, rowHi, cols, rule, band[b].alive,
+                               hash != nullptr ? &band[b].changes : nullptr,
+                               flips != nullptr ? &band[b].flips : nullptr);
+            }
+        });
+
+        merge(band, count, next, hash, flips, cap, true, pool);
+    }
+
+    // Собрать живые клетки полос в next и сложить изменения хеша и их
+    // число; с cap лишние клетки удаляются при сборке. sorted — клетки
+    // каждой полосы уже идут по возрастанию ключа.
+    void merge(Band* band, std::size_t count, FlatCellSet& next, Hash128* hash, std::uint64_t* flips,
+               const LiveCap* cap, bool sorted, ThreadPool& pool) {
+        std::size_t total = 0;
+        for (std::size_t b = 0; b < count; b++) total += band[b].alive.size();
+        // XOR коммутативен: изменения полос можно сложить в любом порядке
+        if (hash != nullptr) {
+            for (std::size_t b = 0; b < count; b++) *hash ^= band[b].changes;
+        }
+        if (flips != nullptr) {
+            for (std::size_t b = 0; b < count; b++) *flips += band[b].flips;
+        }
+
+        victims_.clear();
+        if (cap != nullptr && total > cap->limit) {
+            auto timer = capTimer();
+            // Полосы идут по строкам, поэтому отсортированные полосы подряд —
+            // все клетки по возрастанию ключа
+            if (!sorted) {
+                pool.parallelFor(0, count, 1, [&](std::size_t lo, std::size_t hi) {
+                    for (std::size_t b = lo; b < hi; b++) std::sort(band[b].alive.begin(), band[b].alive.end());
+                });
+            }
+            CapRandom rng(cap->seed, *hash);
+            chooseVictims(total, total - cap->limit, rng);
+            noteRemoved(total - cap->limit);
+        }
+
+        next.clear();
+        next.reserve(total - victims_.size());
+        std::uint64_t index = 0;
+        std::size_t v = 0;
+        for (std::size_t b = 0; b < count; b++) {
+            for (CellKey cell : band[b].alive) {
+                if (v < victims_.size() && victims_[v] == index) {
+                    *hash ^= cellKey(cellRow(cell), cellCol(cell));
+                    v++;
+                } else {
+                    next.insert(cell);
+                }
+                index++;
+            }
+        }
+    }
+
+    // toRemove различных номеров из [0, total) по возрастанию (алгоритм Флойда)
+    void chooseVictims(std::uint64_t total, std::uint64_t toRemove, CapRandom& rng) {
+        chosen_.clear();
+        chosen_.reserve(toRemove);
+        victims_.clear();
+        for (std::uint64_t j = total - toRemove; j < total; j++) {
+            std::uint64_t t = rng.below(j + 1);
+            if (!chosen_.insert(t)) {
+                // t уже выбран, а j ещё нет: j раньше не мог выпасть
+                t = j;
+                chosen_.insert(j);
+            }
+            victims_.push_back(t);
+        }
+        std::sort(victims_.begin(), victims_.end());
+    }
+
+    Metrics::Timer capTimer() {
+        return Metrics::Timer(metrics_ != nullptr && metrics_->enabled() ? metrics_ : nullptr, Phase::Cap);
+    }
+
+    std::size_t noteRemoved(std::size_t count) {
+        removed_ = count;
+        if (metrics_ != nullptr) metrics_->add(Counter::Removed, count);
+        return count;
+    }
+
+    SparseMethod method_;
+    Metrics* metrics_ = nullptr;
+    std::size_t removed_ = 0;
+
+    std::vector<Band> bands_;
+    FlatCellMap<int> serialCounts_;
+    std::vector<CellKey> keys_, scratch_;
+    std::vector<std::uint64_t> victims_;
+    FlatCellSet chosen_;
+};
+
+} // namespace memoiza
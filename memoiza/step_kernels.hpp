@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "bit_grid.hpp"
+#include "rule.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define MEMOIZA_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// --------------------------------------------------------------
+// ЯДРА ШАГА ДЛЯ БИТОВОЙ СЕТКИ И ВЫБОР ПО CPU
+// --------------------------------------------------------------
+//
+// Скалярное ядро обрабатывает 64 клетки за операцию, AVX2 — 256,
+// AVX-512 — 512. Ядро выбирается один раз при первом шаге по тому,
+// что поддерживает процессор; переменная окружения MEMOIZA_KERNEL
+// позволяет принудительно выбрать ядро (scalar, avx2, avx512).
+// Векторные ядра считают B3/S23; для других правил (rule.hpp) ядро
+// выбирается по правилу: шаблонное для известных правил, табличное
+// для остальных.
+
+namespace memoiza {
+
+// Шаг для строк [rowBegin, rowEnd) из src в dst
+using StepRowsFn = void (*)(const BitGrid& src, BitGrid& dst, int rowBegin, int rowEnd);
+
+struct StepKernel {
+    const char* name;
+    StepRowsFn stepRows;
+};
+
+#ifdef MEMOIZA_X86_KERNELS
+
+// Полный сумматор для 4 слов
+__attribute__((target("avx2")))
+inline void fullAdd256(__m256i a, __m256i b, __m256i c, __m256i& sum, __m256i& carry) {
+    __m256i u = _mm256_xor_si256(a, b);
+    sum = _mm256_xor_si256(u, c);
+    carry = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+}
+
+// Сдвиги «к соседу слева/справа» с переносом бита из соседнего слова
+__attribute__((target("avx2")))
+inline __m256i westOf256(__m256i x, __m256i left) {
+    return _mm256_or_si256(_mm256_slli_epi64(x, 1), _mm256_srli_epi64(left, 63));
+}
+
+__attribute__((target("avx2")))
+inline __m256i eastOf256(__m256i x, __m256i right) {
+    return _mm256_or_si256(_mm256_srli_epi64(x, 1), _mm256_slli_epi64(right, 63));
+}
+
+__attribute__((target("avx2")))
+inline void stepRowsAvx2(const BitGrid& src, BitGrid& dst, int rowBegin, int rowEnd) {
+    const int words = src.wordsPerRow();
+    const std::uint64_t lastMask = src.lastWordMask();
+    if (words == 0) return;
+    for (int r = rowBegin; r < rowEnd; r++) {
+        const std::uint64_t* up = src.row(r - 1);
+        const std::uint64_t* mid = src.row(r);
+        const std::uint64_t* down = src.row(r + 1);
+        const std::uint64_t* ahead = src.row(std::min(r + 2, src.rows()));
+        std::uint64_t* out = dst.row(r);
+        int w = 0;
+        for (; w + 4 <= words; w += 4) {
+            // Одна подгрузка на линию, а не на каждые 4 слова
+            if ((w & (CACHE_LINE_WORDS - 1)) == 0) __builtin_prefetch(ahead + w + PREFETCH_WORDS);
+            __m256i u = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + w));
+            __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mid + w));
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + w));
+            __m256i aW = westOf256(u, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + w - 1)));
+            __m256i aE = eastOf256(u, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(up + w + 1)));
+            __m256i mW = westOf256(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mid + w - 1)));
+            __m256i mE = eastOf256(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mid + w + 1)));
+            __m256i bW = westOf256(d, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + w - 1)));
+            __m256i bE = eastOf256(d, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(down + w + 1)));
+
+            __m256i a0, a1, b0, b1, s0, c1, t0, t1;
+            fullAdd256(aW, u, aE, a0, a1);
+            fullAdd256(bW, d, bE, b0, b1);
+            __m256i m0 = _mm256_xor_si256(mW, mE);
+            __m256i m1 = _mm256_and_si256(mW, mE);
+            fullAdd256(a0, b0, m0, s0, c1);
+            fullAdd256(a1, b1, m1, t0, t1);
+
+            // (t0 ^ c1) & ~(t1 | (t0 & c1)): andnot(x, y) = ~x & y
+            __m256i twoOrThree = _mm256_andnot_si256(
+                _mm256_or_si256(t1, _mm256_and_si256(t0, c1)), _mm256_xor_si256(t0, c1));
+            __m256i next = _mm256_and_si256(twoOrThree, _mm256_or_si256(s0, m));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + w), next);
+        }
+        for (; w < words; w++) {
+            out[w] = lifeWord(up[w - 1], up[w], up[w + 1],
+                              mid[w - 1], mid[w], mid[w + 1],
+                              down[w - 1], down[w], down[w + 1]);
+        }
+        out[words - 1] &= lastMask;
+    }
+}
+
+// GCC 12 ложно предупреждает о _mm512_undefined_epi32 внутри сдвигов
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// В AVX-512 сумматоры и правило сводятся к vpternlogq:
+// 0x96 — a^b^c, 0xE8 — большинство, 0x12 — (a^c) & ~(b | (a&c)), 0xE0 — a & (b|c)
+__attribute__((target("avx512f")))
+inline void stepRowsAvx512(const BitGrid& src, BitGrid& dst, int rowBegin, int rowEnd) {
+    const int words = src.wordsPerRow();
+    const std::uint64_t lastMask = src.lastWordMask();
+    if (words == 0) return;
+    for (int r = rowBegin; r < rowEnd; r++) {
+        const std::uint64_t* up = src.row(r - 1);
+        const std::uint64_t* mid = src.row(r);
+        const std::uint64_t* down = src.row(r + 1);
+        const std::uint64_t* ahead = src.row(std::min(r + 2, src.rows()));
+        std::uint64_t* out = dst.row(r);
+        int w = 0;
+        for (; w + 8 <= words; w += 8) {
+            __builtin_prefetch(ahead + w + PREFETCH_WORDS);
+            __m512i u = _mm512_loadu_si512(up + w);
+            __m512i m = _mm512_loadu_si512(mid + w);
+            __m512i d = _mm512_loadu_si512(down + w);
+            __m512i aW = _mm512_or_si512(_mm512_slli_epi64(u, 1), _mm512_srli_epi64(_mm512_loadu_si512(up + w - 1), 63));
+            __m512i aE = _mm512_or_si512(_mm512_srli_epi64(u, 1), _mm512_slli_epi64(_mm512_loadu_si512(up + w + 1), 63));
+            __m512i mW = _mm512_or_si512(_mm512_slli_epi64(m, 1), _mm512_srli_epi64(_mm512_loadu_si512(mid + w - 1), 63));
+            __m512i mE = _mm512_or_si512(_mm512_srli_epi64(m, 1), _mm512_slli_epi64(_mm512_loadu_si512(mid + w + 1), 63));
+            __m512i bW = _mm512_or_si512(_mm512_slli_epi64(d, 1), _mm512_srli_epi64(_mm512_loadu_si512(down + w - 1), 63));
+            __m512i bE = _mm512_or_si512(_mm512_srli_epi64(d, 1), _mm512_slli_epi64(_mm512_loadu_si512(down + w + 1), 63));
+
+            __m512i a0 = _mm512_ternarylogic_epi64(aW, u, aE, 0x96);
+            __m512i a1 = _mm512_ternarylogic_epi64(aW, u, aE, 0xE8);
+            __m512i b0 = _mm512_ternarylogic_epi64(bW, d, bE, 0x96);
+            __m512i b1 = _mm512_ternarylogic_epi64(bW, d, bE, 0xE8);
+            __m512i m0 = _mm512_xor_si512(mW, mE);
+            __m512i m1 = _mm512_and_si512(mW, mE);
+            __m512i s0 = _mm512_ternarylogic_epi64(a0, b0, m0, 0x96);
+            __m512i c1 = _mm512_ternarylogic_epi64(a0, b0, m0, 0xE8);
+            __m512i t0 = _mm512_ternarylogic_epi64(a1, b1, m1, 0x96);
+            __m512i t1 = _mm512_ternarylogic_epi64(a1, b1, m1, 0xE8);
+            __m512i twoOrThree = _mm512_ternarylogic_epi64(t0, t1, c1, 0x12);
+            __m512i next = _mm512_ternarylogic_epi64(twoOrThree, s0, m, 0xE0);
+            _mm512_storeu_si512(out + w, next);
+        }
+        for (; w < words; w++) {
+            out[w] = lifeWord(up[w - 1], up[w], up[w + 1],
+                              mid[w - 1], mid[w], mid[w + 1],
+                              down[w - 1], down[w], down[w + 1]);
+        }
+        out[words - 1] &= lastMask;
+    }
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // MEMOIZA_X86_KERNELS
+
+// Все ядра, которые может выполнить текущий процессор (скалярное — первое)
+inline std::vector<StepKernel> availableStepKernels() {
+    std::vector<StepKernel> kernels;
+    kernels.push_back({"scalar", &stepBitGridRows});
+#ifdef MEMOIZA_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({"avx2", &stepRowsAvx2});
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        kernels.push_back({"avx512", &stepRowsAvx512});
+    }
+#endif
+    return kernels;
+}
+
+// Самое широкое доступное ядро, либо заданное через MEMOIZA_KERNEL
+inline StepKernel detectStepKernel() {
+    std::vector<StepKernel> kernels = availableStepKernels();
+    const char* forced = std::getenv("MEMOIZA_KERNEL");
+    if (forced != nullptr) {
+        for (const auto& k : kernels) {
+            if (std::strcmp(k.name, forced) == 0) return k;
+        }
+    }
+    return kernels.back();
+}
+
+// Текущее ядро; выбирается один раз, может быть переопределено
+inline StepKernel& activeStepKernel() {
+    static StepKernel kernel = detectStepKernel();
+    return kernel;
+}
+
+// Выбрать ядро по имени; false, если процессор его не поддерживает
+inline bool selectStepKernel(const char* name) {
+    for (const auto& k : availableStepKernels()) {
+        if (std::strcmp(k.name, name) == 0) {
+            activeStepKernel() = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+// --------------------------------------------------------------
+// ЯДРА ДЛЯ ПРАВИЛА
+// --------------------------------------------------------------
+
+// Текущее правило (по умолчанию B3/S23)
+inline Rule& activeRule() {
+    static Rule rule = CONWAY_RULE;
+    return rule;
+}
+
+// Шаг прямоугольника строк и слов; true, если что-то изменилось
+using StepBlockFn = bool (*)(const Rule& rule, const BitGrid& src, BitGrid& dst,
+                             int rowBegin, int rowEnd, int wordBegin, int wordEnd);
+
+struct RuleKernels {
+    StepRowsFn stepRows;  // nullptr — ядро по CPU (только B3/S23)
+    StepBlockFn stepBlock;
+};
+
+template <class WordRule>
+inline void stepRowsWithRule(const BitGrid& src, BitGrid& dst, int rowBegin, int rowEnd) {
+    stepBlockWith<WordRule>(activeRule(), src, dst, rowBegin, rowEnd, 0, src.wordsPerRow());
+}
+
+template <class WordRule>
+inline RuleKernels ruleKernelsFor() {
+    return {&stepRowsWithRule<WordRule>, &stepBlockWith<WordRule>};
+}
+
+inline RuleKernels kernelsForRule(const Rule& rule) {
+    if (rule == CONWAY_RULE) return {nullptr, &stepBlockWith<ConwayWord>};
+    if (rule == HIGHLIFE_RULE) {
+        return ruleKernelsFor<FixedRuleWord<HIGHLIFE_RULE.birth, HIGHLIFE_RULE.survive>>();
+    }
+    if (rule == DAY_AND_NIGHT_RULE) {
+        return ruleKernelsFor<FixedRuleWord<DAY_AND_NIGHT_RULE.birth, DAY_AND_NIGHT_RULE.survive>>();
+    }
+    if (rule == SEEDS_RULE) {
+        return ruleKernelsFor<FixedRuleWord<SEEDS_RULE.birth, SEEDS_RULE.survive>>();
+    }
+    return ruleKernelsFor<TableRuleWord>();
+}
+
+inline RuleKernels& activeRuleKernels() {
+    static RuleKernels kernels = kernelsForRule(activeRule());
+    return kernels;
+}
+
+// Сменить правило для всех последующих шагов
+inline void selectRule(const Rule& rule) {
+    activeRule() = rule;
+    activeRuleKernels() = kernelsForRule(rule);
+}
+
+// Ядро шага строк для текущего правила
+inline StepRowsFn ruleStepRows() {
+    StepRowsFn rows = activeRuleKernels().stepRows;
+    return rows != nullptr ? rows : activeStepKernel().stepRows;
+}
+
+// Один шаг всей сетки выбранным ядром; dst должен иметь размеры src
+inline void stepBitGrid(const BitGrid& src, BitGrid& dst) {
+    ruleStepRows()(src, dst, 0, src.rows());
+}
+
+inline BitGrid nextGeneration(const BitGrid& g) {
+    BitGrid next(g.rows(), g.cols());
+    stepBitGrid(g, next);
+    return next;
+}
+
+} // namespace memoiza
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------------
+// ПОСТОЯННЫЙ ПУЛ ПОТОКОВ С КРАЖЕЙ ЗАДАЧ
+// --------------------------------------------------------------
+//
+// Потоки создаются один раз при создании пула. У каждого рабочего своя
+// очередь: он берёт задачи с конца своей очереди, а когда она пуста —
+// крадёт с начала чужих. Поток, вызвавший parallelFor, тоже выполняет
+// задачи, пока ждёт завершения.
+
+namespace memoiza {
+
+class ThreadPool {
+public:
+    // Задача без выделения памяти: функция и её аргумент
+    struct Task {
+        void (*fn)(void*) = nullptr;
+        void* arg = nullptr;
+    };
+
+    // threads — общее число исполнителей, включая вызывающий поток
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency()) {
+        if (threads == 0) threads = 1;
+        queues_.reserve(threads);
+        for (unsigned i = 0; i < threads; i++) {
+            queues_.emplace_back(new TaskQueue());
+        }
+        // Очередь 0 принадлежит вызывающему потоку, остальные — рабочим
+        for (unsigned i = 1; i < threads; i++) {
+            workers_.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stopping_ = true;
+        }
+        wakeup_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Число исполнителей (рабочие потоки + вызывающий)
+    unsigned size() const { return static_cast<unsigned>(queues_.size()); }
+
+    // Поставить задачу в очередь исполнителя hint (по кругу, если hint велик)
+    void push(Task task, unsigned hint = 0) {
+        pending_.fetch_add(1, std::memory_order_release);
+        queues_[hint % queues_.size()]->pushBack(task);
+        if (!workers_.empty()) {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            wakeup_.notify_one();
+        }
+    }
+
+    // Асинхронная задача произвольного вида (выделяет память под замыкание)
+    void submit(std::function<void()> fn) {
+        if (workers_.empty()) {
+            fn();
+            return;
+        }
+        auto* boxed = new std::function<void()>(std::move(fn));
+        push({[](void* p) {
+                  std::unique_ptr<std::function<void()>> f(static_cast<std::function<void()>*>(p));
+                  (*f)();
+              },
+              boxed},
+             nextHint_.fetch_add(1, std::memory_order_relaxed));
+    }
+
+    // Выполнить fn(lo, hi) для отрезков [begin, end) длиной не более grain.
+    // Каждый исполнитель получает одну задачу, которая забирает отрезки
+    // из общего атомарного счётчика; возврат — когда обработано всё.
+    template <class Fn>
+    void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, Fn&& fn) {
+        if (begin >= end) return;
+        if (grain == 0) grain = 1;
+        std::size_t chunks = (end - begin + grain - 1) / grain;
+        if (chunks == 1 || size() == 1) {
+            fn(begin, end);
+            return;
+        }
+
+        struct Job {
+            Fn* fn;
+            std::size_t begin, end, grain;
+            std::atomic<std::size_t> next{0};
+            std::atomic<unsigned> active{0};
+        };
+        Job job;
+        job.fn = &fn;
+        job.begin = begin;
+        job.end = end;
+        job.grain = grain;
+
+        auto runner = [](void* p) {
+            Job* j = static_cast<Job*>(p);
+            for (;;) {
+                std::size_t lo = j->begin + j->next.fetch_add(j->grain, std::memory_order_relaxed);
+                if (lo >= j->end) break;
+                std::size_t hi = lo + j->grain < j->end ? lo + j->grain : j->end;
+                (*j->fn)(lo, hi);
+            }
+            j->active.fetch_sub(1, std::memory_order_acq_rel);
+        };
+
+        unsigned helpers = static_cast<unsigned>(chunks < size() ? chunks : size());
+        job.active.store(helpers, std::memory_order_relaxed);
+        for (unsigned i = 1; i < helpers; i++) {
+            push({runner, &job}, i);
+        }
+        runner(&job);
+
+        // Пока ждём остальных, помогаем с любыми задачами из очередей
+        while (job.active.load(std::memory_order_acquire) != 0) {
+            if (!runOne(0)) std::this_thread::yield();
+        }
+    }
+
+private:
+    // Кольцевая очередь задач под мьютексом; растёт только при переполнении
+    class TaskQueue {
+    public:
+        void pushBack(Task t) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (count_ == buffer_.size()) grow();
+            buffer_[(head_ + count_) % buffer_.size()] = t;
+            count_++;
+        }
+        bool popBack(Task& t) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (count_ == 0) return false;
+            count_--;
+            t = buffer_[(head_ + count_) % buffer_.size()];
+            return true;
+        }
+        bool stealFront(Task& t) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (count_ == 0) return false;
+            t = buffer_[head_];
+            head_ = (head_ + 1) % buffer_.size();
+            count_--;
+            return true;
+        }
+    private:
+        void grow() {
+            std::vector<Task> bigger(buffer_.empty() ? 64 : buffer_.size() * 2);
+            for (std::size_t i = 0; i < count_; i++) {
+                bigger[i] = buffer_[(head_ + i) % buffer_.size()];
+            }
+            buffer_.swap(bigger);
+            head_ = 0;
+        }
+        std::mutex mutex_;
+        std::vector<Task> buffer_;
+        std::size_t head_ = 0;
+        std::size_t count_ = 0;
+    };
+
+    // Взять задачу из своей очереди или украсть чужую и выполнить её
+    bool runOne(unsigned self) {
+        Task t;
+        bool found = queues_[self]->popBack(t);
+        for (std::size_t i = 1; !found && i < queues_.size(); i++) {
+            found = queues_[(self + i) % queues_.size()]->stealFront(t);
+        }
+        if (!found) return false;
+        pending_.fetch_sub(1, std::memory_order_acq_rel);
+        t.fn(t.arg);
+        return true;
+    }
+
+    void workerLoop(unsigned self) {
+        for (;;) {
+            if (runOne(self)) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            wakeup_.wait(lock, [this] {
+                return stopping_ || pending_.load(std::memory_order_acquire) > 0;
+            });
+            if (stopping_ && pending_.load(std::memory_order_acquire) == 0) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<std::size_t> pending_{0};
+    std::atomic<unsigned> nextHint_{1};
+    std::mutex sleepMutex_;
+    std::condition_variable wakeup_;
+    bool stopping_ = false;
+};
+
+} // namespace memoiza
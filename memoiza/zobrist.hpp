@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "bit_grid.hpp"
+
+// --------------------------------------------------------------
+// 128-БИТНОЕ ХЕШИРОВАНИЕ СОСТОЯНИЯ ПО ЗОБРИСТУ
+// --------------------------------------------------------------
+//
+// Хеш поля — XOR ключей всех живых клеток. XOR коммутативен, поэтому
+// хеш не зависит от порядка обхода клеток, а рождение или смерть клетки
+// меняет его одной операцией: хеш обновляется по изменениям за шаг,
+// без полного перехеширования. Ключ клетки вычисляется из координат
+// смешивающей функцией, таблица не нужна, координаты любые (64 бита).
+
+namespace memoiza {
+
+struct Hash128 {
+    std::uint64_t lo = 0;
+    std::uint64_t hi = 0;
+
+    Hash128& operator^=(const Hash128& o) {
+        lo ^= o.lo;
+        hi ^= o.hi;
+        return *this;
+    }
+    bool operator==(const Hash128& o) const { return lo == o.lo && hi == o.hi; }
+    bool operator!=(const Hash128& o) const { return !(*this == o); }
+};
+
+// Для std::unordered_map: биты ключа уже перемешаны
+struct Hash128Hasher {
+    std::size_t operator()(const Hash128& h) const {
+        return static_cast<std::size_t>(h.lo ^ (h.hi * 0x9e3779b97f4a7c15ULL));
+    }
+};
+
+// Финализатор splitmix64
+inline std::uint64_t mix64(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Ключ клетки (row, col); две половины считаются независимо
+inline Hash128 cellKey(std::uint64_t row, std::uint64_t col) {
+    Hash128 k;
+    k.lo = mix64(mix64(row ^ 0x243f6a8885a308d3ULL) ^ col);
+    k.hi = mix64(mix64(col ^ 0x13198a2e03707344ULL) + row * 0xa4093822299f31d1ULL);
+    return k;
+}
+
+// Полный хеш битовой сетки (нужен один раз, дальше — по изменениям)
+inline Hash128 zobristHash(const BitGrid& g) {
+    Hash128 h;
+    for (int r = 0; r < g.rows(); r++) {
+        const std::uint64_t* p = g.row(r);
+        for (int w = 0; w < g.wordsPerRow(); w++) {
+            std::uint64_t bits = p[w];
+            while (bits != 0) {
+                int b = __builtin_ctzll(bits);
+                h ^= cellKey(static_cast<std::uint64_t>(r), static_cast<std::uint64_t>(w * 64 + b));
+                bits &= bits - 1;
+            }
+        }
+    }
+    return h;
+}
+
+// Обновить хеш по разнице двух поколений: стоимость — одно сравнение
+// на слово плюс XOR ключа на каждую родившуюся или умершую клетку
+inline void updateZobrist(const BitGrid& before, const BitGrid& after, Hash128& h) {
+    for (int r = 0; r < before.rows(); r++) {
+        const std::uint64_t* a = before.row(r);
+        const std::uint64_t* b = after.row(r);
+        for (int w = 0; w < before.wordsPerRow(); w++) {
+            std::uint64_t changed = a[w] ^ b[w];
+            while (changed != 0) {
+                int bit = __builtin_ctzll(changed);
+                h ^= cellKey(static_cast<std::uint64_t>(r), static_cast<std::uint64_t>(w * 64 + bit));
+                changed &= changed - 1;
+            }
+        }
+    }
+}
+
+} // namespace memoiza
@@ -0,0 +1,445 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <csignal>
+#include <cerrno>
+#include <cstring>   // для std::strcmp
+#include <cstdlib>   // для std::atoi
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "memoiza/engine.hpp"
+#include "memoiza/sim_service.hpp"
+
+// --------------------------------------------------------------
+// СЕРВЕР СИМУЛЯЦИЙ НА UNIX-СОКЕТЕ
+// --------------------------------------------------------------
+//
+// Долгоживущий процесс: клиенты подключаются к локальному сокету и
+// присылают строки запросов (протокол — memoiza/sim_service.hpp), ответы
+// приходят строками JSON по мере готовности. Каждого клиента читает свой
+// поток, шагают симуляции задания исполнителя, поэтому медленный расчёт
+// не задерживает ни чтение запросов, ни ответы из кэша. Когда клиент
+// закрывает свою сторону, сервер дописывает ответы на его запросы и
+// закрывает соединение. С --query программа сама становится клиентом:
+// запросы берутся из stdin, ответы печатаются в stdout.
+
+// Путь сокета (--socket)
+static std::string socketPath = "memoiza.sock";
+
+// Потоки заданий исполнителя (--jobs) и потоки шага движков (--threads)
+static unsigned jobThreads = 2;
+static unsigned computeThreads = std::thread::hardware_concurrency();
+
+static memoiza::ServiceLimits limits;
+
+// Самая длинная строка запроса: дальше клиент отключается
+static const std::size_t MAX_REQUEST = 1 << 20;
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+void onSignal(int) { stopRequested = 1; }
+
+// Соединение клиента. Ответы пишут потоки исполнителя и поток чтения,
+// поэтому запись — под мьютексом; pending — запросы, ещё ждущие ответа.
+struct Connection {
+    explicit Connection(int socket) : fd(socket) {}
+    ~Connection() { ::close(fd); }
+
+    void send(const std::string& line) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        std::string text = line + "\n";
+        std::size_t done = 0;
+        while (!broken && done < text.size()) {
+            ssize_t n = ::send(fd, text.data() + done, text.size() - done, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) broken = true;  // клиент ушёл: остальные ответы некуда писать
+            else done += static_cast<std::size_t>(n);
+        }
+    }
+
+    void begin() {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending++;
+    }
+    void end() {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (--pending == 0) idle.notify_all();
+    }
+    void waitIdle() {
+        std::unique_lock<std::mutex> lock(pendingMutex);
+        idle.wait(lock, [&] { return pending == 0; });
+    }
+
+    int fd;
+    std::mutex writeMutex;
+    bool broken = false;
+    std::mutex pendingMutex;
+    std::condition_variable idle;
+    int pending = 0;
+};
+
+// Читать запросы клиента до конца его потока, затем дождаться ответов
+void serveClient(std::shared_ptr<Connection> conn, memoiza::SimulationService& service) {
+    std::string buffer;
+    char chunk[4096];
+    for (;;) {
+        ssize_t n = ::read(conn->fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        buffer.append(chunk, static_cast<std::size_t>(n));
+        std::size_t start = 0, end;
+        while ((end = buffer.find('\n', start)) != std::string::npos) {
+            std::string line = buffer.substr(start, end - start);
+            start = end + 1;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            conn->begin();
+            service.handle(line, [conn](const std::string& text) {
+                conn->send(text);
+                conn->end();
+            });
+        }
+        buffer.erase(0, start);
+        if (buffer.size() > MAX_REQUEST) {
+            conn->send("{\"ok\":false,\"error\":\"request line too long\"}");
+            break;
+        }
+    }
+    conn->waitIdle();
+    ::shutdown(conn->fd, SHUT_RDWR);
+}
+
+// Открыть слушающий сокет; -1 и сообщение в error при ошибке
+int listenOn(const std::string& path, std::string& error) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        error = "слишком длинный путь сокета: " + path;
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        error = std::string("socket: ") + std::strerror(errno);
+        return -1;
+    }
+    ::unlink(path.c_str());  // сокет от прежнего запуска
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 64) != 0) {
+        error = path + ": " + std::strerror(errno);
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connectTo(const std::string& path, std::string& error) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        error = "слишком длинный путь сокета: " + path;
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        error = path + ": " + std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Поток чтения клиента; done выставляется, когда поток закончил работу
+struct Reader {
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> done;
+    std::weak_ptr<Connection> conn;
+};
+
+// Дождаться закончивших потоков и убрать их: иначе долгоживущий сервер
+// копил бы по потоку и соединению на каждого клиента
+void reapReaders(std::vector<Reader>& readers) {
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < readers.size(); i++) {
+        if (readers[i].done->load()) {
+            readers[i].thread.join();
+            continue;
+        }
+        if (kept != i) readers[kept] = std::move(readers[i]);
+        kept++;
+    }
+    readers.resize(kept);
+}
+
+// Принимать клиентов, пока не выставлен stop; затем остановить расчёты,
+// отключить клиентов и дождаться их потоков
+void runServer(int listenFd, memoiza::SimulationService& service, const volatile std::sig_atomic_t& stop) {
+    std::vector<Reader> readers;
+    while (!stop) {
+        reapReaders(readers);
+        pollfd p{listenFd, POLLIN, 0};
+        int ready = ::poll(&p, 1, 200);
+        if (ready <= 0) continue;
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+        auto conn = std::make_shared<Connection>(fd);
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        std::thread thread([conn, done, &service] {
+            serveClient(conn, service);
+            done->store(true);
+        });
+        readers.push_back(Reader{std::move(thread), done, conn});
+    }
+    service.stop();
+    for (auto& reader : readers) {
+        if (auto conn = reader.conn.lock()) ::shutdown(conn->fd, SHUT_RD);
+    }
+    for (auto& reader : readers) reader.thread.join();
+}
+
+// Клиент: строки stdin — на сервер, ответы — в stdout
+int runClient() {
+    std::string error;
+    int fd = connectTo(socketPath, error);
+    if (fd < 0) {
+        std::cerr << "Ошибка: " << error << "\n";
+        return 1;
+    }
+    std::thread printer([fd] {
+        char chunk[4096];
+        ssize_t n;
+        while ((n = ::read(fd, chunk, sizeof(chunk))) > 0) std::cout.write(chunk, n);
+        std::cout.flush();
+    });
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        line += "\n";
+        if (::send(fd, line.data(), line.size(), MSG_NOSIGNAL) < 0) break;
+    }
+    ::shutdown(fd, SHUT_WR);
+    printer.join();
+    ::close(fd);
+    return 0;
+}
+
+// --------------------------------------------------------------
+// САМОПРОВЕРКА
+// --------------------------------------------------------------
+
+// Значение поля ответа: строка без кавычек или число
+std::string field(const std::string& json, const std::string& name) {
+    std::string key = "\"" + name + "\":";
+    std::size_t pos = json.find(key);
+    if (pos == std::string::npos) return "";
+    pos += key.size();
+    if (json[pos] == '"') {
+        std::size_t end = json.find('"', pos + 1);
+        return json.substr(pos + 1, end - pos - 1);
+    }
+    std::size_t end = json.find_first_of(",}", pos);
+    return json.substr(pos, end - pos);
+}
+
+// Запрос к сервису с ожиданием ответа
+std::string call(memoiza::SimulationService& service, const std::string& line) {
+    auto promise = std::make_shared<std::promise<std::string>>();
+    std::future<std::string> answer = promise->get_future();
+    service.handle(line, [promise](const std::string& text) { promise->set_value(text); });
+    return answer.get();
+}
+
+bool runSelfTest() {
+    memoiza::ThreadPool compute(2);
+    bool ok = true;
+
+    // Планер на торе 32x32 возвращается через 128 поколений: после цикла
+    // любое поколение отвечается сразу и совпадает с прямым расчётом
+    {
+        memoiza::SimulationService service(2, compute);
+        std::string loaded = call(service, "1 load rle=bo$2bo$3o! size=32x32 topology=torus");
+        std::string sim = field(loaded, "sim");
+        std::string cycle = call(service, "2 cycle " + sim + " 1000");
+        bool cycleOk = field(cycle, "cycle") == "true" && field(cycle, "length") == "128";
+
+        memoiza::EngineConfig config;
+        config.topology = memoiza::Topology::Torus;
+        config.rows = config.cols = 32;
+        config.pool = &compute;
+        std::string error;
+        std::unique_ptr<memoiza::Board> direct = memoiza::makeEngine("dense", config, error);
+        const int glider[5][2] = {{0, 1}, {1, 2}, {2, 0}, {2, 1}, {2, 2}};
+        for (const auto& cell : glider) direct->set(cell[0], cell[1], true);
+        const std::uint64_t far = 1000000000000007ULL;
+        direct->advance(far % 128);
+        memoiza::Hash128 h = direct->hash();
+        char expected[40];
+        std::snprintf(expected, sizeof(expected), "%016llx%016llx", static_cast<unsigned long long>(h.hi),
+                      static_cast<unsigned long long>(h.lo));
+        std::string query = call(service, "3 query " + sim + " " + std::to_string(far));
+        bool farOk = field(query, "hash") == expected && field(query, "population") == "5";
+        std::string state = call(service, "4 query " + sim + " 4 state");
+        bool stateOk = field(state, "rle").find("2bo$3bo$b3o!") != std::string::npos;
+        std::cout << "Сервис: цикл планера " << (cycleOk ? "найден" : "НЕ найден") << ", поколение " << far << " "
+                  << (farOk ? "совпадает" : "расхождение") << ", состояние " << (stateOk ? "совпадает" : "расхождение")
+                  << "\n";
+        ok = ok && cycleOk && farOk && stateOk;
+    }
+
+    // Одновременные клиенты с одним узором получают одну симуляцию
+    {
+        memoiza::SimulationService service(3, compute);
+        std::vector<std::string> answers(8);
+        std::vector<std::thread> clients;
+        for (int i = 0; i < 8; i++) {
+            clients.emplace_back([&, i] {
+                answers[i] = call(service, std::to_string(i) + " load rle=b2o$2o$bo! size=200x200 topology=torus");
+                answers[i] = call(service, std::to_string(i) + " query " + field(answers[i], "sim") + " " +
+                                               std::to_string(300 + i * 50) + " population");
+            });
+        }
+        for (auto& t : clients) t.join();
+        std::string stats = call(service, "s stats");
+        bool shared = field(stats, "simulations") == "1";
+        for (const std::string& a : answers) shared = shared && field(a, "ok") == "true";
+        std::cout << "Сервис: 8 клиентов, симуляций " << field(stats, "simulations") << ", попаданий в кэш "
+                  << field(stats, "cacheHits") << ": " << (shared ? "общая" : "расхождение") << "\n";
+        ok = ok && shared;
+    }
+
+    // Без цикла дальше предела не считаем; неверные запросы — ошибки
+    {
+        memoiza::ServiceLimits small;
+        small.maxGeneration = 64;
+        memoiza::SimulationService service(1, compute, small);
+        std::string sim = field(call(service, "1 load rle=b2o$2o$bo! size=200x200 topology=torus"), "sim");
+        bool limitOk = field(call(service, "2 query " + sim + " 1000"), "ok") == "false" &&
+                       field(call(service, "3 query " + sim + " 64"), "ok") == "true" &&
+                       field(call(service, "4 query nosuch 1"), "ok") == "false" &&
+                       field(call(service, "5 load rle=3o! topology=plane"), "ok") == "false" &&
+                       field(call(service, "6 dance"), "ok") == "false";
+        std::cout << "Сервис: предел поколений и ошибки: " << (limitOk ? "совпадает" : "расхождение") << "\n";
+        ok = ok && limitOk;
+    }
+
+    // Предел памяти: история одной симуляции не растёт дальше бюджета, а
+    // сверх общего бюджета вытесняются простаивающие
+    {
+        memoiza::ServiceLimits small;
+        small.maxSimulationBytes = 64 << 10;
+        small.maxTotalBytes = 1;
+        memoiza::SimulationService service(1, compute, small);
+        std::string first = field(call(service, "1 load rle=b2o$2o$bo! size=200x200 topology=torus"), "sim");
+        std::string tooFar = call(service, "2 query " + first + " 100000");
+        bool memoryOk = field(tooFar, "ok") == "false" && field(tooFar, "error").find("bytes") != std::string::npos &&
+                        field(call(service, "3 query " + first + " 10"), "ok") == "true";
+        std::string second = field(call(service, "4 load rle=3o! size=20x20"), "sim");
+        memoryOk = memoryOk && field(call(service, "5 query " + second + " 3"), "ok") == "true" &&
+                   field(call(service, "6 stats"), "simulations") == "1" &&
+                   field(call(service, "7 query " + first + " 10"), "ok") == "false";
+        std::cout << "Сервис: предел памяти: " << (memoryOk ? "совпадает" : "расхождение") << "\n";
+        ok = ok && memoryOk;
+    }
+
+    // Через сокет: два клиента, ответы приходят строками
+    {
+        std::string path = "/tmp/memoiza-selftest-" + std::to_string(::getpid()) + ".sock";
+        std::string error;
+        int listenFd = listenOn(path, error);
+        bool socketOk = listenFd >= 0;
+        if (socketOk) {
+            memoiza::SimulationService service(2, compute);
+            volatile std::sig_atomic_t stop = 0;
+            std::thread server([&] { runServer(listenFd, service, stop); });
+            for (int client = 0; client < 2 && socketOk; client++) {
+                int fd = connectTo(path, error);
+                std::string request = "a load rle=bo$2bo$3o! size=64x64\n";
+                socketOk = fd >= 0 && ::send(fd, request.data(), request.size(), MSG_NOSIGNAL) > 0;
+                std::string reply;
+                char ch;
+                while (socketOk && ::read(fd, &ch, 1) == 1 && ch != '\n') reply += ch;
+                request = "b query " + field(reply, "sim") + " 40 population\n";
+                socketOk = socketOk && ::send(fd, request.data(), request.size(), MSG_NOSIGNAL) > 0;
+                ::shutdown(fd, SHUT_WR);
+                reply.clear();
+                while (socketOk && ::read(fd, &ch, 1) == 1) reply += ch;
+                socketOk = socketOk && field(reply, "id") == "b" && field(reply, "population") == "5" &&
+                           field(reply, "generation") == "40";
+                if (fd >= 0) ::close(fd);
+            }
+            stop = 1;
+            server.join();
+            ::close(listenFd);
+            ::unlink(path.c_str());
+        }
+        std::cout << "Сервер на сокете: " << (socketOk ? "совпадает" : "расхождение " + error) << "\n";
+        ok = ok && socketOk;
+    }
+    return ok;
+}
+
+void printUsage(const char* program) {
+    std::cout << "Использование: " << program
+              << " [--socket <путь>] [--jobs <n>] [--threads <n>] [--max-generation <n>] [--max-sims <n>]"
+              << " [--max-memory <МиБ>] [--max-sim-memory <МиБ>] [--query] [--selftest]\n";
+}
+
+int main(int argc, char* argv[]) {
+    bool clientMode = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobThreads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            computeThreads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--max-generation") == 0 && i + 1 < argc) {
+            limits.maxGeneration = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--max-sims") == 0 && i + 1 < argc) {
+            limits.maxSimulations = static_cast<std::size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--max-memory") == 0 && i + 1 < argc) {
+            limits.maxTotalBytes = static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10)) << 20;
+        } else if (std::strcmp(argv[i], "--max-sim-memory") == 0 && i + 1 < argc) {
+            limits.maxSimulationBytes = static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10)) << 20;
+        } else if (std::strcmp(argv[i], "--query") == 0) {
+            clientMode = true;
+        } else if (std::strcmp(argv[i], "--selftest") == 0) {
+            return runSelfTest() ? 0 : 1;
+        } else if (std::strcmp(argv[i], "--help") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            std::cerr << "Неизвестный аргумент: " << argv[i] << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (clientMode) return runClient();
+
+    std::string error;
+    int listenFd = listenOn(socketPath, error);
+    if (listenFd < 0) {
+        std::cerr << "Ошибка: " << error << "\n";
+        return 1;
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::cerr << "Сервер слушает " << socketPath << "\n";
+    {
+        memoiza::ThreadPool compute(computeThreads);
+        memoiza::SimulationService service(jobThreads, compute, limits);
+        runServer(listenFd, service, stopRequested);
+    }
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+    return 0;
+}
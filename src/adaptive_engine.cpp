@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <climits>
+
+#include "engines.hpp"
+
+// Адаптивный движок: держит поле в одном из представлений — плотном
+// (битовая сетка), разреженном (множество клеток) или квадродереве
+// (HashLife) — и переносит клетки в другое, когда меняется фаза прогона.
+//
+// При проверках смотрятся плотность (живые / площадь) и активность
+// (насколько изменилось население с прошлой проверки):
+//   - плотное <-> разреженное по плотности, с разными порогами входа и
+//     выхода (DENSE_ENTER > DENSE_LEAVE), чтобы поле на пороге не
+//     переносилось туда и обратно;
+//   - квадродерево, когда население почти не меняется QUIET_CHECKS
+//     проверок подряд (спокойный хвост: натюрморты, осцилляторы,
+//     планеры); выход — при заметной активности (BUSY_SHARE).
+// После переноса MIN_DWELL проверок представление не меняется. Проверка
+// плотного поля проходит всю сетку, поэтому, пока представление не
+// меняется, промежуток между проверками удваивается от CHECK_EVERY до
+// CHECK_MAX; после переноса проверки снова частые.
+//
+// HashLife считает неограниченную плоскость, поэтому на поле с краем
+// им шагают, только пока клетки не могут дойти до края: прыжок на k
+// поколений точен, если рамка живых клеток отстоит от края хотя бы на k.
+// Когда клетки доходят до края, поле сразу переносится обратно.
+
+namespace memoiza {
+
+namespace {
+
+enum class Backend { Dense, Sparse, Quadtree };
+
+const char* backendName(Backend backend) {
+    switch (backend) {
+    case Backend::Dense: return "dense";
+    case Backend::Sparse: return "sparse";
+    case Backend::Quadtree: return "quadtree";
+    }
+    return "";
+}
+
+class AdaptiveEngine : public Board {
+public:
+    static constexpr std::uint64_t CHECK_EVERY = 64;
+    static constexpr std::uint64_t CHECK_MAX = 1024;
+    // Плотность входа в плотное представление и выхода из него. Плотное
+    // поле шагает только активные тайлы и по замерам обгоняет
+    // разреженное вплоть до плотности около 1e-6; разреженное нужно
+    // огромному почти пустому полю, которому сетка не по памяти.
+    static constexpr double DENSE_ENTER = 1.0 / (1 << 20);
+    static constexpr double DENSE_LEAVE = 1.0 / (1 << 22);
+    // Больше клеток плотная сетка не займёт (две сетки по 128 МиБ)
+    static constexpr std::int64_t DENSE_MAX_CELLS = std::int64_t(1) << 30;
+    // Спокойно: население изменилось не больше чем на 1/QUIET_SHARE
+    static constexpr std::uint64_t QUIET_SHARE = 32;
+    static constexpr int QUIET_CHECKS = 4;
+    // Активно: население изменилось больше чем на 1/BUSY_SHARE
+    static constexpr std::uint64_t BUSY_SHARE = 8;
+    static constexpr int MIN_DWELL = 2;
+
+    AdaptiveEngine(const EngineConfig& config, std::unique_ptr<Board> initial, Backend kind)
+        : config_(config), backend_(std::move(initial)), kind_(kind) {}
+
+    std::int64_t rows() const override { return config_.rows; }
+    std::int64_t cols() const override { return config_.cols; }
+    std::uint64_t generation() const override { return generation_; }
+    std::uint64_t population() const override { return backend_->population(); }
+
+    bool get(std::int64_t row, std::int64_t col) const override {
+        return locate(row, col) && backend_->get(row, col);
+    }
+    void set(std::int64_t row, std::int64_t col, bool alive) override {
+        if (locate(row, col)) backend_->set(row, col, alive);
+    }
+
+    void step() override { advance(1); }
+
+    void advance(std::uint64_t generations) override {
+        while (generations > 0) {
+            if (generation_ >= nextCheck_) check();
+            std::uint64_t k;
+            if (kind_ == Backend::Quadtree) {
+                // Прыжок не дальше, чем клетки могут дойти до края
+                k = std::min(generations, margin());
+                if (k == 0) {
+                    convert(byDensity());
+                    continue;
+                }
+            } else {
+                k = std::min(generations, nextCheck_ - generation_);
+            }
+            backend_->advance(k);
+            generation_ += k;
+            generations -= k;
+        }
+    }
+
+    void forEachLive(const std::function<void(std::int64_t, std::int64_t)>& fn) const override {
+        backend_->forEachLive(fn);
+    }
+    Hash128 hash() const override { return backend_->hash(); }
+    bool bounds(std::int64_t& top, std::int64_t& left, std::int64_t& bottom, std::int64_t& right) const override {
+        return backend_->bounds(top, left, bottom, right);
+    }
+
+    Backend kind() const { return kind_; }
+    std::uint64_t switches() const { return switches_; }
+
+private:
+    bool locate(std::int64_t& row, std::int64_t& col) const {
+        if (config_.topology == Topology::Torus) {
+            row = ((row % config_.rows) + config_.rows) % config_.rows;
+            col = ((col % config_.cols) + config_.cols) % config_.cols;
+            return true;
+        }
+        return row >= 0 && row < config_.rows && col >= 0 && col < config_.cols;
+    }
+
+    bool available(Backend backend) const {
+        // Разреженное и квадродерево рассматривают только клетки рядом с
+        // живыми, поэтому правило с рождением из пустоты (B0) им не подходит
+        switch (backend) {
+        case Backend::Dense:
+#ifdef MEMOIZA_ENGINE_DENSE
+            return config_.rows <= INT_MAX / 2 && config_.cols <= INT_MAX / 2 &&
+                   config_.rows * config_.cols <= DENSE_MAX_CELLS;
+#else
+            return false;
+#endif
+        case Backend::Sparse:
+#ifdef MEMOIZA_ENGINE_SPARSE
+            return config_.topology == Topology::Bounded && (config_.rule.birth & 1u) == 0;
+#else
+            return false;
+#endif
+        case Backend::Quadtree:
+#ifdef MEMOIZA_ENGINE_HASHLIFE
+            return (config_.rule.birth & 1u) == 0;
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    // Плотное или разреженное представление для текущей плотности
+    Backend byDensity() const {
+        if (!available(Backend::Sparse)) return Backend::Dense;
+        if (!available(Backend::Dense)) return Backend::Sparse;
+        double density = double(backend_->population()) / (double(config_.rows) * double(config_.cols));
+        if (kind_ == Backend::Dense) return density < DENSE_LEAVE ? Backend::Sparse : Backend::Dense;
+        return density > DENSE_ENTER ? Backend::Dense : Backend::Sparse;
+    }
+
+    // Расстояние от рамки живых клеток до края поля
+    std::uint64_t margin() const {
+        std::int64_t top, left, bottom, right;
+        if (!backend_->bounds(top, left, bottom, right)) return ~std::uint64_t(0);
+        std::int64_t m = std::min(std::min(top, left), std::min(config_.rows - 1 - bottom, config_.cols - 1 - right));
+        return static_cast<std::uint64_t>(std::max<std::int64_t>(m, 0));
+    }
+
+    void check() {
+        nextCheck_ = generation_ + interval_;
+        interval_ = std::min(interval_ * 2, CHECK_MAX);
+        std::uint64_t pop = backend_->population();
+        std::uint64_t change = pop > lastPopulation_ ? pop - lastPopulation_ : lastPopulation_ - pop;
+        lastPopulation_ = pop;
+        quietChecks_ = change * QUIET_SHARE <= pop ? quietChecks_ + 1 : 0;
+        bool busy = change * BUSY_SHARE > pop;
+        if (dwell_ > 0) {
+            dwell_--;
+            return;
+        }
+        Backend want = kind_ == Backend::Quadtree ? (busy ? byDensity() : kind_) : byDensity();
+        if (kind_ != Backend::Quadtree && quietChecks_ >= QUIET_CHECKS && available(Backend::Quadtree) &&
+            margin() >= CHECK_EVERY) {
+            want = Backend::Quadtree;
+        }
+        if (want != kind_) convert(want);
+    }
+
+    void convert(Backend to) {
+        EngineConfig config = config_;
+        std::string error;
+        std::unique_ptr<Board> next;
+        switch (to) {
+        case Backend::Dense:
+#ifdef MEMOIZA_ENGINE_DENSE
+            next = makeDenseEngine(config, error);
+#endif
+            break;
+        case Backend::Sparse:
+#ifdef MEMOIZA_ENGINE_SPARSE
+            next = makeSparseEngine(config, true, error);
+#endif
+            break;
+        case Backend::Quadtree:
+#ifdef MEMOIZA_ENGINE_HASHLIFE
+            config.topology = Topology::Plane;
+            next = makeHashLifeEngine(config, error);
+#endif
+            break;
+        }
+        if (!next) return;  // available() отсеивает то, что нельзя создать
+        Board& target = *next;
+        backend_->forEachLive([&](std::int64_t row, std::int64_t col) { target.set(row, col, true); });
+        backend_ = std::move(next);
+        kind_ = to;
+        dwell_ = MIN_DWELL;
+        interval_ = CHECK_EVERY;
+        nextCheck_ = generation_ + interval_;
+        quietChecks_ = 0;
+        switches_++;
+    }
+
+    EngineConfig config_;
+    std::unique_ptr<Board> backend_;
+    Backend kind_;
+    std::uint64_t generation_ = 0;
+    std::uint64_t nextCheck_ = 0;
+    std::uint64_t interval_ = CHECK_EVERY;
+    std::uint64_t lastPopulation_ = 0;
+    int quietChecks_ = 0;
+    int dwell_ = 0;
+    std::uint64_t switches_ = 0;
+};
+
+} // namespace
+
+std::unique_ptr<Board> makeAdaptiveEngine(const EngineConfig& config, std::string& error) {
+    if (config.topology == Topology::Plane) {
+        error = "адаптивный движок работает на поле с краем (на плоскости есть hashlife)";
+        return nullptr;
+    }
+    // Клетки ставятся в разреженное представление, если оно есть: первая
+    // проверка выберет представление по плотности
+    EngineConfig own = config;
+    if (own.pool == nullptr) {
+        // Один пул на все представления, а не новый при каждом переносе
+        static ThreadPool sharedPool;
+        own.pool = &sharedPool;
+    }
+    std::unique_ptr<Board> initial;
+    Backend kind = Backend::Dense;
+#ifdef MEMOIZA_ENGINE_SPARSE
+    if (own.topology == Topology::Bounded) {
+        initial = makeSparseEngine(own, true, error);
+        kind = Backend::Sparse;
+    }
+#endif
+#ifdef MEMOIZA_ENGINE_DENSE
+    if (!initial) {
+        error.clear();
+        initial = makeDenseEngine(own, error);
+        kind = Backend::Dense;
+    }
+#endif
+    if (!initial) {
+        if (error.empty()) error = "для адаптивного движка нужен плотный или разреженный движок";
+        return nullptr;
+    }
+    std::unique_ptr<AdaptiveEngine> engine(new AdaptiveEngine(own, std::move(initial), kind));
+    return engine;
+}
+
+const char* adaptiveBackend(const Board& board, std::uint64_t* switches) {
+    const AdaptiveEngine* engine = dynamic_cast<const AdaptiveEngine*>(&board);
+    if (engine == nullptr) return nullptr;
+    if (switches != nullptr) *switches = engine->switches();
+    return backendName(engine->kind());
+}
+
+} // namespace memoiza
@@ -0,0 +1,47 @@
+#include <climits>
+
+#include "engines.hpp"
+
+// Плотный движок: DenseBoard (board.hpp) со своим правилом. Правило
+// хранится в поле, а не выбирается на процесс (selectRule), поэтому
+// движки с разными правилами шагают из разных потоков (сервис,
+// serve_main.cpp) без общей блокировки.
+
+namespace memoiza {
+
+namespace {
+
+template <class Edges>
+class DenseEngine : public DenseBoard<Edges> {
+public:
+    DenseEngine(const EngineConfig& config, ThreadPool& pool, std::unique_ptr<ThreadPool> ownPool)
+        : DenseBoard<Edges>(static_cast<int>(config.rows), static_cast<int>(config.cols), pool),
+          ownPool_(std::move(ownPool)) {
+        this->setRule(config.rule);
+    }
+
+private:
+    std::unique_ptr<ThreadPool> ownPool_;
+};
+
+} // namespace
+
+std::unique_ptr<Board> makeDenseEngine(const EngineConfig& config, std::string& error) {
+    if (config.topology == Topology::Plane) {
+        error = "плотный движок не поддерживает неограниченную плоскость (есть hashlife)";
+        return nullptr;
+    }
+    if (config.rows > INT_MAX / 2 || config.cols > INT_MAX / 2) {
+        error = "плотное поле не больше " + std::to_string(INT_MAX / 2) + " строк и столбцов";
+        return nullptr;
+    }
+    std::unique_ptr<ThreadPool> ownPool;
+    if (config.pool == nullptr) ownPool.reset(new ThreadPool());
+    ThreadPool& pool = config.pool != nullptr ? *config.pool : *ownPool;
+    if (config.topology == Topology::Torus) {
+        return std::unique_ptr<Board>(new DenseEngine<TorusEdges>(config, pool, std::move(ownPool)));
+    }
+    return std::unique_ptr<Board>(new DenseEngine<BoundedEdges>(config, pool, std::move(ownPool)));
+}
+
+} // namespace memoiza
@@ -0,0 +1,49 @@
+#include "memoiza/engine.hpp"
+
+#include "engines.hpp"
+
+// Реестр движков: в библиотеку попадают только собранные
+
+namespace memoiza {
+
+std::vector<std::string> engineNames() {
+    std::vector<std::string> names;
+#ifdef MEMOIZA_ENGINE_DENSE
+    names.push_back("dense");
+#endif
+#ifdef MEMOIZA_ENGINE_SPARSE
+    names.push_back("sparse");
+    names.push_back("rows");
+#endif
+#ifdef MEMOIZA_ENGINE_HASHLIFE
+    names.push_back("hashlife");
+#endif
+#ifdef MEMOIZA_ENGINE_ADAPTIVE
+    names.push_back("adaptive");
+#endif
+    return names;
+}
+
+std::unique_ptr<Board> makeEngine(const std::string& name, const EngineConfig& config, std::string& error) {
+    if (config.topology != Topology::Plane && (config.rows <= 0 || config.cols <= 0)) {
+        error = "пустое поле";
+        return nullptr;
+    }
+#ifdef MEMOIZA_ENGINE_DENSE
+    if (name == "dense") return makeDenseEngine(config, error);
+#endif
+#ifdef MEMOIZA_ENGINE_SPARSE
+    if (name == "sparse") return makeSparseEngine(config, false, error);
+    if (name == "rows") return makeSparseEngine(config, true, error);
+#endif
+#ifdef MEMOIZA_ENGINE_HASHLIFE
+    if (name == "hashlife") return makeHashLifeEngine(config, error);
+#endif
+#ifdef MEMOIZA_ENGINE_ADAPTIVE
+    if (name == "adaptive") return makeAdaptiveEngine(config, error);
+#endif
+    error = "движок " + name + " не собран в библиотеку";
+    return nullptr;
+}
+
+} // namespace memoiza
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "memoiza/engine.hpp"
+
+// Фабрики движков (src/*_engine.cpp). Какие из них собраны, решают опции
+// MEMOIZA_ENGINE_* в CMakeLists.txt; реестр — src/engine.cpp.
+
+namespace memoiza {
+
+std::unique_ptr<Board> makeDenseEngine(const EngineConfig& config, std::string& error);
+std::unique_ptr<Board> makeSparseEngine(const EngineConfig& config, bool sortedRows, std::string& error);
+std::unique_ptr<Board> makeHashLifeEngine(const EngineConfig& config, std::string& error);
+std::unique_ptr<Board> makeAdaptiveEngine(const EngineConfig& config, std::string& error);
+
+} // namespace memoiza
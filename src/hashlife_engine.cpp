@@ -0,0 +1,20 @@
+#include "engines.hpp"
+
+// Неограниченная плоскость на HashLife: PlaneBoard (board.hpp)
+
+namespace memoiza {
+
+std::unique_ptr<Board> makeHashLifeEngine(const EngineConfig& config, std::string& error) {
+    if (config.topology != Topology::Plane) {
+        error = "движок hashlife работает только на неограниченной плоскости";
+        return nullptr;
+    }
+    std::unique_ptr<PlaneBoard> board(new PlaneBoard());
+    if (!board->setRule(config.rule)) {
+        error = "правило " + config.rule.toString() + " с B0 не поддерживается движком hashlife";
+        return nullptr;
+    }
+    return board;
+}
+
+} // namespace memoiza
@@ -0,0 +1,84 @@
+#include "engines.hpp"
+#include "memoiza/sparse_step.hpp"
+
+// Разреженные движки: множество живых клеток и шаг по полосам строк
+// (memoiza/sparse_step.hpp). За краем поля клеток нет; хеш ведётся по
+// изменившимся клеткам.
+
+namespace memoiza {
+
+namespace {
+
+class SparseEngine : public Board {
+public:
+    SparseEngine(const EngineConfig& config, SparseMethod method)
+        : rows_(config.rows), cols_(config.cols), rule_(config.rule), pool_(config.pool), stepper_(method) {
+        if (pool_ == nullptr) {
+            ownPool_.reset(new ThreadPool());
+            pool_ = ownPool_.get();
+        }
+    }
+
+    std::int64_t rows() const override { return rows_; }
+    std::int64_t cols() const override { return cols_; }
+    std::uint64_t generation() const override { return generation_; }
+    std::uint64_t population() const override { return current_.size(); }
+
+    bool get(std::int64_t row, std::int64_t col) const override {
+        return inside(row, col) && current_.contains(packCell(row, col));
+    }
+    void set(std::int64_t row, std::int64_t col, bool alive) override {
+        if (!inside(row, col)) return;
+        CellKey key = packCell(row, col);
+        bool changed = alive ? current_.insert(key) : current_.erase(key);
+        if (changed) hash_ ^= cellKey(row, col);
+    }
+
+    void step() override {
+        stepper_.step(current_, spare_, rows_, cols_, rule_, *pool_, &hash_);
+        std::swap(current_, spare_);
+        generation_++;
+    }
+
+    void forEachLive(const std::function<void(std::int64_t, std::int64_t)>& fn) const override {
+        for (CellKey cell : current_) fn(cellRow(cell), cellCol(cell));
+    }
+
+    Hash128 hash() const override { return hash_; }
+
+private:
+    bool inside(std::int64_t row, std::int64_t col) const {
+        return row >= 0 && row < rows_ && col >= 0 && col < cols_;
+    }
+
+    std::int64_t rows_, cols_;
+    Rule rule_;
+    ThreadPool* pool_;
+    std::unique_ptr<ThreadPool> ownPool_;
+    SparseStepper stepper_;
+    FlatCellSet current_, spare_;
+    Hash128 hash_;
+    std::uint64_t generation_ = 0;
+};
+
+} // namespace
+
+std::unique_ptr<Board> makeSparseEngine(const EngineConfig& config, bool sortedRows, std::string& error) {
+    if (config.topology != Topology::Bounded) {
+        error = "разреженные движки работают только на ограниченном поле";
+        return nullptr;
+    }
+    // Кандидаты — только клетки рядом с живыми, пока в правиле нет B0
+    if (config.rule.birth & 1u) {
+        error = "правило " + config.rule.toString() + " с B0 не поддерживается разреженными движками";
+        return nullptr;
+    }
+    const std::int64_t maxSide = (std::int64_t(1) << 32) - 1;
+    if (config.rows > maxSide || config.cols > maxSide) {
+        error = "разреженное поле не больше 2^32 - 1 строк и столбцов";
+        return nullptr;
+    }
+    return std::unique_ptr<Board>(new SparseEngine(config, sortedRows ? SparseMethod::Rows : SparseMethod::Hash));
+}
+
+} // namespace memoiza